@@ -7,6 +7,7 @@
 
 #include "arrayflattener.h"
 #include "astutil.h"
+#include "astindex.h"
 #include "kernelinfo.h"
 #include "settings.h"
 #include "uniquenamegenerator.h"
@@ -26,7 +27,7 @@ ArrayFlattener::ArrayFlattener(SgProject *project, Parameters params, KernelInfo
 
 void ArrayFlattener::transform()
 {
-    Rose_STL_Container<SgNode*> varRefNodes = NodeQuery::querySubTree(project, V_SgVarRefExp);
+    Rose_STL_Container<SgNode*> varRefNodes = AstIndex::getInstance()->query(project, V_SgVarRefExp);
 
     for(SgNode* varRefNode : varRefNodes){
         SgVarRefExp* varRef = isSgVarRefExp(varRefNode);
@@ -69,7 +70,7 @@ void ArrayFlattener::flatten(SgVarRefExp* array)
 
     SgExpression* arrayWidth;
     if(settings.generateMPI && kernelInfo.needsMpiScatter(arrayName)){
-        HaloSize hs = kernelInfo.getFootprintTable().at(arrayName).computeHaloSize();
+        HaloSize hs = kernelInfo.getHaloSize(arrayName);
         arrayWidth = buildAddOp(buildVarRefExp(arrayName + "_width", scope), buildIntVal(hs.left + hs.right));
     }
     else{
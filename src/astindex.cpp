@@ -0,0 +1,126 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "astindex.h"
+
+#include <set>
+
+AstIndex* AstIndex::instance;
+
+AstIndex::AstIndex()
+{
+    indexedProject = NULL;
+    valid = false;
+}
+
+AstIndex* AstIndex::getInstance()
+{
+    if(AstIndex::instance == NULL){
+        instance = new AstIndex();
+    }
+
+    return instance;
+}
+
+void AstIndex::invalidate()
+{
+    valid = false;
+}
+
+void AstIndex::update(SgProject* project)
+{
+    if(valid && project == indexedProject){
+        return;
+    }
+
+    nodes.clear();
+    nodesByVariant.clear();
+    functionDeclarations.clear();
+    arrayReferences.clear();
+
+    traverse(project, preorder);
+
+    indexedProject = project;
+    valid = true;
+}
+
+void AstIndex::visit(SgNode* node)
+{
+    nodes.push_back(node);
+
+    SgFunctionDeclaration* funcDec = isSgFunctionDeclaration(node);
+    if(funcDec){
+        functionDeclarations[funcDec->get_name().getString()].push_back(funcDec);
+    }
+
+    // A reference is outermost unless it is the array of another SgPntrArrRefExp. References
+    // in the subscripts, as b[idx] in a[b[idx]], are references of their own.
+    SgPntrArrRefExp* arrRef = isSgPntrArrRefExp(node);
+    SgPntrArrRefExp* parentRef = arrRef ? isSgPntrArrRefExp(arrRef->get_parent()) : NULL;
+    if(arrRef && (!parentRef || parentRef->get_lhs_operand() != arrRef)){
+        SgExpression* base = arrRef;
+        while(isSgPntrArrRefExp(base)){
+            base = isSgPntrArrRefExp(base)->get_lhs_operand();
+        }
+
+        SgVarRefExp* array = isSgVarRefExp(base);
+        if(array){
+            arrayReferences[array->get_symbol()->get_name().str()].push_back(arrRef);
+        }
+    }
+}
+
+// The nodes of each variant are collected on first use, from the full node list, so that
+// derived classes are included, as with NodeQuery
+Rose_STL_Container<SgNode*> AstIndex::query(SgProject* project, VariantT variant)
+{
+    update(project);
+
+    if(nodesByVariant.count(variant) == 0){
+        VariantVector variants(variant);
+        set<VariantT> matching(variants.begin(), variants.end());
+
+        Rose_STL_Container<SgNode*>& matches = nodesByVariant[variant];
+        for(SgNode* node : nodes){
+            if(matching.count(node->variantT())){
+                matches.push_back(node);
+            }
+        }
+    }
+
+    return nodesByVariant[variant];
+}
+
+SgFunctionDeclaration* AstIndex::getFunctionDeclaration(SgProject* project, string functionName)
+{
+    update(project);
+
+    if(functionDeclarations.count(functionName) == 0){
+        return NULL;
+    }
+    return functionDeclarations[functionName].front();
+}
+
+vector<SgFunctionDeclaration*> AstIndex::getFunctionDeclarations(SgProject* project, string functionName)
+{
+    update(project);
+
+    if(functionDeclarations.count(functionName) == 0){
+        return vector<SgFunctionDeclaration*>();
+    }
+    return functionDeclarations[functionName];
+}
+
+vector<SgPntrArrRefExp*> AstIndex::getArrayReferences(SgProject* project, string arrayName)
+{
+    update(project);
+
+    if(arrayReferences.count(arrayName) == 0){
+        return vector<SgPntrArrRefExp*>();
+    }
+    return arrayReferences[arrayName];
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef ASTINDEX_H
+#define ASTINDEX_H
+
+#include "rose.h"
+
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+// Index of the nodes of the project, built in a single traversal, and used instead of
+// repeated NodeQuery::querySubTree() calls over the whole project. Passes that change
+// the AST must call invalidate() afterwards; the index is rebuilt by the next query.
+// Results are returned as copies, so they stay valid if the index is rebuilt while
+// they are being iterated over.
+class AstIndex : public SgSimpleProcessing
+{
+public:
+    static AstIndex* getInstance();
+
+    void invalidate();
+
+    // Same result, and order, as NodeQuery::querySubTree(project, variant)
+    Rose_STL_Container<SgNode*> query(SgProject* project, VariantT variant);
+
+    SgFunctionDeclaration* getFunctionDeclaration(SgProject* project, string functionName);
+    vector<SgFunctionDeclaration*> getFunctionDeclarations(SgProject* project, string functionName);
+
+    // The outermost SgPntrArrRefExp of each reference to the array
+    vector<SgPntrArrRefExp*> getArrayReferences(SgProject* project, string arrayName);
+
+    virtual void visit(SgNode* node);
+
+private:
+    AstIndex();
+    void update(SgProject* project);
+
+    static AstIndex* instance;
+
+    SgProject* indexedProject;
+    bool valid;
+
+    vector<SgNode*> nodes;
+    map<VariantT, Rose_STL_Container<SgNode*>> nodesByVariant;
+    map<string, vector<SgFunctionDeclaration*>> functionDeclarations;
+    map<string, vector<SgPntrArrRefExp*>> arrayReferences;
+};
+
+#endif // ASTINDEX_H
@@ -6,6 +6,7 @@
 
 
 #include "astutil.h"
+#include "astindex.h"
 
 #include <string>
 
@@ -16,9 +17,11 @@ AstUtil::AstUtil()
 {
 }
 
+// Called after the AST has been changed, so the index is rebuilt first
 void AstUtil::fixUniqueNameAttributes(SgProject* project){
 
-    Rose_STL_Container<SgNode*> expressionNodes = NodeQuery::querySubTree(project, V_SgExpression);
+    AstIndex::getInstance()->invalidate();
+    Rose_STL_Container<SgNode*> expressionNodes = AstIndex::getInstance()->query(project, V_SgExpression);
 
     for(SgNode* expressionNode : expressionNodes){
 
@@ -78,18 +81,7 @@ bool AstUtil::isImageType(SgType *type)
 
 SgFunctionDeclaration* AstUtil::getFunctionDeclaration(SgProject* project, string functionName)
 {
-    Rose_STL_Container<SgNode*> funcDefNodes = NodeQuery::querySubTree(project, V_SgFunctionDeclaration);
-
-    for(SgNode* funcDefNode : funcDefNodes){
-
-        SgFunctionDeclaration* funcDef = isSgFunctionDeclaration(funcDefNode);
-
-        if(funcDef){
-            if(funcDef->get_name() == functionName){
-                return funcDef;
-            }
-        }
-    }
+    return AstIndex::getInstance()->getFunctionDeclaration(project, functionName);
 }
 
 bool AstUtil::is2DArrayRoot(SgNode* node)
@@ -195,3 +187,62 @@ bool AstUtil::isReadFrom(SgNode *node)
 {
     return false;
 }
+
+
+// Declarations from the input file itself, or added by the transformations, as opposed to those from included headers
+bool AstUtil::isFromInputFile(SgDeclarationStatement* declaration, SgFile* file)
+{
+    Sg_File_Info* fileInfo = declaration->get_file_info();
+
+    return fileInfo->isTransformation() || fileInfo->isSameFile(file);
+}
+
+
+// The kernels of the input, in source order: the functions defined in the input file,
+// returning void, with at least one Image argument, which are not called by another function
+// of the file. Other functions, such as a helper writing a pixel of an Image argument, are
+// helpers.
+vector<SgFunctionDeclaration*> AstUtil::findKernelDeclarations(SgProject* project)
+{
+    vector<SgFunctionDeclaration*> kernels;
+
+    for(SgFile* file : project->get_fileList()){
+        SgSourceFile* sourceFile = isSgSourceFile(file);
+        if(!sourceFile){
+            continue;
+        }
+
+        set<SgDeclarationStatement*> calledFunctions;
+        Rose_STL_Container<SgNode*> callNodes = NodeQuery::querySubTree(sourceFile->get_globalScope(), V_SgFunctionCallExp);
+        for(SgNode* callNode : callNodes){
+            SgFunctionDeclaration* callee = isSgFunctionCallExp(callNode)->getAssociatedFunctionDeclaration();
+            SgFunctionDeclaration* caller = getEnclosingFunctionDeclaration(callNode);
+            if(callee && caller && caller->get_firstNondefiningDeclaration() != callee->get_firstNondefiningDeclaration()){
+                calledFunctions.insert(callee->get_firstNondefiningDeclaration());
+            }
+        }
+
+        for(SgDeclarationStatement* declaration : sourceFile->get_globalScope()->get_declarations()){
+            SgFunctionDeclaration* funcDec = isSgFunctionDeclaration(declaration);
+            if(!funcDec || funcDec->get_definition() == NULL || funcDec->isCompilerGenerated()){
+                continue;
+            }
+            if(!isFromInputFile(funcDec, file) || !isSgTypeVoid(funcDec->get_type()->get_return_type())){
+                continue;
+            }
+            if(calledFunctions.count(funcDec->get_firstNondefiningDeclaration()) == 1){
+                continue;
+            }
+
+            bool hasImageArgument = false;
+            for(SgInitializedName* argument : funcDec->get_args()){
+                hasImageArgument = hasImageArgument || isImageType(argument->get_type());
+            }
+            if(hasImageArgument){
+                kernels.push_back(funcDec);
+            }
+        }
+    }
+
+    return kernels;
+}
@@ -12,6 +12,7 @@
 
 #include <string>
 #include <set>
+#include <vector>
 
 using namespace std;
 
@@ -30,6 +31,8 @@ public:
     static SgStatement* getParentStatement(SgNode* node);
     static set<string>* getArrayNamesReferenced(SgNode* node);
     static set<string>* findArrayArguments(SgProject *project, string kernelName);
+    static bool isFromInputFile(SgDeclarationStatement* declaration, SgFile* file);
+    static vector<SgFunctionDeclaration*> findKernelDeclarations(SgProject* project);
 };
 
 #endif // ASTUTIL_H
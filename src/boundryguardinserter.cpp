@@ -9,12 +9,15 @@
 
 #include "rose.h"
 #include "astutil.h"
+#include "astindex.h"
+#include "registertiler.h"
 
 using namespace SageBuilder;
 using namespace SageInterface;
 
-BoundryGuardInserter::BoundryGuardInserter(KernelInfo kernelInfo, Parameters params, SgProject *project, Settings settings) : kernelInfo(kernelInfo), params(params), project(project), settings(settings)
+BoundryGuardInserter::BoundryGuardInserter(KernelInfo kernelInfo, Parameters params, SgProject *project, Settings settings, SgBasicBlock* loopBody) : kernelInfo(kernelInfo), params(params), project(project), settings(settings), loopBody(loopBody)
 {
+    interiorBody = NULL;
 }
 
 SgExpression* buildIsDirection(GridPosition dir, SgScopeStatement* scope){
@@ -223,32 +226,29 @@ void BoundryGuardInserter::wrapWithGuards(SgPntrArrRefExp* arrRef, string arrayN
 
 
 
-bool BoundryGuardInserter::needsBoundaryGuard(string arrayName, KernelInfo kernelInfo, Parameters params, Settings settings, BoundaryGuardDirection direction)
+bool BoundryGuardInserter::needsBoundaryGuard(string arrayName, KernelInfo& kernelInfo, Parameters& params, Settings& settings, BoundaryGuardDirection direction)
 {
-    Footprint f;
-    bool hasFootprint = kernelInfo.getFootprintTable().count(arrayName) == 1;
-
-    if(hasFootprint)
-        f = kernelInfo.getFootprintTable().at(arrayName);
+    bool hasFootprint = kernelInfo.hasFootprint(arrayName);
 
     bool hasThreadStaticFootprint = true;
     bool hasZeroSizeFootprint = false;
     if(hasFootprint){
+        HaloSize hs = kernelInfo.getHaloSize(arrayName);
         switch(direction){
         case BOUNDARY_GUARD_DIR_ALL:
-            hasZeroSizeFootprint = f.computeHaloSize().getMax() == 0;
+            hasZeroSizeFootprint = hs.getMax() == 0;
             break;
         case BOUNDARY_GUARD_DIR_X:
-            hasZeroSizeFootprint = f.computeHaloSize().left == 0 && f.computeHaloSize().right == 0;
+            hasZeroSizeFootprint = hs.left == 0 && hs.right == 0;
             break;
         case BOUNDARY_GUARD_DIR_Y:
-            hasZeroSizeFootprint = f.computeHaloSize().down == 0 && f.computeHaloSize().up == 0;
+            hasZeroSizeFootprint = hs.down == 0 && hs.up == 0;
             break;
         default:
-            hasZeroSizeFootprint = f.computeHaloSize().getMax() == 0;
+            hasZeroSizeFootprint = hs.getMax() == 0;
             break;
         }
-        hasThreadStaticFootprint = f.threadStatic;
+        hasThreadStaticFootprint = kernelInfo.getFootprintTable().at(arrayName).threadStatic;
     }
     bool usesImageMemory = params.imageMemArrays->count(arrayName) == 1;
     bool isImage = kernelInfo.getImageArrays()->count(arrayName) == 1;
@@ -258,6 +258,11 @@ bool BoundryGuardInserter::needsBoundaryGuard(string arrayName, KernelInfo kerne
         return false;
     }
 
+    // Register tiles are loaded for all the elements of a thread, also past the edge of the image
+    if(RegisterTiler::isRegisterTiled(arrayName, kernelInfo, params, settings)){
+        return true;
+    }
+
     if(hasZeroSizeFootprint && kernelInfo.isGridArray(arrayName)){
         return false;
     }
@@ -276,8 +281,13 @@ bool BoundryGuardInserter::needsBoundaryGuard(string arrayName, KernelInfo kerne
 void BoundryGuardInserter::insertBoundryGuards()
 {
     SgFunctionDeclaration* funcDef = AstUtil::getFunctionDeclaration(project, kernelInfo.getKernelName());
+
+    if(params.borderSplit){
+        splitBorder();
+    }
+
     //TODO: This only seems to work for +=
-    Rose_STL_Container<SgNode*> expressionNodes = NodeQuery::querySubTree(project, V_SgExpression);
+    Rose_STL_Container<SgNode*> expressionNodes = AstIndex::getInstance()->query(project, V_SgExpression);
 
     for(SgNode* expressionNode : expressionNodes){
 
@@ -303,6 +313,11 @@ void BoundryGuardInserter::insertBoundryGuards()
                     continue;
                 }
 
+                // Addresses are not reads, the code using them must stay inside the image
+                if(isSgAddressOfOp(parent)){
+                    continue;
+                }
+
                 SgPntrArrRefExp* arrRef = isSgPntrArrRefExp(arrRefNode);
 
                 string arrayName = AstUtil::getArrayName(arrRef);
@@ -310,6 +325,10 @@ void BoundryGuardInserter::insertBoundryGuards()
                 bool needsX = needsBoundaryGuard(arrayName, kernelInfo, params, settings, BOUNDARY_GUARD_DIR_X);
                 bool needsY = needsBoundaryGuard(arrayName, kernelInfo, params, settings, BOUNDARY_GUARD_DIR_Y);
 
+                if(interiorBody && interiorArrays.count(arrayName) == 1 && isAncestor(interiorBody, arrRef)){
+                    continue;
+                }
+
                 if(needsX || needsY){
                     cout << "[BoundryGuard] adding guards (";
                     if(needsX)
@@ -326,3 +345,99 @@ void BoundryGuardInserter::insertBoundryGuards()
 
     AstUtil::fixUniqueNameAttributes(project);
 }
+
+
+// Everything after the GS_X/GS_Y test in the per pixel body is duplicated, into
+// if(interior){ unguarded } else { guarded }. Only arrays with a footprint relative to the
+// thread can be read without guards in the interior; the rest keep their guards in both.
+void BoundryGuardInserter::splitBorder()
+{
+    if(settings.generateMPI || settings.generateOMP){
+        cout << "WARNING: BORDER_SPLIT is not supported with MPI or OpenMP, and is ignored" << endl;
+        return;
+    }
+    if(loopBody == NULL){
+        return;
+    }
+
+    for(string arrayName : *kernelInfo.getImageArrays()){
+        bool needsGuard = needsBoundaryGuard(arrayName, kernelInfo, params, settings, BOUNDARY_GUARD_DIR_X) ||
+                          needsBoundaryGuard(arrayName, kernelInfo, params, settings, BOUNDARY_GUARD_DIR_Y);
+        if(needsGuard && kernelInfo.hasFootprint(arrayName) && !kernelInfo.getFootprintTable().at(arrayName).threadStatic){
+            interiorArrays.insert(arrayName);
+        }
+    }
+    if(interiorArrays.empty()){
+        return;
+    }
+
+    SgStatementPtrList statements = loopBody->get_statements();
+    int first = 0;
+    while(first < statements.size()){
+        SgIfStmt* ifStmt = isSgIfStmt(statements[first++]);
+        if(ifStmt && isSgContinueStmt(ifStmt->get_true_body())){
+            break;
+        }
+    }
+    if(first >= statements.size()){
+        return;
+    }
+
+    SgBasicBlock* borderBody = buildBasicBlock();
+    for(int i = first; i < statements.size(); i++){
+        removeStatement(statements[i]);
+        appendStatement(statements[i], borderBody);
+    }
+
+    interiorBody = isSgBasicBlock(copyStatement(borderBody));
+    SgIfStmt* split = buildIfStmt(buildInteriorTest(loopBody), interiorBody, borderBody);
+    appendStatement(split, loopBody);
+
+    // Local variables in the copy are looked up again, to refer to the copied declarations
+    Rose_STL_Container<SgNode*> varRefNodes = NodeQuery::querySubTree(interiorBody, V_SgVarRefExp);
+    for(SgNode* n : varRefNodes){
+        SgVarRefExp* varRef = isSgVarRefExp(n);
+        if(isAncestor(borderBody, varRef->get_symbol()->get_declaration())){
+            replaceExpression(varRef, buildVarRefExp(varRef->get_symbol()->get_name(), getScope(varRef)));
+        }
+    }
+
+    AstIndex::getInstance()->invalidate();
+
+    cout << "[BoundryGuard] splitting interior and border for: ";
+    for(string arrayName : interiorArrays){
+        cout << arrayName << " ";
+    }
+    cout << endl;
+}
+
+
+// A pixel is interior if its footprint is inside each of the arrays read without guards
+SgExpression* BoundryGuardInserter::buildInteriorTest(SgScopeStatement* scope)
+{
+    SgExpression* test = NULL;
+
+    for(string arrayName : interiorArrays){
+        HaloSize hs = kernelInfo.getHaloSize(arrayName);
+        vector<SgExpression*> terms;
+
+        if(needsBoundaryGuard(arrayName, kernelInfo, params, settings, BOUNDARY_GUARD_DIR_X)){
+            SgExpression* idx = buildVarRefExp("idx", scope);
+            terms.push_back(buildGreaterOrEqualOp(idx, buildIntVal(hs.left)));
+            SgExpression* maxX = buildSubtractOp(buildOpaqueVarRefExp(arrayName + "_width", scope), buildIntVal(hs.right));
+            terms.push_back(buildLessThanOp(buildVarRefExp("idx", scope), maxX));
+        }
+        if(needsBoundaryGuard(arrayName, kernelInfo, params, settings, BOUNDARY_GUARD_DIR_Y)){
+            SgExpression* idy = buildVarRefExp("idy", scope);
+            terms.push_back(buildGreaterOrEqualOp(idy, buildIntVal(hs.up)));
+            SgExpression* maxY = buildSubtractOp(buildOpaqueVarRefExp(arrayName + "_height", scope), buildIntVal(hs.down));
+            terms.push_back(buildLessThanOp(buildVarRefExp("idy", scope), maxY));
+        }
+
+        for(SgExpression* term : terms){
+            test = test == NULL ? term : buildAndOp(test, term);
+        }
+    }
+
+    return test;
+}
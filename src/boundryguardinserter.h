@@ -24,11 +24,11 @@ enum GridPosition {CENTRAL = 0, WEST = 1, EAST = 2, CENTRAL_EAST_WEST = 3,
 class BoundryGuardInserter
 {
 public:
-    BoundryGuardInserter(KernelInfo kernelInfo, Parameters params, SgProject* project, Settings settings);
+    BoundryGuardInserter(KernelInfo kernelInfo, Parameters params, SgProject* project, Settings settings, SgBasicBlock* loopBody = NULL);
 
     void wrapWithGuards(SgPntrArrRefExp* arrRef, string arrayName, SgScopeStatement* scope, bool dirX, bool dirY);
     void insertBoundryGuards();
-    static bool needsBoundaryGuard(string arrayName, KernelInfo kernelInfo, Parameters params, Settings settings, BoundaryGuardDirection direction=BOUNDARY_GUARD_DIR_ALL);
+    static bool needsBoundaryGuard(string arrayName, KernelInfo& kernelInfo, Parameters& params, Settings& settings, BoundaryGuardDirection direction=BOUNDARY_GUARD_DIR_ALL);
     bool needsBoundaryGuardX(string arrayName);
     bool needsBoundaryGuardY(string arrayName);
 
@@ -37,10 +37,19 @@ public:
     void insertClampedGuard(SgScopeStatement* scope, SgExpression* varExpression, SgStatement* parentStatement, SgVarRefExp* dim);
     void insertClampedDistGuards(SgVarRefExp* dim, SgScopeStatement* scope, SgExpression* varExpression, SgStatement* parentStatement, GridPosition minDir, GridPosition maxDir);
 private:
+    void splitBorder();
+    SgExpression* buildInteriorTest(SgScopeStatement* scope);
+
     KernelInfo kernelInfo;
     Parameters params;
     SgProject* project;
     Settings settings;
+
+    // The per pixel body from the NaiveCoarsener, and, with BORDER_SPLIT, the copy of it used
+    // for interior pixels, where the arrays in interiorArrays are read without guards
+    SgBasicBlock* loopBody;
+    SgBasicBlock* interiorBody;
+    set<string> interiorArrays;
 };
 
 #endif // BOUNDRYGUARDINSERTER_H
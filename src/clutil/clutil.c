@@ -7,6 +7,8 @@
 #include "clutil.h"
 #include <CL/cl.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 const char *clErrorStr(cl_int err) {
 	switch (err) {
@@ -409,3 +411,80 @@ cl_kernel buildKernel(char* sourceFile, char* kernelName, char* options, cl_cont
 
     return kernel;
 }
+
+// Kernels built by getCachedKernel, with the arguments they were built with. When the cache
+// is full, the oldest kernel is released.
+#define KERNEL_CACHE_SIZE 16
+
+typedef struct {
+    char* sourceFile;
+    char* kernelName;
+    char* options;
+    cl_context context;
+    cl_kernel kernel;
+} cached_kernel;
+
+static cached_kernel kernel_cache[KERNEL_CACHE_SIZE];
+static int n_cached_kernels = 0;
+static int next_evicted_kernel = 0;
+
+static char* copy_string(const char* s){
+    char* t = malloc(strlen(s) + 1);
+    strcpy(t, s);
+    return t;
+}
+
+static void release_cache_entry(cached_kernel* entry){
+    clReleaseKernel(entry->kernel);
+    free(entry->sourceFile);
+    free(entry->kernelName);
+    free(entry->options);
+}
+
+cl_kernel getCachedKernel(char* sourceFile, char* kernelName, char* options, cl_context context, cl_device_id device, cl_int* error){
+    *error = CL_SUCCESS;
+
+    for(int i = 0; i < n_cached_kernels; i++){
+        cached_kernel* entry = &kernel_cache[i];
+        if(entry->context == context && strcmp(entry->sourceFile, sourceFile) == 0 &&
+           strcmp(entry->kernelName, kernelName) == 0 && strcmp(entry->options, options) == 0){
+            return entry->kernel;
+        }
+    }
+
+    cl_kernel kernel = buildKernel(sourceFile, kernelName, options, context, device, error);
+    if(kernel == NULL){
+        return NULL;
+    }
+
+    cached_kernel* entry;
+    if(n_cached_kernels < KERNEL_CACHE_SIZE){
+        entry = &kernel_cache[n_cached_kernels++];
+    }
+    else{
+        entry = &kernel_cache[next_evicted_kernel];
+        next_evicted_kernel = (next_evicted_kernel + 1) % KERNEL_CACHE_SIZE;
+        release_cache_entry(entry);
+    }
+    entry->sourceFile = copy_string(sourceFile);
+    entry->kernelName = copy_string(kernelName);
+    entry->options = copy_string(options);
+    entry->context = context;
+    entry->kernel = kernel;
+
+    return kernel;
+}
+
+void releaseCachedKernels(cl_context context){
+    int n = 0;
+    for(int i = 0; i < n_cached_kernels; i++){
+        if(kernel_cache[i].context == context){
+            release_cache_entry(&kernel_cache[i]);
+        }
+        else{
+            kernel_cache[n++] = kernel_cache[i];
+        }
+    }
+    n_cached_kernels = n;
+    next_evicted_kernel = 0;
+}
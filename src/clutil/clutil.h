@@ -8,6 +8,10 @@
 #define CLUTIL_H
 #include <CL/cl.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 const char *clErrorStr(cl_int err);
 void clError(char *s, cl_int err);
 
@@ -26,4 +30,13 @@ int invalid_work_group_size_static(cl_device_id id, int dim, const size_t* local
 
 cl_kernel buildKernel(char* sourceFile, char* kernelName, char* options, cl_context context, cl_device_id device, cl_int* error);
 
+// Like buildKernel, but the kernel is only built the first time it is asked for with the
+// same arguments, and is owned by the cache, see releaseCachedKernels
+cl_kernel getCachedKernel(char* sourceFile, char* kernelName, char* options, cl_context context, cl_device_id device, cl_int* error);
+void releaseCachedKernels(cl_context context);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,151 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "codeformatter.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+string CodeFormatter::trim(string line)
+{
+    size_t first = line.find_first_not_of(" \t\r");
+    if(first == string::npos){
+        return "";
+    }
+    size_t last = line.find_last_not_of(" \t\r");
+    return line.substr(first, last - first + 1);
+}
+
+// Counts the braces of a line that are not in strings, character literals or comments.
+// inComment carries an open block comment over to the next line.
+void CodeFormatter::countBraces(string line, bool& inComment, int& opened, int& closed)
+{
+    opened = 0;
+    closed = 0;
+    char quote = 0;
+
+    for(int i = 0; i < line.size(); i++){
+        char c = line[i];
+        char next = i + 1 < line.size() ? line[i+1] : 0;
+
+        if(inComment){
+            if(c == '*' && next == '/'){
+                inComment = false;
+                i++;
+            }
+            continue;
+        }
+        if(quote != 0){
+            if(c == '\\'){
+                i++;
+            }
+            else if(c == quote){
+                quote = 0;
+            }
+            continue;
+        }
+
+        if(c == '/' && next == '/'){
+            return;
+        }
+        if(c == '/' && next == '*'){
+            inComment = true;
+            i++;
+        }
+        else if(c == '"' || c == '\''){
+            quote = c;
+        }
+        else if(c == '{'){
+            opened++;
+        }
+        else if(c == '}'){
+            closed++;
+        }
+    }
+}
+
+string CodeFormatter::format(string source)
+{
+    istringstream in(source);
+    ostringstream out;
+
+    int depth = 0;
+    bool inComment = false;
+    bool continuation = false;
+    string line;
+
+    while(getline(in, line)){
+        line = trim(line);
+
+        if(line.empty()){
+            out << endl;
+            continue;
+        }
+
+        if(!inComment && line[0] == '#'){
+            out << line << endl;
+            continue;
+        }
+
+        bool startsInComment = inComment;
+        int opened, closed;
+        countBraces(line, inComment, opened, closed);
+
+        // Closing braces at the start of the line belong to the outer level
+        int leadingClosed = 0;
+        while(!startsInComment && leadingClosed < line.size() && line[leadingClosed] == '}'){
+            leadingClosed++;
+        }
+
+        int lineDepth = max(depth - leadingClosed, 0);
+        if(continuation && leadingClosed == 0 && line[0] != '{'){
+            lineDepth++;
+        }
+
+        out << string(lineDepth * indentWidth, ' ') << line << endl;
+
+        depth = max(depth + opened - closed, 0);
+
+        char last = line[line.size() - 1];
+        bool isComment = startsInComment || line.compare(0, 2, "//") == 0 || line.compare(0, 2, "/*") == 0;
+        continuation = !isComment && !inComment && last != ';' && last != '{' && last != '}' && last != ':' && last != ',';
+        if(!isComment && !inComment && last == ','){
+            // Argument lists split over several lines are continued, initializer lists are not
+            continuation = opened == 0 && closed == 0;
+        }
+    }
+
+    return out.str();
+}
+
+// Formats the file in place, by writing to a temporary file, and renaming it, so that
+// the file is never left partially written
+bool CodeFormatter::formatFile(string fileName)
+{
+    ifstream inFile(fileName);
+    if(!inFile.good()){
+        cout << "WARNING: Could not read " << fileName << " for formatting" << endl;
+        return false;
+    }
+    ostringstream content;
+    content << inFile.rdbuf();
+    inFile.close();
+
+    string tempFileName = fileName + ".fmt";
+    ofstream outFile(tempFileName);
+    outFile << format(content.str());
+    outFile.close();
+
+    if(!outFile || rename(tempFileName.c_str(), fileName.c_str()) != 0){
+        cout << "WARNING: Could not write formatted " << fileName << endl;
+        remove(tempFileName.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,31 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef CODEFORMATTER_H
+#define CODEFORMATTER_H
+
+#include <string>
+
+using namespace std;
+
+// Re-indents generated C code by brace depth, with 4 spaces per level, in place of the
+// external indent program. Statements continued on the next line get one extra level,
+// and preprocessor lines are not indented.
+class CodeFormatter
+{
+public:
+    static string format(string source);
+    static bool formatFile(string fileName);
+
+private:
+    static string trim(string line);
+    static void countBraces(string line, bool& inComment, int& opened, int& closed);
+
+    static const int indentWidth = 4;
+};
+
+#endif // CODEFORMATTER_H
@@ -0,0 +1,223 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "compileserver.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+CompileServer::CompileServer(VariantGenerator* variantGenerator, Settings settings, int outputFd) : variantGenerator(variantGenerator), settings(settings), outputFd(outputFd)
+{
+    nRequests = 0;
+}
+
+
+void CompileServer::run()
+{
+    if(settings.serverSocket.empty()){
+        runOnStdin();
+    }
+    else{
+        runOnSocket();
+    }
+}
+
+
+void CompileServer::runOnStdin()
+{
+    cerr << "[Server] Reading requests from stdin" << endl;
+
+    FILE* out = fdopen(outputFd, "w");
+    if(out == NULL){
+        cerr << "ERROR: Could not open server output. Exiting..." << endl;
+        exit(-1);
+    }
+
+    serve(stdin, out);
+    fclose(out);
+}
+
+
+void CompileServer::runOnSocket()
+{
+    const char* path = settings.serverSocket.c_str();
+
+    struct sockaddr_un address;
+    if(strlen(path) >= sizeof(address.sun_path)){
+        cerr << "ERROR: Server socket path " << settings.serverSocket << " is too long. Exiting..." << endl;
+        exit(-1);
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if(listenFd < 0 || bind(listenFd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listenFd, 1) < 0){
+        cerr << "ERROR: Could not listen on server socket " << settings.serverSocket << ". Exiting..." << endl;
+        exit(-1);
+    }
+
+    cerr << "[Server] Listening on " << settings.serverSocket << endl;
+
+    bool running = true;
+    while(running){
+        int connectionFd = accept(listenFd, NULL, NULL);
+        if(connectionFd < 0){
+            continue;
+        }
+
+        FILE* in = fdopen(connectionFd, "r");
+        FILE* out = fdopen(dup(connectionFd), "w");
+
+        running = serve(in, out);
+
+        fclose(in);
+        fclose(out);
+    }
+
+    close(listenFd);
+    unlink(path);
+}
+
+
+// A request is a parameter set in the config.txt format, terminated by a blank line.
+// Returns false if the server was asked to shut down, true if the input ended.
+bool CompileServer::serve(FILE* in, FILE* out)
+{
+    ostringstream request;
+    bool requestEmpty = true;
+
+    char* line = NULL;
+    size_t lineCapacity = 0;
+
+    while(true){
+        bool gotLine = getline(&line, &lineCapacity, in) >= 0;
+        string currentLine = gotLine ? string(line) : "";
+
+        int end = currentLine.find_last_not_of(" \t\r\n");
+        currentLine = currentLine.substr(0, end + 1);
+
+        if(currentLine.compare("SHUTDOWN") == 0){
+            free(line);
+            return false;
+        }
+
+        if(!gotLine || currentLine.empty()){
+            if(!requestEmpty){
+                handleRequest(request.str(), out);
+                request.str("");
+                requestEmpty = true;
+            }
+            if(!gotLine){
+                break;
+            }
+            continue;
+        }
+
+        if(currentLine[0] == '#'){
+            continue;
+        }
+
+        request << currentLine << endl;
+        requestEmpty = false;
+    }
+
+    free(line);
+    return true;
+}
+
+
+// The response is STATUS:OK or STATUS:FAILED, followed by the generated files, each given as
+// a KERNEL:<bytes> or WRAPPER:<bytes> line and the raw source, and finally an END line
+void CompileServer::handleRequest(string request, FILE* out)
+{
+    // The pid keeps the files of servers running in the same directory apart
+    string baseName = settings.inputBaseName + "_server_" + to_string(getpid()) + "_" + to_string(nRequests++);
+    string kernelFileName = baseName + (settings.generateCl ? ".cl" : ".c");
+    string wrapperFileName = baseName + "_wrapper.c";
+
+    if(generateVariant(request, baseName)){
+        fprintf(out, "STATUS:OK\n");
+        writeFile("KERNEL", kernelFileName, out);
+        if(settings.generateStandalone){
+            writeFile("WRAPPER", wrapperFileName, out);
+        }
+    }
+    else{
+        fprintf(out, "STATUS:FAILED\n");
+    }
+    fprintf(out, "END\n");
+    fflush(out);
+
+    unlink(kernelFileName.c_str());
+    unlink(wrapperFileName.c_str());
+}
+
+
+// Each request is handled by a forked child, which starts from the analyzed AST, so there is
+// nothing to restore afterwards. The request is also parsed in the child, so malformed or
+// invalid parameters only terminate the child.
+bool CompileServer::generateVariant(string request, string baseName)
+{
+    cout.flush();
+    fflush(stdout);
+
+    pid_t pid = fork();
+
+    if(pid == 0){
+        Parameters params;
+        params.setDefaultParameters();
+        istringstream requestStream(request);
+        params.readParametersFromStream(requestStream);
+
+        params.setParametersFromPragmas(variantGenerator->getKernelInfo().getPragmas());
+        params.validateParameters(variantGenerator->getKernelInfo());
+        params.printParameters();
+
+        variantGenerator->generate(params, baseName);
+
+        cout.flush();
+        fflush(stdout);
+        _exit(0);
+    }
+
+    if(pid < 0){
+        cerr << "WARNING: Could not fork worker for request" << endl;
+        return false;
+    }
+
+    int childStatus;
+    if(waitpid(pid, &childStatus, 0) < 0){
+        return false;
+    }
+
+    return WIFEXITED(childStatus) && WEXITSTATUS(childStatus) == 0;
+}
+
+
+void CompileServer::writeFile(string tag, string fileName, FILE* out)
+{
+    ifstream file(fileName);
+    ostringstream content;
+    content << file.rdbuf();
+    string source = content.str();
+
+    fprintf(out, "%s:%zu\n", tag.c_str(), source.size());
+    fwrite(source.data(), 1, source.size(), out);
+}
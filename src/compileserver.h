@@ -0,0 +1,42 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef COMPILESERVER_H
+#define COMPILESERVER_H
+
+#include "variantgenerator.h"
+#include "parameters.h"
+#include "settings.h"
+
+#include <string>
+#include <cstdio>
+
+using namespace std;
+
+// Keeps the analyzed kernel resident, and generates variants for parameter sets
+// received on stdin or a Unix domain socket. See documentation.md for the protocol.
+class CompileServer
+{
+public:
+    CompileServer(VariantGenerator* variantGenerator, Settings settings, int outputFd);
+    void run();
+
+private:
+    void runOnStdin();
+    void runOnSocket();
+    bool serve(FILE* in, FILE* out);
+    void handleRequest(string request, FILE* out);
+    bool generateVariant(string request, string baseName);
+    void writeFile(string tag, string fileName, FILE* out);
+
+    VariantGenerator* variantGenerator;
+    Settings settings;
+    int outputFd;
+    int nRequests;
+};
+
+#endif // COMPILESERVER_H
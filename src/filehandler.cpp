@@ -6,6 +6,14 @@
 
 
 #include "filehandler.h"
+#include "codeformatter.h"
+
+#include <cstdlib>
+#include <unistd.h>
+
+string FileHandler::workingDirectory;
+vector<string> FileHandler::workingFiles;
+pid_t FileHandler::workingDirectoryOwner = 0;
 
 FileHandler::FileHandler()
 {
@@ -18,10 +26,69 @@ string FileHandler::getFileNameBase(string fileName)
     return fileName.substr(0,found);
 }
 
+void FileHandler::createWorkingDirectory()
+{
+    const char* tempDir = getenv("TMPDIR");
+    string directoryTemplate = string(tempDir != NULL ? tempDir : "/tmp") + "/imcl_XXXXXX";
+
+    vector<char> buffer(directoryTemplate.begin(), directoryTemplate.end());
+    buffer.push_back('\0');
+
+    if(mkdtemp(buffer.data()) == NULL){
+        cerr << "ERROR: Could not create temporary directory " << directoryTemplate << ". Exiting..." << endl;
+        exit(-1);
+    }
+    workingDirectory = string(buffer.data());
+    workingDirectoryOwner = getpid();
+
+    // Errors exit from anywhere in the compiler, so the directory is also removed at exit
+    static bool registered = false;
+    if(!registered){
+        atexit(removeWorkingDirectory);
+        registered = true;
+    }
+}
+
+
+// Only the process that created the directory removes it, since forked workers exiting with
+// an error would otherwise remove it from under the parent
+void FileHandler::removeWorkingDirectory()
+{
+    if(workingDirectory.empty() || getpid() != workingDirectoryOwner){
+        return;
+    }
+
+    for(string workingFile : workingFiles){
+        unlink(workingFile.c_str());
+    }
+    workingFiles.clear();
+    rmdir(workingDirectory.c_str());
+    workingDirectory = "";
+}
+
+string FileHandler::getWorkingFileName(string fileName)
+{
+    size_t found = fileName.find_last_of('/');
+
+    return workingDirectory + "/" + fileName.substr(found + 1);
+}
+
+// Copies the input files, with the preamble prepended, to the working directory
 void FileHandler::fixFiles(Rose_STL_Container<string> fileNames, Settings settings)
 {
+    if(workingDirectory.empty()){
+        createWorkingDirectory();
+    }
+
     for(string fileName : fileNames){
-        ofstream newFile("new_" + fileName);
+        ifstream oldFile(fileName);
+        if(!oldFile.good()){
+            cerr << "ERROR: Could not read " << fileName << ". Exiting..." << endl;
+            exit(-1);
+        }
+
+        workingFiles.push_back(getWorkingFileName(fileName));
+        ofstream newFile(workingFiles.back());
 
         newFile << "#define MAKE_INT2(x,y) (int2)(x,y)" << endl;
         newFile << "int idx, idy;" << endl;
@@ -31,25 +98,24 @@ void FileHandler::fixFiles(Rose_STL_Container<string> fileNames, Settings settin
         newFile << "using Image = T**;" << endl;
         newFile << endl;
 
-        ifstream oldFile(fileName);
-        string line;
-        while(getline(oldFile, line)){
-            newFile << line << endl;
-        }
+        newFile << oldFile.rdbuf();
 
         newFile.close();
         oldFile.close();
     }
 }
 
-char** FileHandler::fixFileNames(int argc, char** argv, Rose_STL_Container<string> fileNames){
-    char** newArgv = (char**)malloc(sizeof(char*) * argc);
+// Replaces the input files in the arguments with the copies in the working directory,
+// and adds the directories of the originals to the include path, so that their local
+// includes are still found
+char** FileHandler::fixFileNames(int& argc, char** argv, Rose_STL_Container<string> fileNames){
+    char** newArgv = (char**)malloc(sizeof(char*) * (argc + fileNames.size() + 1));
 
     for(int i = 0; i < argc; i++){
         char* arg = argv[i];
         for(string fileName : fileNames){
             if(strcmp(arg, fileName.c_str()) == 0){
-                string newFileName = "new_" + fileName;
+                string newFileName = getWorkingFileName(fileName);
                 arg = new char[newFileName.length() + 1];
                 strcpy(arg, newFileName.c_str());
             }
@@ -57,31 +123,62 @@ char** FileHandler::fixFileNames(int argc, char** argv, Rose_STL_Container<strin
         newArgv[i] = arg;
     }
 
+    int newArgc = argc;
+    for(string fileName : fileNames){
+        size_t found = fileName.find_last_of('/');
+        string includeFlag = "-I" + (found == string::npos ? string(".") : fileName.substr(0, found));
+
+        newArgv[newArgc] = new char[includeFlag.length() + 1];
+        strcpy(newArgv[newArgc], includeFlag.c_str());
+        newArgc++;
+    }
+    newArgv[newArgc] = NULL;
+
+    argc = newArgc;
     return newArgv;
 }
 
+// The unparsed files are written directly to their final names
 void FileHandler::cleanUpFiles( Rose_STL_Container<string> fileNames, Settings settings, bool doIndent)
 {
-    for(string fileName : fileNames){
-        ostringstream s;
-        s << "rm new_" << fileName;
-        system(s.str().c_str());
+    removeTemporaryFiles(fileNames);
+
+    if(doIndent){
+        indentWrapper(settings);
+    }
+}
+
+void FileHandler::removeTemporaryFiles(Rose_STL_Container<string> fileNames)
+{
+    if(workingDirectory.empty()){
+        return;
     }
 
     for(string fileName : fileNames){
-        ostringstream s;
+        unlink(getWorkingFileName(fileName).c_str());
+    }
+    removeWorkingDirectory();
+}
+
+void FileHandler::setOutputFileNames(SgProject* project, string baseName, Settings settings)
+{
+    for(SgFile* file : project->get_fileList()){
+        SgSourceFile* sourceFile = isSgSourceFile(file);
+        if(!sourceFile){
+            continue;
+        }
+
         if(settings.generateCl){
-            s << "mv rose_new_" << fileName << " " << settings.inputBaseName << ".cl";
+            sourceFile->set_unparse_output_filename(baseName + ".cl");
         }
         else{
-            s << "mv rose_new_" << fileName << " " << settings.inputBaseName << ".c";
+            sourceFile->set_unparse_output_filename(baseName + ".c");
         }
-        system(s.str().c_str());
     }
+}
 
-    if(doIndent){
-        string fileName = settings.inputBaseName + "_wrapper.c";
-        string command = "indent -linux -l150 -ts4 -i4 " + fileName;
-        system(command.c_str());
-    }
+void FileHandler::indentWrapper(Settings settings)
+{
+    string fileName = settings.inputBaseName + "_wrapper.c";
+    CodeFormatter::formatFile(fileName);
 }
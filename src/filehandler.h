@@ -13,6 +13,8 @@
 #include "settings.h"
 
 #include <string>
+#include <vector>
+#include <sys/types.h>
 
 using namespace std;
 
@@ -22,11 +24,26 @@ public:
     FileHandler();
 
     static void fixFiles(Rose_STL_Container<string> fileNames, Settings settings);
-    static char** fixFileNames(int argc, char** argv, Rose_STL_Container<string> fileNames);
+    static char** fixFileNames(int& argc, char** argv, Rose_STL_Container<string> fileNames);
     static void cleanUpFiles(Rose_STL_Container<string> fileNames, Settings settings, bool doIndent=true);
+    static void removeTemporaryFiles(Rose_STL_Container<string> fileNames);
+    static void setOutputFileNames(SgProject* project, string baseName, Settings settings);
+    static void indentWrapper(Settings settings);
     static string getFileNameBase(string fileName);
 
     static const int preambleLength = 6;
+
+private:
+    static void createWorkingDirectory();
+    static void removeWorkingDirectory();
+    static string getWorkingFileName(string fileName);
+
+    // Private directory for the input files with the preamble, so that concurrent
+    // runs in the same directory do not overwrite each other's files
+    static string workingDirectory;
+    // Copies written to the working directory, and the process that created it
+    static vector<string> workingFiles;
+    static pid_t workingDirectoryOwner;
 };
 
 #endif // FILEHANDLER_H
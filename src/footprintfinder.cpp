@@ -260,6 +260,10 @@ void FootprintAnalysis::visit(const Function& func, const DataflowNode& n, NodeS
 
     SgPntrArrRefExp* arrRef = isSgPntrArrRefExp(astNode);
 
+    if(!kernelInfo->isInKernel(astNode)){
+        return;
+    }
+
     FiniteVarsExprsProductLattice *lat = dynamic_cast<FiniteVarsExprsProductLattice *>(state.getLatticeAbove(cpa)[0]);
 
     if(arrRef && !isSgPntrArrRefExp(parent)){
@@ -313,14 +317,22 @@ map<string,Footprint> FootprintAnalysis::getFootprintTable()
     return footprintTable;
 }
 
-map<string, Footprint> FootprintFinder::findFootprints(SgProject *project, KernelInfo *kernelInfo)
+SgProject* FootprintFinder::analyzedProject;
+LiveDeadVarsAnalysis* FootprintFinder::ldva;
+MultiConstantPropagationAnalysis* FootprintFinder::cpa;
+
+void FootprintFinder::runDataflowAnalyses(SgProject* project)
 {
+    if(analyzedProject == project){
+        return;
+    }
+
     initAnalysis(project);
     // This debug shit is apparently needed to avoid segfaults...
     Dbg::init("test", ".", "index.html");
 
-    LiveDeadVarsAnalysis ldva(project);
-    UnstructuredPassInterDataflow upid_ldva(&ldva);
+    ldva = new LiveDeadVarsAnalysis(project);
+    UnstructuredPassInterDataflow upid_ldva(ldva);
     upid_ldva.runAnalysis();
 
     // There is a bug or something in the destructor, so we just dont destroy it...
@@ -329,12 +341,19 @@ map<string, Footprint> FootprintFinder::findFootprints(SgProject *project, Kerne
     SgIncidenceDirectedGraph* graph = cgb->getGraph();
 
 
-    MultiConstantPropagationAnalysis cpa(&ldva);
-    ContextInsensitiveInterProceduralDataflow ciipd_cpa(&cpa, graph);
+    cpa = new MultiConstantPropagationAnalysis(ldva);
+    ContextInsensitiveInterProceduralDataflow ciipd_cpa(cpa, graph);
     ciipd_cpa.runAnalysis();
 
+    analyzedProject = project;
+}
+
+map<string, Footprint> FootprintFinder::findFootprints(SgProject *project, KernelInfo *kernelInfo)
+{
+    runDataflowAnalyses(project);
+
     //Doing this as an analysis turned out to be unneccesary...
-    FootprintAnalysis footprintAnalysis(&cpa, kernelInfo);
+    FootprintAnalysis footprintAnalysis(cpa, kernelInfo);
     UnstructuredPassInterAnalysis upia_footprint(footprintAnalysis);
     upia_footprint.runAnalysis();
 
@@ -97,11 +97,19 @@ private:
 
 };
 
+// The dataflow analyses are run once per project, and shared by all the kernels of the
+// file, so all kernels must be analyzed before the AST is transformed
 class FootprintFinder
 {
 public:
     map<string, Footprint> findFootprints(SgProject* project, KernelInfo* kernelInfo);
 
+private:
+    void runDataflowAnalyses(SgProject* project);
+
+    static SgProject* analyzedProject;
+    static LiveDeadVarsAnalysis* ldva;
+    static MultiConstantPropagationAnalysis* cpa;
 };
 
 #endif // FOOTPRINTFINDER_H
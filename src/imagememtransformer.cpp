@@ -9,6 +9,7 @@
 #include "imagememtransformer.h"
 #include "argument.h"
 #include "astutil.h"
+#include "astindex.h"
 #include "kernelinfo.h"
 
 #include <vector>
@@ -117,10 +118,15 @@ void ImageMemTransformer::updateImageMemReferences()
 
 void ImageMemTransformer::addSampler(){
 
-    auto globals = NodeQuery::querySubTree(project, V_SgGlobal);
+    auto globals = AstIndex::getInstance()->query(project, V_SgGlobal);
 
     for(SgNode* node : globals){
         SgGlobal* global = isSgGlobal(node);
+
+        // With several kernels in the file, the sampler may already have been added
+        if(global->lookup_variable_symbol("sampler") != NULL){
+            continue;
+        }
         
         //These are striclty speaking not var refs, but macros?
         auto normCoordsFalse = buildVarRefExp("CLK_NORMALIZED_COORDS_FALSE", global);
@@ -10,6 +10,7 @@
 #include "kernelinfo.h"
 #include "parameters.h"
 #include "astutil.h"
+#include "astindex.h"
 #include "uniquenamegenerator.h"
 #include "boundryguardinserter.h"
 
@@ -67,7 +68,7 @@ void IndexChanger::addPadding(SgNode *arrayRefNode)
     SgExpression* indexCalculation;
     string arrayName = varRef->get_symbol()->get_name().str();
     if(settings.generateMPI && kernelInfo.needsMpiScatter(arrayName)){
-        HaloSize hs = kernelInfo.getFootprintTable().at(arrayName).computeHaloSize();
+        HaloSize hs = kernelInfo.getHaloSize(arrayName);
         SgExpression* paddedX = buildAddOp(buildIntVal(hs.left), copyExpression(x));
         SgExpression* paddedY = buildAddOp(buildIntVal(hs.up), copyExpression(y));
 
@@ -82,7 +83,7 @@ void IndexChanger::addPadding(SgNode *arrayRefNode)
         SgStatement* parent = AstUtil::getParentStatement(arrayRefNode);
         insertStatementBefore(parent, isTopDecl);
 
-        HaloSize hs = kernelInfo.getFootprintTable().at(arrayName).computeHaloSize();
+        HaloSize hs = kernelInfo.getHaloSize(arrayName);
         SgExpression* paddedY = buildConditionalExp(buildVarRefExp(isTop,scope), copyExpression(y), buildAddOp(buildIntVal(hs.up), copyExpression(y)));
 
 
@@ -92,7 +93,7 @@ void IndexChanger::addPadding(SgNode *arrayRefNode)
 
 void IndexChanger::replaceIndices(SgProject *project)
 {
-    Rose_STL_Container<SgNode*> arrRefNodes = NodeQuery::querySubTree(project, V_SgPntrArrRefExp);
+    Rose_STL_Container<SgNode*> arrRefNodes = AstIndex::getInstance()->query(project, V_SgPntrArrRefExp);
 
     for(SgNode* arrRefNode : arrRefNodes ){
         SgPntrArrRefExp* arrRef = isSgPntrArrRefExp(arrRefNode);
@@ -112,7 +113,7 @@ void IndexChanger::replaceIndices(SgProject *project)
 
 void IndexChanger::addPaddings(SgProject *project)
 {
-    Rose_STL_Container<SgNode*> arrRefNodes = NodeQuery::querySubTree(project, V_SgPntrArrRefExp);
+    Rose_STL_Container<SgNode*> arrRefNodes = AstIndex::getInstance()->query(project, V_SgPntrArrRefExp);
 
     for(SgNode* arrRefNode : arrRefNodes ){
         SgPntrArrRefExp* arrRef = isSgPntrArrRefExp(arrRefNode);
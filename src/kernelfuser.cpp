@@ -0,0 +1,608 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "kernelfuser.h"
+
+#include "pragma.h"
+#include "argument.h"
+#include "astutil.h"
+#include "astindex.h"
+#include "uniquenamegenerator.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+KernelFuser::KernelFuser(SgProject *project, Settings settings) : project(project), settings(settings)
+{
+}
+
+
+// Fusions are done in the order of the producers in the file, so that in a chain a:b, b:c,
+// the code of a is already part of b when b is fused into c
+void KernelFuser::fuseKernels()
+{
+    map<string, string> fusions;
+
+    Rose_STL_Container<SgNode*> pragmaNodes = AstIndex::getInstance()->query(project, V_SgPragmaDeclaration);
+    for(SgNode* n : pragmaNodes){
+        SgPragmaDeclaration* pragmaDecl = isSgPragmaDeclaration(n);
+        string pragmaString = pragmaDecl->get_pragma()->get_pragma();
+
+        if(pragmaString.find("clite") >= pragmaString.size()){
+            continue;
+        }
+
+        try{
+            Pragma p(pragmaString);
+            if(p.option != FUSE){
+                continue;
+            }
+            for(pair<string,string> ps : p.pairValues){
+                fusions[ps.first] = ps.second;
+            }
+        }
+        catch(...){
+            cerr << "Error parsing pragma. Exiting..." << endl;
+            exit(-1);
+        }
+        removeStatement(pragmaDecl);
+    }
+    AstIndex::getInstance()->invalidate();
+
+    while(!fusions.empty()){
+        vector<SgFunctionDeclaration*> kernels = AstUtil::findKernelDeclarations(project);
+
+        int producer = 0;
+        while(producer < kernels.size() && fusions.count(kernels[producer]->get_name().getString()) == 0){
+            producer++;
+        }
+        if(producer == kernels.size()){
+            cerr << "ERROR: Could not find kernel " << fusions.begin()->first << " to fuse. Exiting..." << endl;
+            exit(-1);
+        }
+
+        string producerName = kernels[producer]->get_name().getString();
+        string consumerName = fusions[producerName];
+        fusions.erase(producerName);
+
+        if(producer + 1 == kernels.size() || kernels[producer + 1]->get_name().getString() != consumerName){
+            cerr << "ERROR: Can not fuse " << producerName << " into " << consumerName << ", the consumer must be the kernel just after the producer. Exiting..." << endl;
+            exit(-1);
+        }
+
+        int previousKernelEnd = producer > 0 ? kernels[producer - 1]->get_endOfConstruct()->get_line() : 0;
+
+        cout << "[Fusion] Fusing " << producerName << " into " << consumerName << endl;
+        fuse(kernels[producer], kernels[producer + 1], previousKernelEnd);
+
+        AstIndex::getInstance()->invalidate();
+    }
+}
+
+
+void KernelFuser::fuse(SgFunctionDeclaration *producer, SgFunctionDeclaration *consumer, int previousKernelEnd)
+{
+    string producerName = producer->get_name().getString();
+    string consumerName = consumer->get_name().getString();
+
+    findProducedImages(producer);
+
+    set<string> intermediates;
+    for(SgInitializedName* argument : consumer->get_args()){
+        string name = argument->get_name().getString();
+        if(AstUtil::isImageType(argument->get_type()) && producedImages.count(name) == 1){
+            intermediates.insert(name);
+        }
+    }
+    if(intermediates.empty()){
+        cerr << "ERROR: Can not fuse " << producerName << " into " << consumerName << ", the consumer reads none of the images of the producer. Exiting..." << endl;
+        exit(-1);
+    }
+
+    // The pragmas of both kernels, which all apply to the fused kernel
+    vector<SgPragmaDeclaration*> pragmas = findPragmas(previousKernelEnd, consumer->get_endOfConstruct()->get_line());
+    vector<SgPragmaDeclaration*> consumerPragmas = findPragmas(producer->get_endOfConstruct()->get_line(), consumer->get_endOfConstruct()->get_line());
+    map<string, BoundaryCondition> boundaryConditions = findBoundaryConditions(consumerPragmas);
+
+    addProducerArguments(producer, consumer);
+    fusedPositions.clear();
+
+    Rose_STL_Container<SgNode*> arrRefNodes = NodeQuery::querySubTree(consumer->get_definition(), V_SgPntrArrRefExp);
+    for(SgNode* arrRefNode : arrRefNodes){
+        SgPntrArrRefExp* arrRef = isSgPntrArrRefExp(arrRefNode);
+        if(isSgPntrArrRefExp(arrRef->get_parent())){
+            continue;
+        }
+
+        string image = AstUtil::getArrayName(arrRef);
+        if(intermediates.count(image) == 0){
+            continue;
+        }
+
+        SgBinaryOp* parentOp = isSgBinaryOp(arrRef->get_parent());
+        if(parentOp && (isSgAssignOp(parentOp) || isSgCompoundAssignOp(parentOp)) && parentOp->get_lhs_operand() == arrRef){
+            cerr << "ERROR: Can not fuse " << producerName << " into " << consumerName << ", the consumer writes " << image << ". Exiting..." << endl;
+            exit(-1);
+        }
+
+        inlineProducer(arrRef, image, producer, consumer, intermediates, boundaryConditions);
+    }
+
+    for(string image : intermediates){
+        cout << "[Fusion] Removed intermediate image " << image << endl;
+    }
+
+    removeIntermediateArguments(consumer, intermediates);
+    rewritePragmas(pragmas, intermediates);
+    removeStatement(producer);
+
+    AstUtil::fixUniqueNameAttributes(project);
+}
+
+
+// The producer must write each of its output images exactly once, at the position of the
+// thread, in a statement at the top level of the kernel. Its code is inlined into the
+// consumer, where a return would end the consumer too, so it can only return at the end.
+void KernelFuser::findProducedImages(SgFunctionDeclaration *producer)
+{
+    producedImages.clear();
+
+    SgStatementPtrList& statements = producer->get_definition()->get_body()->get_statements();
+
+    Rose_STL_Container<SgNode*> returnNodes = NodeQuery::querySubTree(producer->get_definition(), V_SgReturnStmt);
+    for(SgNode* n : returnNodes){
+        if(statements.empty() || n != statements.back()){
+            cerr << "ERROR: Can not fuse " << producer->get_name().getString() << ", it returns before the end of the kernel. Exiting..." << endl;
+            exit(-1);
+        }
+    }
+    for(int i = 0; i < statements.size(); i++){
+        SgExprStatement* exprStatement = isSgExprStatement(statements[i]);
+        if(!exprStatement){
+            continue;
+        }
+
+        SgAssignOp* assignOp = isSgAssignOp(exprStatement->get_expression());
+        if(!assignOp || !isSgPntrArrRefExp(assignOp->get_lhs_operand())){
+            continue;
+        }
+
+        SgPntrArrRefExp* arrRef = isSgPntrArrRefExp(assignOp->get_lhs_operand());
+        SgPntrArrRefExp* middle = isSgPntrArrRefExp(arrRef->get_lhs_operand());
+        SgVarRefExp* x = middle ? isSgVarRefExp(middle->get_rhs_operand()) : NULL;
+        SgVarRefExp* y = isSgVarRefExp(arrRef->get_rhs_operand());
+
+        if(x && y && x->get_symbol()->get_name() == "idx" && y->get_symbol()->get_name() == "idy"){
+            string image = AstUtil::getArrayName(arrRef);
+            if(producedImages.count(image) == 1){
+                cerr << "ERROR: Can not fuse " << producer->get_name().getString() << ", it writes " << image << " more than once. Exiting..." << endl;
+                exit(-1);
+            }
+            producedImages[image] = i;
+        }
+    }
+
+    Rose_STL_Container<SgNode*> varRefNodes = NodeQuery::querySubTree(producer->get_definition(), V_SgVarRefExp);
+    map<string, int> nReferences;
+    for(SgNode* n : varRefNodes){
+        nReferences[isSgVarRefExp(n)->get_symbol()->get_name().getString()]++;
+    }
+
+    for(pair<string, int> produced : producedImages){
+        if(nReferences[produced.first] != 1){
+            cerr << "ERROR: Can not fuse " << producer->get_name().getString() << ", it uses " << produced.first << " outside of the statement writing it. Exiting..." << endl;
+            exit(-1);
+        }
+    }
+}
+
+
+// Arguments of the producer with the same name as an argument of the consumer are the
+// same argument. The others are added to the consumer.
+void KernelFuser::addProducerArguments(SgFunctionDeclaration *producer, SgFunctionDeclaration *consumer)
+{
+    argumentSymbols.clear();
+    SgFunctionDefinition* consumerDefinition = consumer->get_definition();
+
+    for(SgInitializedName* argument : producer->get_args()){
+        string name = argument->get_name().getString();
+        if(producedImages.count(name) == 1){
+            continue;
+        }
+
+        SgInitializedName* consumerArgument = NULL;
+        for(SgInitializedName* a : consumer->get_args()){
+            if(a->get_name().getString() == name){
+                consumerArgument = a;
+            }
+        }
+
+        if(consumerArgument){
+            if(consumerArgument->get_type()->unparseToString() != argument->get_type()->unparseToString()){
+                cerr << "ERROR: Can not fuse, " << name << " has different types in " << producer->get_name().getString() << " and " << consumer->get_name().getString() << ". Exiting..." << endl;
+                exit(-1);
+            }
+            argumentSymbols[name] = isSgVariableSymbol(consumerArgument->search_for_symbol_from_symbol_table());
+            continue;
+        }
+
+        cout << "[Fusion] Adding argument " << name << endl;
+
+        SgInitializedName* newArg = buildInitializedName(name, argument->get_type());
+        consumer->append_arg(newArg);
+        newArg->set_scope(consumerDefinition);
+
+        SgVariableSymbol* varSymbol = new SgVariableSymbol(newArg);
+        consumerDefinition->insert_symbol(SgName(name), varSymbol);
+        argumentSymbols[name] = varSymbol;
+    }
+}
+
+
+// Replaces the read arrRef of an intermediate image with the value computed by a copy of the
+// producer body, with idx and idy replaced by the position read. Reads outside the image give
+// the value of the consumer's boundary condition for the intermediate image, as they did
+// before fusion. One copy computes all the intermediate images with the same boundary
+// condition, and is reused by later reads of any of them at the same position, see
+// findFusedPosition.
+void KernelFuser::inlineProducer(SgPntrArrRefExp *arrRef, string image, SgFunctionDeclaration *producer, SgFunctionDeclaration *consumer, set<string> intermediates, map<string, BoundaryCondition> boundaryConditions)
+{
+    SgPntrArrRefExp* middle = isSgPntrArrRefExp(arrRef->get_lhs_operand());
+    SgExpression* x = middle->get_rhs_operand();
+    SgExpression* y = arrRef->get_rhs_operand();
+
+    SgStatement* parentStatement = AstUtil::getParentStatement(arrRef);
+    SgBasicBlock* scope = isSgBasicBlock(parentStatement->get_parent());
+    if(!scope){
+        cerr << "ERROR: Can not fuse into " << consumer->get_name().getString() << ", " << image << " is read outside of a block. Exiting..." << endl;
+        exit(-1);
+    }
+
+    bool atThread = isSgVarRefExp(x) && isSgVarRefExp(x)->get_symbol()->get_name() == "idx" &&
+                    isSgVarRefExp(y) && isSgVarRefExp(y)->get_symbol()->get_name() == "idy";
+    BoundaryCondition boundaryCondition = boundaryConditions[image];
+
+    string key = x->unparseToString() + "," + y->unparseToString();
+    if(!atThread){
+        key += boundaryCondition == CONSTANT ? ",constant" : ",clamped";
+    }
+
+    FusedPosition* position = findFusedPosition(scope, parentStatement, key);
+    if(position){
+        replaceExpression(arrRef, buildVarRefExp(position->valueNames[image], scope));
+        return;
+    }
+
+    // The images computed by this copy
+    set<string> images;
+    for(string intermediate : intermediates){
+        if(atThread || boundaryConditions[intermediate] == boundaryCondition){
+            images.insert(intermediate);
+        }
+    }
+
+    FusedPosition newPosition;
+    newPosition.scope = scope;
+    newPosition.statement = parentStatement;
+    newPosition.key = key;
+    Rose_STL_Container<SgNode*> indexRefs = NodeQuery::querySubTree(x, V_SgVarRefExp);
+    Rose_STL_Container<SgNode*> yRefs = NodeQuery::querySubTree(y, V_SgVarRefExp);
+    indexRefs.insert(indexRefs.end(), yRefs.begin(), yRefs.end());
+    for(SgNode* n : indexRefs){
+        newPosition.indexVariables.insert(isSgVarRefExp(n)->get_symbol()->get_name().getString());
+    }
+
+    UniqueNameGenerator* ung = UniqueNameGenerator::getInstance();
+    for(string computed : images){
+        SgType* imageType = NULL;
+        for(SgInitializedName* argument : consumer->get_args()){
+            if(argument->get_name().getString() == computed){
+                imageType = argument->get_type();
+            }
+        }
+
+        string valueName = ung->generate("fused_" + computed);
+        newPosition.valueNames[computed] = valueName;
+
+        SgAssignInitializer* initializer = NULL;
+        if(!atThread && boundaryCondition == CONSTANT){
+            initializer = buildAssignInitializer(buildIntVal(0), buildPixelType(imageType));
+        }
+        SgVariableDeclaration* valueDecl = buildVariableDeclaration(valueName, buildPixelType(imageType), initializer, scope);
+        insertStatementBefore(parentStatement, valueDecl);
+    }
+
+    // The statements writing the images computed assign the values instead, and the
+    // statements writing the other images are dropped
+    SgBasicBlock* body = isSgBasicBlock(copyStatement(producer->get_definition()->get_body()));
+    renameLocals(producer->get_definition()->get_body(), body);
+    SgStatementPtrList statements = body->get_statements();
+    for(pair<string, int> produced : producedImages){
+        SgStatement* write = statements[produced.second];
+        if(images.count(produced.first) == 1){
+            SgAssignOp* assignOp = isSgAssignOp(isSgExprStatement(write)->get_expression());
+            SgExpression* value = copyExpression(assignOp->get_rhs_operand());
+            replaceStatement(write, buildAssignStatement(buildVarRefExp(newPosition.valueNames[produced.first], scope), value));
+        }
+        else{
+            removeStatement(write);
+        }
+    }
+    if(isSgReturnStmt(statements.back())){
+        removeStatement(statements.back());
+    }
+
+    if(atThread){
+        insertStatementBefore(parentStatement, body);
+        rebindReferences(body, producer, x, y);
+    }
+    else if(boundaryCondition == CONSTANT){
+        SgExpression* inX = buildAndOp(buildGreaterOrEqualOp(copyExpression(x), buildIntVal(0)), buildLessThanOp(copyExpression(x), buildOpaqueVarRefExp("GS_X", scope)));
+        SgExpression* inY = buildAndOp(buildGreaterOrEqualOp(copyExpression(y), buildIntVal(0)), buildLessThanOp(copyExpression(y), buildOpaqueVarRefExp("GS_Y", scope)));
+        SgIfStmt* guard = buildIfStmt(buildAndOp(inX, inY), body, NULL);
+        insertStatementBefore(parentStatement, guard);
+        rebindReferences(body, producer, x, y);
+    }
+    else{
+        string xName = ung->generate("fused_x");
+        string yName = ung->generate("fused_y");
+
+        insertStatementBefore(parentStatement, body);
+        SgVarRefExp* clampedX = buildOpaqueVarRefExp(xName, body);
+        SgVarRefExp* clampedY = buildOpaqueVarRefExp(yName, body);
+        rebindReferences(body, producer, clampedX, clampedY);
+
+        SgFunctionCallExp* maxX = buildFunctionCallExp("max", buildIntType(), buildExprListExp(buildIntVal(0), copyExpression(x)), body);
+        SgFunctionCallExp* minX = buildFunctionCallExp("min", buildIntType(), buildExprListExp(buildSubtractOp(buildOpaqueVarRefExp("GS_X", body), buildIntVal(1)), maxX), body);
+        SgFunctionCallExp* maxY = buildFunctionCallExp("max", buildIntType(), buildExprListExp(buildIntVal(0), copyExpression(y)), body);
+        SgFunctionCallExp* minY = buildFunctionCallExp("min", buildIntType(), buildExprListExp(buildSubtractOp(buildOpaqueVarRefExp("GS_Y", body), buildIntVal(1)), maxY), body);
+
+        body->prepend_statement(buildVariableDeclaration(yName, buildIntType(), buildAssignInitializer(minY, buildIntType()), body));
+        body->prepend_statement(buildVariableDeclaration(xName, buildIntType(), buildAssignInitializer(minX, buildIntType()), body));
+    }
+
+    fusedPositions.push_back(newPosition);
+    replaceExpression(arrRef, buildVarRefExp(newPosition.valueNames[image], scope));
+}
+
+
+// The values computed for an earlier read at the same position can be used if that read is
+// in an earlier statement of the same block, or the same statement, and no variable of the
+// position is assigned from that statement up to and including this one
+FusedPosition* KernelFuser::findFusedPosition(SgBasicBlock *scope, SgStatement *statement, string key)
+{
+    SgStatementPtrList& statements = scope->get_statements();
+    int current = find(statements.begin(), statements.end(), statement) - statements.begin();
+
+    for(FusedPosition& position : fusedPositions){
+        if(position.scope != scope || position.key != key){
+            continue;
+        }
+
+        int first = find(statements.begin(), statements.end(), position.statement) - statements.begin();
+        if(first > current || current == (int)statements.size()){
+            continue;
+        }
+
+        bool assigned = false;
+        for(int i = first; i <= current && !assigned; i++){
+            Rose_STL_Container<SgNode*> expressions = NodeQuery::querySubTree(statements[i], V_SgExpression);
+            for(SgNode* n : expressions){
+                SgExpression* target = NULL;
+                if(isSgAssignOp(n) || isSgCompoundAssignOp(n)){
+                    target = isSgBinaryOp(n)->get_lhs_operand();
+                }
+                else if(isSgPlusPlusOp(n) || isSgMinusMinusOp(n)){
+                    target = isSgUnaryOp(n)->get_operand();
+                }
+                SgVarRefExp* varRef = isSgVarRefExp(target);
+                if(varRef && position.indexVariables.count(varRef->get_symbol()->get_name().getString()) == 1){
+                    assigned = true;
+                    break;
+                }
+            }
+        }
+
+        if(!assigned){
+            return &position;
+        }
+    }
+
+    return NULL;
+}
+
+
+// The local variables of the copy are given unique names, so that they can neither hide the
+// variables of the consumer used in the position read, nor redeclare variables of the
+// consumer. The declarations of the copy are in the same order as those of the producer.
+void KernelFuser::renameLocals(SgBasicBlock *producerBody, SgBasicBlock *copy)
+{
+    localNames.clear();
+    UniqueNameGenerator* ung = UniqueNameGenerator::getInstance();
+
+    Rose_STL_Container<SgNode*> originalDecls = NodeQuery::querySubTree(producerBody, V_SgVariableDeclaration);
+    Rose_STL_Container<SgNode*> copiedDecls = NodeQuery::querySubTree(copy, V_SgVariableDeclaration);
+
+    for(int i = 0; i < originalDecls.size() && i < copiedDecls.size(); i++){
+        SgInitializedNamePtrList& originalNames = isSgVariableDeclaration(originalDecls[i])->get_variables();
+        SgInitializedNamePtrList& copiedNames = isSgVariableDeclaration(copiedDecls[i])->get_variables();
+        SgScopeStatement* scope = getEnclosingScope(copiedDecls[i]);
+
+        for(int j = 0; j < originalNames.size() && j < copiedNames.size(); j++){
+            SgInitializedName* copiedName = copiedNames[j];
+            SgName oldName = copiedName->get_name();
+            string newName = ung->generate(oldName.getString());
+
+            SgVariableSymbol* oldSymbol = scope->lookup_variable_symbol(oldName);
+            if(oldSymbol && oldSymbol->get_declaration() == copiedName){
+                scope->remove_symbol(oldSymbol);
+            }
+            copiedName->set_name(SgName(newName));
+            copiedName->set_scope(scope);
+            scope->insert_symbol(SgName(newName), new SgVariableSymbol(copiedName));
+
+            localNames[originalNames[j]] = newName;
+        }
+    }
+}
+
+
+// The copied body still refers to the symbols of the producer. idx and idy are replaced by
+// the position read, the arguments by those of the consumer, and the local variables are
+// looked up again by their new names, to find the copies.
+void KernelFuser::rebindReferences(SgNode *body, SgFunctionDeclaration *producer, SgExpression *x, SgExpression *y)
+{
+    SgFunctionDefinition* producerDefinition = producer->get_definition();
+
+    Rose_STL_Container<SgNode*> varRefNodes = NodeQuery::querySubTree(body, V_SgVarRefExp);
+    for(SgNode* n : varRefNodes){
+        SgVarRefExp* varRef = isSgVarRefExp(n);
+        SgInitializedName* declaration = varRef->get_symbol()->get_declaration();
+        string name = varRef->get_symbol()->get_name().getString();
+
+        if(name == "idx"){
+            replaceExpression(varRef, copyExpression(x));
+        }
+        else if(name == "idy"){
+            replaceExpression(varRef, copyExpression(y));
+        }
+        else if(argumentSymbols.count(name) == 1 && declaration->get_scope() == producerDefinition){
+            replaceExpression(varRef, buildVarRefExp(argumentSymbols[name]));
+        }
+        else if(isAncestor(producerDefinition, declaration)){
+            string localName = localNames.count(declaration) == 1 ? localNames[declaration] : name;
+            replaceExpression(varRef, buildVarRefExp(localName, getScope(varRef)));
+        }
+    }
+}
+
+
+void KernelFuser::removeIntermediateArguments(SgFunctionDeclaration *consumer, set<string> intermediates)
+{
+    Rose_STL_Container<SgNode*> varRefNodes = NodeQuery::querySubTree(consumer->get_definition(), V_SgVarRefExp);
+    for(SgNode* n : varRefNodes){
+        string name = isSgVarRefExp(n)->get_symbol()->get_name().getString();
+        if(intermediates.count(name) == 1){
+            cerr << "ERROR: Can not fuse into " << consumer->get_name().getString() << ", " << name << " is used other than as an image. Exiting..." << endl;
+            exit(-1);
+        }
+    }
+
+    SgInitializedNamePtrList& args = consumer->get_parameterList()->get_args();
+    args.erase(remove_if(args.begin(), args.end(), [&] (SgInitializedName* arg) -> bool {return intermediates.count(arg->get_name().getString()) == 1;}), args.end());
+}
+
+
+map<string, BoundaryCondition> KernelFuser::findBoundaryConditions(vector<SgPragmaDeclaration *> pragmas)
+{
+    map<string, BoundaryCondition> boundaryConditions;
+    for(pair<string, int> produced : producedImages){
+        boundaryConditions[produced.first] = settings.boundaryCondition;
+    }
+
+    for(SgPragmaDeclaration* pragmaDecl : pragmas){
+        Pragma p(pragmaDecl->get_pragma()->get_pragma());
+        if(p.option != BOUNDARY_COND){
+            continue;
+        }
+        for(pair<string,string> ps : p.pairValues){
+            if(ps.second.compare("constant") == 0){
+                boundaryConditions[ps.first] = CONSTANT;
+            }
+            if(ps.second.compare("clamped") == 0){
+                boundaryConditions[ps.first] = CLAMPED;
+            }
+        }
+    }
+
+    return boundaryConditions;
+}
+
+
+// The intermediate images are removed from the pragmas of both kernels, which then apply to
+// the fused kernel. Pragmas left empty are removed.
+void KernelFuser::rewritePragmas(vector<SgPragmaDeclaration *> pragmas, set<string> intermediates)
+{
+    for(SgPragmaDeclaration* pragmaDecl : pragmas){
+        string pragmaString = pragmaDecl->get_pragma()->get_pragma();
+        Pragma p(pragmaString);
+
+        vector<string> items;
+        bool changed = false;
+        if(p.option == PIXEL || p.option == BOUNDARY_COND){
+            for(pair<string,string> ps : p.pairValues){
+                if(intermediates.count(ps.first) == 1){
+                    changed = true;
+                    continue;
+                }
+                items.push_back(ps.first + ":" + ps.second);
+            }
+        }
+        else if(p.option != GRID_SIZE){
+            for(string v : p.values){
+                if(intermediates.count(v) == 1){
+                    changed = true;
+                    continue;
+                }
+                items.push_back(v);
+            }
+        }
+
+        if(!changed){
+            continue;
+        }
+
+        if(items.empty()){
+            removeStatement(pragmaDecl);
+            continue;
+        }
+
+        string newPragma = pragmaString.substr(0, pragmaString.find("(")) + "(";
+        for(int i = 0; i < items.size(); i++){
+            newPragma += (i > 0 ? ", " : "") + items[i];
+        }
+        newPragma += ")";
+
+        pragmaDecl->get_pragma()->set_pragma(newPragma);
+    }
+}
+
+
+// Pragmas after firstLine, up to and including lastLine, as KernelInfo assigns them to kernels
+vector<SgPragmaDeclaration*> KernelFuser::findPragmas(int firstLine, int lastLine)
+{
+    vector<SgPragmaDeclaration*> pragmas;
+
+    Rose_STL_Container<SgNode*> pragmaNodes = AstIndex::getInstance()->query(project, V_SgPragmaDeclaration);
+    for(SgNode* n : pragmaNodes){
+        SgPragmaDeclaration* pragmaDecl = isSgPragmaDeclaration(n);
+        int line = pragmaDecl->get_file_info()->get_line();
+        string pragmaString = pragmaDecl->get_pragma()->get_pragma();
+
+        if(line > firstLine && line <= lastLine && pragmaString.find("clite") < pragmaString.size()){
+            pragmas.push_back(pragmaDecl);
+        }
+    }
+
+    return pragmas;
+}
+
+
+SgType* KernelFuser::buildPixelType(SgType *imageType)
+{
+    switch(Argument::convertType(imageType, settings).baseType){
+    case INT:
+        return buildIntType();
+    case UCHAR:
+        return buildUnsignedCharType();
+    default:
+        return buildFloatType();
+    }
+}
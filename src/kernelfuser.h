@@ -0,0 +1,75 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef KERNELFUSER_H
+#define KERNELFUSER_H
+
+#include "rose.h"
+
+#include "settings.h"
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+
+using namespace std;
+
+// Values of the intermediate images computed by one inlined copy of the producer, for the
+// position given by key, before statement in scope
+class FusedPosition
+{
+public:
+    SgBasicBlock* scope;
+    SgStatement* statement;
+    string key;
+    map<string, string> valueNames;
+
+    // Variables used in the position, which must not change before the values are reused
+    set<string> indexVariables;
+};
+
+// Fuses producer -> consumer kernels given by "fuse(producer:consumer)" pragmas, before the
+// kernels are analyzed. Every read of an image written by the producer is replaced by the
+// producer's code, evaluated at the position read, so the consumer recomputes the values in
+// registers instead of reading them back from global memory. The fused kernel keeps the name
+// of the consumer, and the producer and the intermediate images are removed.
+class KernelFuser
+{
+public:
+    KernelFuser(SgProject* project, Settings settings);
+
+    void fuseKernels();
+
+private:
+    void fuse(SgFunctionDeclaration* producer, SgFunctionDeclaration* consumer, int previousKernelEnd);
+    void findProducedImages(SgFunctionDeclaration* producer);
+    void addProducerArguments(SgFunctionDeclaration* producer, SgFunctionDeclaration* consumer);
+    void inlineProducer(SgPntrArrRefExp* arrRef, string image, SgFunctionDeclaration* producer, SgFunctionDeclaration* consumer, set<string> intermediates, map<string, BoundaryCondition> boundaryConditions);
+    FusedPosition* findFusedPosition(SgBasicBlock* scope, SgStatement* statement, string key);
+    void renameLocals(SgBasicBlock* producerBody, SgBasicBlock* copy);
+    void rebindReferences(SgNode* body, SgFunctionDeclaration* producer, SgExpression* x, SgExpression* y);
+    void removeIntermediateArguments(SgFunctionDeclaration* consumer, set<string> intermediates);
+    map<string, BoundaryCondition> findBoundaryConditions(vector<SgPragmaDeclaration*> pragmas);
+    void rewritePragmas(vector<SgPragmaDeclaration*> pragmas, set<string> intermediates);
+    vector<SgPragmaDeclaration*> findPragmas(int firstLine, int lastLine);
+    SgType* buildPixelType(SgType* imageType);
+
+    SgProject* project;
+    Settings settings;
+
+    // Position, in the producer body, of the statement writing each produced image
+    map<string, int> producedImages;
+    // Symbols in the consumer for the arguments of the producer
+    map<string, SgVariableSymbol*> argumentSymbols;
+    // Names of the copies of the local variables of the producer, see renameLocals
+    map<SgInitializedName*, string> localNames;
+    // Positions computed in the consumer, see inlineProducer
+    vector<FusedPosition> fusedPositions;
+};
+
+#endif // KERNELFUSER_H
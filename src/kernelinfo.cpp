@@ -8,17 +8,19 @@
 #include "rose.h"
 
 #include "astutil.h"
+#include "astindex.h"
 #include "pragma.h"
 #include "type.h"
 #include "filehandler.h"
 #include "kernelinfo.h"
 #include "argument.h"
+#include "passtimer.h"
 
 using namespace SageInterface;
 using namespace std;
 
 
-KernelInfo::KernelInfo(SgProject *project, Settings settings) : project(project), settings(settings)
+KernelInfo::KernelInfo(SgProject *project, Settings settings, string kernelName) : project(project), settings(settings), kernelName(kernelName)
 {
     this->constantArrays = NULL;
     this->readOnlyArrays = NULL;
@@ -28,11 +30,14 @@ KernelInfo::KernelInfo(SgProject *project, Settings settings) : project(project)
     this->pixelTypes = NULL;
     this->writeOnlyArrays = NULL;
     this->allArrays = NULL;
+    this->footprintTable = NULL;
+    this->haloSizes = NULL;
+    this->otherKernels = new set<string>();
 }
 
 void KernelInfo::findKernelName()
 {
-    Rose_STL_Container<SgNode*> nodes = NodeQuery::querySubTree(project, V_SgFunctionDeclaration);
+    Rose_STL_Container<SgNode*> nodes = AstIndex::getInstance()->query(project, V_SgFunctionDeclaration);
     for(SgNode* node : nodes){
         SgFunctionDeclaration* funcDef = isSgFunctionDeclaration(node);
 
@@ -42,6 +47,44 @@ void KernelInfo::findKernelName()
 }
 
 
+// With several kernels in the file, a pragma applies to the first kernel after it, and
+// pragmas after the last kernel apply to the last kernel
+void KernelInfo::findOtherKernels()
+{
+    vector<SgFunctionDeclaration*> kernels = AstUtil::findKernelDeclarations(project);
+    if(kernels.size() <= 1){
+        return;
+    }
+
+    for(int i = 0; i < kernels.size(); i++){
+        string name = kernels[i]->get_name().getString();
+        if(name != kernelName){
+            otherKernels->insert(name);
+            continue;
+        }
+
+        if(i > 0){
+            firstPragmaLine = kernels[i-1]->get_endOfConstruct()->get_line();
+        }
+        if(i + 1 < kernels.size()){
+            lastPragmaLine = kernels[i]->get_endOfConstruct()->get_line();
+        }
+    }
+}
+
+
+// Code in the other kernels of the file is not part of this kernel. Helper functions are.
+bool KernelInfo::isInKernel(SgNode* node)
+{
+    if(otherKernels->empty()){
+        return true;
+    }
+
+    SgFunctionDeclaration* funcDec = getEnclosingFunctionDeclaration(node);
+    return funcDec == NULL || otherKernels->count(funcDec->get_name().getString()) == 0;
+}
+
+
 void KernelInfo::findImageArrays()
 {
     this->imageArrays = new set<string>();
@@ -67,12 +110,12 @@ set<string>* KernelInfo::findArraysReadFromWrittenTo(bool findArraysReadFrom, bo
     if(!findArraysReadFrom && !findArraysWrittenTo)
         return arrays;
 
-    Rose_STL_Container<SgNode*> arrayRefNodes = NodeQuery::querySubTree(project, V_SgPntrArrRefExp);
+    Rose_STL_Container<SgNode*> arrayRefNodes = AstIndex::getInstance()->query(project, V_SgPntrArrRefExp);
 
     for(SgNode* arrayRefNode : arrayRefNodes){
         SgPntrArrRefExp* arrayRef = isSgPntrArrRefExp(arrayRefNode);
 
-        if(isSgPntrArrRefExp(arrayRef->get_parent())){
+        if(isSgPntrArrRefExp(arrayRef->get_parent()) || !isInKernel(arrayRef)){
             continue;
         }
 
@@ -116,10 +159,15 @@ void KernelInfo::findWriteOnlyArrays()
 void  KernelInfo::parsePragmas(){
     this->pragmas = new set<Pragma>();
     this->gridArrays = new set<string>();
-    Rose_STL_Container<SgNode*> pragmas = NodeQuery::querySubTree(project, V_SgPragmaDeclaration);
+    Rose_STL_Container<SgNode*> pragmas = AstIndex::getInstance()->query(project, V_SgPragmaDeclaration);
 
     for(SgNode* n: pragmas){
         SgPragmaDeclaration* pragmaDecl = isSgPragmaDeclaration(n);
+        int line = pragmaDecl->get_file_info()->get_line();
+        if(line <= firstPragmaLine || line > lastPragmaLine){
+            continue;
+        }
+
         SgPragma* pragma = pragmaDecl->get_pragma();
         string pragmaString = pragma->get_pragma();
 
@@ -163,10 +211,13 @@ void KernelInfo::findConstantArrays()
 void KernelInfo::findUnrollableLoops()
 {
     forLoops = new vector<pair<int,vector<int>*>>();
-    Rose_STL_Container<SgNode*> forLoopNodes = NodeQuery::querySubTree(project, V_SgForStatement);
+    Rose_STL_Container<SgNode*> forLoopNodes = AstIndex::getInstance()->query(project, V_SgForStatement);
 
     for(SgNode* forLoopNode : forLoopNodes){
         SgForStatement* forLoop = isSgForStatement(forLoopNode);
+        if(!isInKernel(forLoop)){
+            continue;
+        }
 
         SgInitializedName* ivar = NULL;
         SgExpression *lb = NULL;
@@ -294,10 +345,10 @@ bool KernelInfo::needsMpiScatter(string argumentName){
         return false;
     }
 
-    if(footprintTable.count(argumentName) == 0){
+    if(footprintTable->count(argumentName) == 0){
         return false;
     }
-    Footprint fp = footprintTable.at(argumentName);
+    Footprint fp = footprintTable->at(argumentName);
 
     if(fp.threadStatic){
         return false;
@@ -320,17 +371,152 @@ bool KernelInfo::needsGridPosArg()
     return false;
 }
 
+// Arrays that are not in the footprint table are never read with an offset, and have no halo
 HaloSize KernelInfo::getHaloSize(string array)
 {
-    return footprintTable.at(array).computeHaloSize();
+    if(haloSizes->count(array) == 0){
+        return HaloSize();
+    }
+    return haloSizes->at(array);
+}
+
+
+// A kernel can be iterated if it reads one image and writes another, with the same pixel
+// type, so that the image written can be read by the next iteration. Several iterations can
+// be done in one launch, by TemporalBlocker, if every pixel only depends on its
+// neighbourhood in the source, and only writes its own pixel in the target.
+void KernelInfo::findIterationImages()
+{
+    for(Pragma p : *pragmas){
+        if(p.option == ITERATE){
+            iterations = max(p.x, 1);
+        }
+    }
+
+    if(settings.generateMPI || settings.generateOMP){
+        if(iterations > 1){
+            cerr << "ERROR: iterate is not supported with MPI or OpenMP. Exiting..." << endl;
+            exit(-1);
+        }
+        return;
+    }
+
+    vector<string> sources, targets;
+    for(string image : *imageArrays){
+        if(readOnlyArrays->count(image) == 1){
+            sources.push_back(image);
+        }
+        else if(writeOnlyArrays->count(image) == 1){
+            targets.push_back(image);
+        }
+    }
+    if(sources.size() != 1 || targets.size() != 1 || getPixelType(sources[0]) != getPixelType(targets[0])){
+        if(iterations > 1){
+            cerr << "ERROR: An iterated kernel must read one image, and write one image with the same pixel type. Exiting..." << endl;
+            exit(-1);
+        }
+        return;
+    }
+    iterationSource = sources[0];
+    iterationTarget = targets[0];
+
+    bool relativeFootprint = hasFootprint(iterationSource) && !footprintTable->at(iterationSource).threadStatic;
+    temporallyBlockable = relativeFootprint && getHaloSize(iterationSource).getMax() > 0 && writesOnlyOwnPixel(iterationTarget);
+
+    if(iterations > 1 && !temporallyBlockable){
+        cout << "[KernelInfo] " << kernelName << " can not do several iterations per launch" << endl;
+    }
+}
+
+
+// True if the image is only assigned to, at [idx][idy], and the kernel has no return but
+// the last statement, so that its body can be run for other pixels than the thread's own
+bool KernelInfo::writesOnlyOwnPixel(string image)
+{
+    SgFunctionDeclaration* funcDec = AstUtil::getFunctionDeclaration(project, kernelName);
+
+    for(SgPntrArrRefExp* arrRef : AstIndex::getInstance()->getArrayReferences(project, image)){
+        if(!AstUtil::is2DArrayRoot(arrRef) || !isInKernel(arrRef)){
+            continue;
+        }
+
+        SgAssignOp* assign = isSgAssignOp(arrRef->get_parent());
+        if(!assign || assign->get_lhs_operand() != arrRef){
+            return false;
+        }
+
+        SgVarRefExp* x = isSgVarRefExp(isSgPntrArrRefExp(arrRef->get_lhs_operand())->get_rhs_operand());
+        SgVarRefExp* y = isSgVarRefExp(arrRef->get_rhs_operand());
+        if(!x || !y || x->get_symbol()->get_name() != "idx" || y->get_symbol()->get_name() != "idy"){
+            return false;
+        }
+    }
+
+    SgStatementPtrList statements = funcDec->get_definition()->get_body()->get_statements();
+    Rose_STL_Container<SgNode*> returns = NodeQuery::querySubTree(funcDec->get_definition(), V_SgReturnStmt);
+    for(SgNode* n : returns){
+        if(statements.empty() || n != statements.back()){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+int KernelInfo::getIterations()
+{
+    return iterations;
+}
+
+
+string KernelInfo::getIterationSource()
+{
+    return iterationSource;
+}
+
+
+string KernelInfo::getIterationTarget()
+{
+    return iterationTarget;
+}
+
+
+bool KernelInfo::canIterate()
+{
+    return !iterationSource.empty();
+}
+
+
+bool KernelInfo::canBlockTemporally()
+{
+    return temporallyBlockable;
+}
+
+
+bool KernelInfo::hasFootprint(string array)
+{
+    return footprintTable->count(array) == 1;
+}
+
+
+void KernelInfo::computeHaloSizes()
+{
+    haloSizes = new map<string,HaloSize>();
+    for(pair<string, Footprint> entry : *footprintTable){
+        haloSizes->insert(make_pair(entry.first, entry.second.computeHaloSize()));
+    }
 }
 
 
 void KernelInfo::scanForInfo()
 {
-    parsePragmas();
+    if(kernelName.empty()){
+        findKernelName();
+    }
+    findOtherKernels();
 
-    findKernelName();
+    parsePragmas();
 
     findUnrollableLoops();
 
@@ -343,8 +529,112 @@ void KernelInfo::scanForInfo()
     setGridFromPragmas();
     setBoundaryConditions();
 
+    PassTimer::getInstance()->begin("FootprintFinder");
     FootprintFinder fpf;
-    footprintTable = fpf.findFootprints(project, this);
+    footprintTable = new map<string,Footprint>(fpf.findFootprints(project, this));
+    computeHaloSizes();
+    PassTimer::getInstance()->end();
+
+    findIterationImages();
+
+    computeSourceHash();
+}
+
+
+// Hash of the parsed input, with all whitespace removed, so that formatting changes
+// do not change the hash, but any change to the kernel or its pragmas does
+void KernelInfo::computeSourceHash()
+{
+    string normalized;
+
+    for(SgFile* file : project->get_fileList()){
+        SgSourceFile* sourceFile = isSgSourceFile(file);
+        if(!sourceFile){
+            continue;
+        }
+
+        for(SgDeclarationStatement* declaration : sourceFile->get_globalScope()->get_declarations()){
+            if(!AstUtil::isFromInputFile(declaration, file)){
+                continue;
+            }
+            SgFunctionDeclaration* funcDec = isSgFunctionDeclaration(declaration);
+            if(funcDec && otherKernels->count(funcDec->get_name().getString())){
+                continue;
+            }
+            for(char c : declaration->unparseToString()){
+                if(!isspace(c)){
+                    normalized += c;
+                }
+            }
+        }
+    }
+
+    sourceHash = StringUtils::hash(normalized);
+}
+
+
+string KernelInfo::getSourceHash()
+{
+    return sourceHash;
+}
+
+
+// Numerical description of the kernel, used to find kernels that are likely to have
+// similar optimal parameters: the number of arrays of each kind, the largest halo in each
+// direction, the number of footprint points, the pixel types, and the unrollable loops
+vector<double> KernelInfo::getSignature()
+{
+    HaloSize maxHalo;
+    int nFootprintPoints = 0;
+    for(pair<string, Footprint> entry : *footprintTable){
+        HaloSize hs = getHaloSize(entry.first);
+        maxHalo.up = max(maxHalo.up, hs.up);
+        maxHalo.down = max(maxHalo.down, hs.down);
+        maxHalo.left = max(maxHalo.left, hs.left);
+        maxHalo.right = max(maxHalo.right, hs.right);
+        nFootprintPoints += entry.second.getPoints()->size();
+    }
+
+    int nPixelTypes[3] = {0,0,0};
+    for(string imageArray : *imageArrays){
+        BaseType pixelType = getPixelType(imageArray);
+        if(pixelType == FLOAT){
+            nPixelTypes[0]++;
+        }
+        else if(pixelType == INT){
+            nPixelTypes[1]++;
+        }
+        else{
+            nPixelTypes[2]++;
+        }
+    }
+
+    int totalTripCount = 0;
+    int maxTripCount = 0;
+    for(pair<int,vector<int>*> forLoop : *forLoops){
+        int tripCount = forLoop.second->back();
+        totalTripCount += tripCount;
+        maxTripCount = max(maxTripCount, tripCount);
+    }
+
+    vector<double> signature;
+    signature.push_back(imageArrays->size());
+    signature.push_back(readOnlyArrays->size());
+    signature.push_back(writeOnlyArrays->size());
+    signature.push_back(constantArrays->size());
+    signature.push_back(maxHalo.up);
+    signature.push_back(maxHalo.down);
+    signature.push_back(maxHalo.left);
+    signature.push_back(maxHalo.right);
+    signature.push_back(nFootprintPoints);
+    signature.push_back(nPixelTypes[0]);
+    signature.push_back(nPixelTypes[1]);
+    signature.push_back(nPixelTypes[2]);
+    signature.push_back(forLoops->size());
+    signature.push_back(totalTripCount);
+    signature.push_back(maxTripCount);
+
+    return signature;
 }
 
 string KernelInfo::getAGridArray()
@@ -387,9 +677,9 @@ set<string>* KernelInfo::getGridArrays()
     return gridArrays;
 }
 
-map<string, Footprint> KernelInfo::getFootprintTable()
+const map<string, Footprint>& KernelInfo::getFootprintTable()
 {
-    return footprintTable;
+    return *footprintTable;
 }
 
 set<string>* KernelInfo::getReadOnlyArrays()
@@ -429,7 +719,7 @@ void KernelInfo::printKernelInfo(){
     cout << esc_char << "[1m" << "== Kernel Info ==" << esc_char << "[0m" << endl;
     cout << "Kernel name: " << this->kernelName << endl;
     cout << "Footprint table:" << endl;
-    for(pair<string, Footprint> f : this->footprintTable){
+    for(pair<string, Footprint> f : *(this->footprintTable)){
         cout << "  " << f.first << " : " << f.second.str() << endl;
     }
 
@@ -493,6 +783,10 @@ void KernelInfo::printKernelInfo(){
         cout << "  " << psb.first << ": " << Type::baseTypeToString(psb.second) << endl;
     }
 
+    if(iterations > 1){
+        cout << "Iterations: " << iterations << " (" << iterationSource << " -> " << iterationTarget << ")" << endl;
+    }
+
     cout << endl;
 }
 
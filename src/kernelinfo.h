@@ -17,13 +17,15 @@
 
 #include <string>
 #include <map>
+#include <set>
+#include <climits>
 
 using namespace std;
 
 class KernelInfo
 {
 public:
-    KernelInfo(SgProject* project, Settings settings);
+    KernelInfo(SgProject* project, Settings settings, string kernelName = "");
     void scanForInfo();
 
 
@@ -37,23 +39,37 @@ public:
     bool isImageArray(string arrayName);
     bool isReadOnlyArray(string arrayName);
     bool isWriteOnlyArray(string arrayName);
+    bool isInKernel(SgNode* node);
 
-    map<string, Footprint> getFootprintTable();
+    const map<string, Footprint>& getFootprintTable();
+    bool hasFootprint(string array);
     BaseType getPixelType(string imageArray);
     set<Pragma>* getPragmas();
     vector<pair<int,vector<int>*>>* getForLoops();
     BoundaryCondition getBoundaryConditionForArray(string array);
     HaloSize getHaloSize(string array);
+    string getSourceHash();
+    vector<double> getSignature();
 
     bool needsMpiScatter(string argumentName);
     bool needsMpiBroadcast(string argumentName);
     bool needsGridPosArg();
 
+    // With iterate(N), the kernel is run N times, each time reading the image written by the
+    // previous time. 1 without the pragma. Kernels without the pragma can still be iterated
+    // by process_iterate() if canIterate().
+    int getIterations();
+    bool canIterate();
+    string getIterationSource();
+    string getIterationTarget();
+    bool canBlockTemporally();
+
     void printKernelInfo();
 
 
 private:
     void findKernelName();
+    void findOtherKernels();
     void findReadOnlyArrays();
     void findWriteOnlyArrays();
     void findConstantArrays();
@@ -65,13 +81,20 @@ private:
     void setReadOnlyArrays(set<string>* strings);
     void setConstantArrays(set<string>* strings);
     void parsePragmas();
+    void computeSourceHash();
+    void computeHaloSizes();
+    void findIterationImages();
+    bool writesOnlyOwnPixel(string image);
     set<string>* findArraysReadFromWrittenTo(bool findArraysReadFrom, bool findArraysWrittenTo);
 
     SgProject* project;
     Settings settings;
     string kernelName;
     set<string>* gridArrays;
-    map<string,Footprint> footprintTable;
+    // The analysis results are computed once, in scanForInfo(), on the input AST, and
+    // shared by all copies of the KernelInfo, like the array sets
+    map<string,Footprint>* footprintTable;
+    map<string,HaloSize>* haloSizes;
     set<string>* allArrays;
     set<string>* readOnlyArrays;
     set<string>* writeOnlyArrays;
@@ -85,6 +108,20 @@ private:
     int gridSizeY = 0;
     int gridSizeZ = 0;
     bool constGridSize = false;
+    string sourceHash;
+
+    // The image read and the image written by an iterated kernel, which are swapped between
+    // iterations, see findIterationImages
+    int iterations = 1;
+    string iterationSource;
+    string iterationTarget;
+    bool temporallyBlockable = false;
+
+    // In files with several kernels, the names of the other kernels, whose code is
+    // ignored by the analysis, and the lines of the pragmas that apply to this kernel
+    set<string>* otherKernels;
+    int firstPragmaLine = 0;
+    int lastPragmaLine = INT_MAX;
 };
 
 #endif // KERNELINFO_H
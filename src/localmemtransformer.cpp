@@ -7,6 +7,7 @@
 
 #include "localmemtransformer.h"
 #include "astutil.h"
+#include "astindex.h"
 #include "kernelinfo.h"
 #include "settings.h"
 #include "uniquenamegenerator.h"
@@ -28,17 +29,18 @@ void LocalMemTransformer::transform()
     for(auto localArrayIterator = params.localMemArrays->begin(); localArrayIterator != params.localMemArrays->end(); ++localArrayIterator){
         string localArray = *localArrayIterator;
         insertSharedMemLoading(funcDef, localArray, localArrayIterator == params.localMemArrays->begin());
+        AstIndex::getInstance()->invalidate();
         replaceGlobalWithSharedLoads(localArray);
         prependLocalIdComputation(loopBody, localArray);
         fixVariableReferences(project);
+        AstIndex::getInstance()->invalidate();
     }
 }
 
 
 SgBasicBlock* LocalMemTransformer::buildLoadingForLoopBody(SgFunctionDeclaration* funcDef, int sharedMemSizeX, int sharedMemSizeY, string localArray)
 {
-    Footprint fp = kernelInfo.getFootprintTable()[localArray];
-    HaloSize hs = fp.computeHaloSize();
+    HaloSize hs = kernelInfo.getHaloSize(localArray);
     SgBasicBlock* block = buildBasicBlock();
 
     string iterVar = "shared_mem_load_i" + localArray;
@@ -86,8 +88,7 @@ SgBasicBlock* LocalMemTransformer::buildLoadingForLoopBody(SgFunctionDeclaration
         block->append_statement(ifOutside);
     }
 
-    SgPntrArrRefExp* localBufferTemp = buildPntrArrRefExp(buildVarRefExp("local_buffer_"+localArray,block),buildVarRefExp("local_col" + localArray,block));
-    SgPntrArrRefExp* localBuffer = buildPntrArrRefExp(localBufferTemp,buildVarRefExp("local_row" + localArray,block));
+    SgPntrArrRefExp* localBuffer = buildLocalBufferRef(localArray, buildVarRefExp("local_col" + localArray,block), buildVarRefExp("local_row" + localArray,block), block);
     SgPntrArrRefExp* globalBufferTemp = buildPntrArrRefExp(buildVarRefExp(localArray,block),buildVarRefExp("global_col" + localArray,block));
     SgPntrArrRefExp* globalBuffer = buildPntrArrRefExp(globalBufferTemp,buildVarRefExp("global_row" + localArray,block));
     SgExprStatement* loadAssignment = buildExprStatement(buildAssignOp(localBuffer, globalBuffer));
@@ -115,6 +116,200 @@ SgForStatement* LocalMemTransformer::buildLoadingLoop(SgFunctionDeclaration* fun
 }
 
 
+// The async copies can not be guarded, and copy between buffers of the same type
+bool LocalMemTransformer::canLoadAsync(string localArray)
+{
+    BaseType pixelType = kernelInfo.getPixelType(localArray);
+    if(settings.generateMPI || settings.generateOMP || (pixelType != FLOAT && pixelType != INT)){
+        cout << "WARNING: LOCAL_MEM_ASYNC needs float or int pixels, and can not be used with MPI or OpenMP. It is ignored for " << localArray << endl;
+        return false;
+    }
+    return true;
+}
+
+
+// Position in the image of element [0][0] of the local buffer
+SgVariableDeclaration* LocalMemTransformer::buildTileOriginDeclaration(int dim, string localArray, SgScopeStatement *funcScope)
+{
+    HaloSize hs = kernelInfo.getHaloSize(localArray);
+    int groupSize = dim == 0 ? params.elementsPerThreadX*params.localSizeX : params.elementsPerThreadY*params.localSizeY;
+    int padding = dim == 0 ? hs.left : hs.up;
+
+    SgFunctionCallExp* getGroupId = buildFunctionCallExp("get_group_id", buildIntType(), buildExprListExp(buildIntVal(dim)), funcScope);
+    SgExpression* origin = buildSubtractOp(buildMultiplyOp(getGroupId, buildIntVal(groupSize)), buildIntVal(padding));
+    string name = (dim == 0 ? "tile_x_" : "tile_y_") + localArray;
+
+    return buildVariableDeclaration(name, buildIntType(), buildAssignInitializer(origin), funcScope);
+}
+
+
+// Work-groups whose tile is completely inside the image copy it with one async copy per line
+// of the local buffer. Rows are contiguous in both the image and the buffer, while columns
+// are copied with a stride of the image width. The other work-groups use the copy loop,
+// whose reads are guarded.
+//
+// if(tile_x_A >= 0 && tile_y_A >= 0 && tile_x_A + sizeX <= A_width && tile_y_A + sizeY <= A_height){
+//     event_t load_event_A = 0;
+//     for(int load_line_A = 0; load_line_A < sizeY; load_line_A++){
+//         load_event_A = async_work_group_copy(&local_buffer_A[load_line_A][0], &A[tile_x_A][tile_y_A + load_line_A], sizeX, load_event_A);
+//     }
+//     wait_group_events(1, &load_event_A);
+// }
+// else{
+//     copy loop
+// }
+SgIfStmt* LocalMemTransformer::buildAsyncLoading(SgForStatement *loadingLoop, int sharedMemSizeX, int sharedMemSizeY, string localArray, SgScopeStatement *funcScope)
+{
+    string tileX = "tile_x_" + localArray;
+    string tileY = "tile_y_" + localArray;
+    string event = "load_event_" + localArray;
+    string line = "load_line_" + localArray;
+
+    bool rowMajor = isRowMajor(kernelInfo.getHaloSize(localArray));
+    int nLines = rowMajor ? sharedMemSizeY : sharedMemSizeX;
+    int lineLength = rowMajor ? sharedMemSizeX : sharedMemSizeY;
+
+    SgExpression* insideX = buildAndOp(buildGreaterOrEqualOp(buildVarRefExp(tileX, funcScope), buildIntVal(0)),
+                                       buildLessOrEqualOp(buildAddOp(buildVarRefExp(tileX, funcScope), buildIntVal(sharedMemSizeX)), buildVarRefExp(localArray + "_width", funcScope)));
+    SgExpression* insideY = buildAndOp(buildGreaterOrEqualOp(buildVarRefExp(tileY, funcScope), buildIntVal(0)),
+                                       buildLessOrEqualOp(buildAddOp(buildVarRefExp(tileY, funcScope), buildIntVal(sharedMemSizeY)), buildVarRefExp(localArray + "_height", funcScope)));
+
+    SgBasicBlock* asyncBlock = buildBasicBlock();
+    SgVariableDeclaration* eventDeclaration = buildVariableDeclaration(event, buildOpaqueType("event_t", funcScope), buildAssignInitializer(buildIntVal(0)), asyncBlock);
+    asyncBlock->append_statement(eventDeclaration);
+
+    SgVariableDeclaration* init = buildVariableDeclaration(line, buildIntType(), buildAssignInitializer(buildIntVal(0)), asyncBlock);
+    SgExprStatement* test = buildExprStatement(buildLessThanOp(buildVarRefExp(line, asyncBlock), buildIntVal(nLines)));
+    SgExpression* inc = buildPlusPlusOp(buildVarRefExp(line, asyncBlock), SgUnaryOp::postfix);
+
+    SgExpression* localLine = buildAddressOfOp(buildPntrArrRefExp(buildPntrArrRefExp(buildVarRefExp("local_buffer_" + localArray, funcScope), buildVarRefExp(line, asyncBlock)), buildIntVal(0)));
+    SgExpression* globalX = buildVarRefExp(tileX, funcScope);
+    SgExpression* globalY = buildVarRefExp(tileY, funcScope);
+    if(rowMajor){
+        globalY = buildAddOp(globalY, buildVarRefExp(line, asyncBlock));
+    }
+    else{
+        globalX = buildAddOp(globalX, buildVarRefExp(line, asyncBlock));
+    }
+    SgExpression* globalLine = buildAddressOfOp(buildPntrArrRefExp(buildPntrArrRefExp(buildVarRefExp(localArray, funcScope), globalX), globalY));
+
+    SgFunctionCallExp* copy;
+    if(rowMajor){
+        SgExprListExp* copyArguments = buildExprListExp(localLine, globalLine, buildIntVal(lineLength), buildVarRefExp(event, asyncBlock));
+        copy = buildFunctionCallExp("async_work_group_copy", buildOpaqueType("event_t", funcScope), copyArguments, funcScope);
+    }
+    else{
+        SgExprListExp* copyArguments = buildExprListExp(localLine, globalLine, buildIntVal(lineLength), buildVarRefExp(localArray + "_width", funcScope), buildVarRefExp(event, asyncBlock));
+        copy = buildFunctionCallExp("async_work_group_strided_copy", buildOpaqueType("event_t", funcScope), copyArguments, funcScope);
+    }
+    SgBasicBlock* copyBody = buildBasicBlock(buildAssignStatement(buildVarRefExp(event, asyncBlock), copy));
+    asyncBlock->append_statement(buildForStatement(init, test, inc, copyBody));
+
+    SgFunctionCallExp* wait = buildFunctionCallExp("wait_group_events", buildVoidType(), buildExprListExp(buildIntVal(1), buildAddressOfOp(buildVarRefExp(event, asyncBlock))), funcScope);
+    asyncBlock->append_statement(buildExprStatement(wait));
+
+    return buildIfStmt(buildAndOp(insideX, insideY), asyncBlock, buildBasicBlock(loadingLoop));
+}
+
+
+// Threads next to each other in x read pixels next to each other in x, so x is contiguous in
+// the buffer, unless the halo is larger in y than in x. The buffer is then indexed [y][x].
+bool LocalMemTransformer::isRowMajor(HaloSize haloSize)
+{
+    return haloSize.up + haloSize.down <= haloSize.left + haloSize.right;
+}
+
+
+// Local memory is assumed to have 32 banks of 4 bytes, as on current GPUs
+static const int nLocalMemBanks = 32;
+
+
+// Length of the contiguous dimension of the buffer, whose elements are always 4 bytes. With
+// LOCAL_MEM_PADDING:-1, the shortest length, at most one line of banks longer than needed,
+// with the fewest threads of a warp reading from the same bank, see getBankConflicts.
+// Otherwise LOCAL_MEM_PADDING elements are added.
+int LocalMemTransformer::getPitch(Parameters params, HaloSize haloSize)
+{
+    int size;
+    if(isRowMajor(haloSize)){
+        size = params.elementsPerThreadX*params.localSizeX + haloSize.left + haloSize.right;
+    }
+    else{
+        size = params.elementsPerThreadY*params.localSizeY + haloSize.up + haloSize.down;
+    }
+
+    if(params.localMemPadding >= 0){
+        return size + params.localMemPadding;
+    }
+
+    int pitch = size;
+    int conflicts = getBankConflicts(params, haloSize, size);
+    for(int candidate = size + 1; candidate < size + nLocalMemBanks; candidate++){
+        int candidateConflicts = getBankConflicts(params, haloSize, candidate);
+        if(candidateConflicts < conflicts){
+            pitch = candidate;
+            conflicts = candidateConflicts;
+        }
+    }
+    return pitch;
+}
+
+
+// The largest number of threads, among the first nLocalMemBanks threads of the work-group,
+// reading the same bank when each thread reads its first element. With localSizeX below the
+// number of banks, a warp covers several rows of threads, and the pitch decides whether the
+// rows start in the same banks. For example, with a 16x16 work-group and rows of 18 elements,
+// threads 14 and 15 of the second row read the banks of threads 0 and 1 of the first, while
+// with rows of 48 elements every thread of the warp reads a different bank.
+int LocalMemTransformer::getBankConflicts(Parameters params, HaloSize haloSize, int pitch)
+{
+    vector<int> threadsPerBank(nLocalMemBanks, 0);
+    int conflicts = 0;
+
+    int nThreads = min(nLocalMemBanks, params.localSizeX*params.localSizeY);
+    for(int i = 0; i < nThreads; i++){
+        int x = i % params.localSizeX;
+        int y = i / params.localSizeX;
+        if(!params.interleaved){
+            x *= params.elementsPerThreadX;
+            y *= params.elementsPerThreadY;
+        }
+
+        int offset = isRowMajor(haloSize) ? y*pitch + x : x*pitch + y;
+        int bank = offset % nLocalMemBanks;
+        threadsPerBank[bank]++;
+        conflicts = max(conflicts, threadsPerBank[bank]);
+    }
+
+    return conflicts;
+}
+
+
+// Number of elements of the buffer, including the padding
+long long LocalMemTransformer::getBufferSize(Parameters params, HaloSize haloSize)
+{
+    long long nLines;
+    if(isRowMajor(haloSize)){
+        nLines = params.elementsPerThreadY*params.localSizeY + haloSize.up + haloSize.down;
+    }
+    else{
+        nLines = params.elementsPerThreadX*params.localSizeX + haloSize.left + haloSize.right;
+    }
+
+    return nLines * getPitch(params, haloSize);
+}
+
+
+SgPntrArrRefExp* LocalMemTransformer::buildLocalBufferRef(string localArray, SgExpression *x, SgExpression *y, SgScopeStatement *scope)
+{
+    SgVarRefExp* buffer = buildVarRefExp("local_buffer_" + localArray, scope);
+    if(isRowMajor(kernelInfo.getHaloSize(localArray))){
+        return buildPntrArrRefExp(buildPntrArrRefExp(buffer, y), x);
+    }
+    return buildPntrArrRefExp(buildPntrArrRefExp(buffer, x), y);
+}
+
+
 SgFunctionCallExp * LocalMemTransformer::buildBarrierCall(SgScopeStatement* funcScope)
 {
     SgExpression* globalMemFence = buildOpaqueVarRefExp("CLK_GLOBAL_MEM_FENCE", getGlobalScope(funcScope));
@@ -139,12 +334,7 @@ SgVariableDeclaration * LocalMemTransformer::buildThreadIdDeclaration(SgScopeSta
 
 void LocalMemTransformer::insertSharedMemLoading(SgFunctionDeclaration* funcDef, string localArray, bool withBarrier)
 {
-    Footprint fp;
-    try{
-        fp = kernelInfo.getFootprintTable().at(localArray);
-    }catch(const out_of_range){ }
-
-    HaloSize haloSize = fp.computeHaloSize();
+    HaloSize haloSize = kernelInfo.getHaloSize(localArray);
     int sharedMemSizeX = params.elementsPerThreadX*params.localSizeX + haloSize.left + haloSize.right;
     int sharedMemSizeY = params.elementsPerThreadY*params.localSizeY + haloSize.up + haloSize.down;
 
@@ -156,7 +346,16 @@ void LocalMemTransformer::insertSharedMemLoading(SgFunctionDeclaration* funcDef,
     }
 
     SgForStatement* loadingLoop = buildLoadingLoop(funcDef, sharedMemSizeX, sharedMemSizeY, localArray,funcScope);
-    funcDef->get_definition()->get_body()->prepend_statement(loadingLoop);
+    if(params.localMemAsync && canLoadAsync(localArray)){
+        SgVariableDeclaration* tileX = buildTileOriginDeclaration(0, localArray, funcScope);
+        SgVariableDeclaration* tileY = buildTileOriginDeclaration(1, localArray, funcScope);
+        funcDef->get_definition()->get_body()->prepend_statement(buildAsyncLoading(loadingLoop, sharedMemSizeX, sharedMemSizeY, localArray, funcScope));
+        funcDef->get_definition()->get_body()->prepend_statement(tileY);
+        funcDef->get_definition()->get_body()->prepend_statement(tileX);
+    }
+    else{
+        funcDef->get_definition()->get_body()->prepend_statement(loadingLoop);
+    }
     SgVariableDeclaration* threadIdDeclaration = buildThreadIdDeclaration(funcScope, localArray);
     funcDef->get_definition()->get_body()->prepend_statement(threadIdDeclaration);
 
@@ -172,7 +371,12 @@ void LocalMemTransformer::insertSharedMemLoading(SgFunctionDeclaration* funcDef,
         baseType = buildFloatType();
         break;
     }
-    SgType* arrayType = buildArrayType(buildArrayType(baseType, buildIntVal(sharedMemSizeY)), buildIntVal(sharedMemSizeX));
+    bool rowMajor = isRowMajor(haloSize);
+    int pitch = getPitch(params, haloSize);
+    int nLines = rowMajor ? sharedMemSizeY : sharedMemSizeX;
+    cout << "[LocalMem] " << localArray << ": " << sharedMemSizeX << "x" << sharedMemSizeY << " tile, stored as " << nLines << (rowMajor ? " rows" : " columns") << " of " << pitch << " elements" << endl;
+
+    SgType* arrayType = buildArrayType(buildArrayType(baseType, buildIntVal(pitch)), buildIntVal(nLines));
     SgModifierType* modifierType = buildModifierType(arrayType);
     modifierType->get_typeModifier().setOpenclLocal();
     SgVariableDeclaration* sharedMemDeclaration = buildVariableDeclaration("local_buffer_"+localArray, modifierType, NULL, funcScope);
@@ -215,6 +419,15 @@ void LocalMemTransformer::replaceWithShared(SgNode* node, string localArray)
             }
         }
     }
+
+    if(isRowMajor(kernelInfo.getHaloSize(localArray))){
+        SgExpression* x = leftChild->get_rhs_operand();
+        SgExpression* y = arrRef->get_rhs_operand();
+        leftChild->set_rhs_operand(y);
+        y->set_parent(leftChild);
+        arrRef->set_rhs_operand(x);
+        x->set_parent(arrRef);
+    }
 }
 
 
@@ -241,20 +454,17 @@ bool isLoadToShared(SgNode* node, string localArray)
 
 void LocalMemTransformer::replaceGlobalWithSharedLoads(string localArray)
 {
-    Rose_STL_Container<SgNode*> nodes = NodeQuery::querySubTree(project, V_SgPntrArrRefExp);
+    vector<SgPntrArrRefExp*> arrRefs = AstIndex::getInstance()->getArrayReferences(project, localArray);
 
-    for(SgNode* node :nodes){
+    // In reverse order, so that references in the subscripts of another reference are
+    // replaced before the reference containing them
+    for(auto it = arrRefs.rbegin(); it != arrRefs.rend(); it++){
+        SgPntrArrRefExp* arrRef = *it;
 
-        if(AstUtil::is2DArrayRoot(node)){
-            SgPntrArrRefExp* arrRef = isSgPntrArrRefExp(node);
-            SgPntrArrRefExp* leftChild = dynamic_cast<SgPntrArrRefExp*>(arrRef->get_lhs_operand());
-            SgVarRefExp* varRef = dynamic_cast<SgVarRefExp*>(leftChild->get_lhs_operand());
-
-            if(varRef->get_symbol()->get_name() == localArray){
-
-                if(!isLoadToShared(node, localArray))
-                    replaceWithShared(node, localArray);
-            }
+        // The addresses given to async copies are in global memory
+        if(AstUtil::is2DArrayRoot(arrRef) && !isSgAddressOfOp(arrRef->get_parent())){
+            if(!isLoadToShared(arrRef, localArray))
+                replaceWithShared(arrRef, localArray);
         }
     }
 }
@@ -263,24 +473,22 @@ void LocalMemTransformer::prependLocalIdComputation(SgBasicBlock* loopBody, stri
 {
     SgScopeStatement* funcScope = NULL;
 
-    Rose_STL_Container<SgNode*> nodes = NodeQuery::querySubTree(project, V_SgFunctionDeclaration);
-    for(SgNode* node : nodes){
-        SgFunctionDeclaration* funcDef = isSgFunctionDeclaration(node);
-        if(funcDef->get_name() == kernelInfo.getKernelName())
-            funcScope = funcDef->get_definition()->get_body();
+    vector<SgFunctionDeclaration*> funcDefs = AstIndex::getInstance()->getFunctionDeclarations(project, kernelInfo.getKernelName());
+    if(!funcDefs.empty()){
+        funcScope = funcDefs.back()->get_definition()->get_body();
     }
 
-    Footprint footprint = kernelInfo.getFootprintTable()[localArray];
+    HaloSize haloSize = kernelInfo.getHaloSize(localArray);
     if(params.interleaved){
         SgFunctionCallExp* getLocalIdx = buildFunctionCallExp("get_local_id", buildIntType(), buildExprListExp(buildIntVal(0)), funcScope);
         SgExpression* baseLidx = buildAddOp(getLocalIdx, buildMultiplyOp(buildIntVal(params.localSizeX), buildVarRefExp("coars_x", funcScope)));
-        SgExpression* lidxWithPadding = buildAddOp(baseLidx, buildIntVal(footprint.computeHaloSize().left));
+        SgExpression* lidxWithPadding = buildAddOp(baseLidx, buildIntVal(haloSize.left));
         SgAssignInitializer* lidxInit = buildAssignInitializer(lidxWithPadding);
         SgVariableDeclaration* lidxDeclaration = buildVariableDeclaration("lidx_"+localArray ,buildIntType(), lidxInit, funcScope);
 
         SgFunctionCallExp* getLocalIdy = buildFunctionCallExp("get_local_id", buildIntType(), buildExprListExp(buildIntVal(1)), funcScope);
         SgExpression* baseLidy = buildAddOp(getLocalIdy, buildMultiplyOp(buildIntVal(params.localSizeY), buildVarRefExp("coars_y", funcScope)));
-        SgExpression* lidyWithPadding = buildAddOp(baseLidy, buildIntVal(footprint.computeHaloSize().up));
+        SgExpression* lidyWithPadding = buildAddOp(baseLidy, buildIntVal(haloSize.up));
         SgAssignInitializer* lidyInit = buildAssignInitializer(lidyWithPadding);
         SgVariableDeclaration* lidyDeclaration = buildVariableDeclaration("lidy_"+localArray ,buildIntType(), lidyInit, funcScope);
 
@@ -290,13 +498,13 @@ void LocalMemTransformer::prependLocalIdComputation(SgBasicBlock* loopBody, stri
     else{
         SgFunctionCallExp* getGlobalIdx = buildFunctionCallExp("get_local_id", buildIntType(), buildExprListExp(buildIntVal(0)), funcScope);
         SgExpression* baseLidx = buildAddOp(buildMultiplyOp(getGlobalIdx, buildIntVal(params.elementsPerThreadX)), buildVarRefExp("coars_x", funcScope));
-        SgExpression* lidxWithPadding = buildAddOp(baseLidx, buildIntVal(footprint.computeHaloSize().left));
+        SgExpression* lidxWithPadding = buildAddOp(baseLidx, buildIntVal(haloSize.left));
         SgAssignInitializer* lidxInit = buildAssignInitializer(lidxWithPadding);
         SgVariableDeclaration* lidxDeclaration = buildVariableDeclaration("lidx_"+localArray ,buildIntType(), lidxInit, funcScope);
 
         SgFunctionCallExp* getGlobalIdy = buildFunctionCallExp("get_local_id", buildIntType(), buildExprListExp(buildIntVal(1)), funcScope);
         SgExpression* baseLidy = buildAddOp(buildMultiplyOp(getGlobalIdy, buildIntVal(params.elementsPerThreadY)), buildVarRefExp("coars_y", funcScope));
-        SgExpression* lidyWithPadding = buildAddOp(baseLidy, buildIntVal(footprint.computeHaloSize().up));
+        SgExpression* lidyWithPadding = buildAddOp(baseLidy, buildIntVal(haloSize.up));
         SgAssignInitializer* lidyInit = buildAssignInitializer(lidyWithPadding);
         SgVariableDeclaration* lidyDeclaration = buildVariableDeclaration("lidy_"+localArray ,buildIntType(), lidyInit, funcScope);
 
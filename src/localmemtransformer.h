@@ -15,6 +15,8 @@
 #include "settings.h"
 
 #include <string>
+#include <vector>
+#include <algorithm>
 
 class LocalMemTransformer
 {
@@ -22,11 +24,21 @@ public:
     LocalMemTransformer(SgProject* project, Parameters params, KernelInfo kernelInfo, Settings settings, SgBasicBlock* loopBody);
     void transform();
 
+    // Layout of the local buffer of an image with the given halo, see insertSharedMemLoading
+    static bool isRowMajor(HaloSize haloSize);
+    static int getPitch(Parameters params, HaloSize haloSize);
+    static long long getBufferSize(Parameters params, HaloSize haloSize);
+    static int getBankConflicts(Parameters params, HaloSize haloSize, int pitch);
+
 private:
     SgFunctionCallExp * buildBarrierCall(SgScopeStatement* funcScope);
     SgVariableDeclaration * buildThreadIdDeclaration(SgScopeStatement* funcScope, string localArray);
     SgForStatement* buildLoadingLoop(SgFunctionDeclaration* funcDef, int sharedMemSizeX, int sharedMemSizeY, string localArray, SgScopeStatement *funcScope);
     SgBasicBlock* buildLoadingForLoopBody(SgFunctionDeclaration* funcDef, int sharedMemSizeX, int sharedMemSizeY, string localArray);
+    SgIfStmt* buildAsyncLoading(SgForStatement* loadingLoop, int sharedMemSizeX, int sharedMemSizeY, string localArray, SgScopeStatement* funcScope);
+    SgVariableDeclaration* buildTileOriginDeclaration(int dim, string localArray, SgScopeStatement* funcScope);
+    bool canLoadAsync(string localArray);
+    SgPntrArrRefExp* buildLocalBufferRef(string localArray, SgExpression* x, SgExpression* y, SgScopeStatement* scope);
 
     void insertSharedMemLoading(SgFunctionDeclaration* funcDef, string localArray, bool withBarrier);
     void replaceGlobalWithSharedLoads(string localArray);
@@ -45,6 +45,22 @@
 #include "filehandler.h"
 #include "indexchanger.h"
 #include "astutil.h"
+#include "astindex.h"
+#include "variantgenerator.h"
+#include "compileserver.h"
+#include "parameterspace.h"
+#include "tuner.h"
+#include "tuningdatabase.h"
+#include "passtimer.h"
+#include "outputcache.h"
+#include "programgenerator.h"
+#include "kernelfuser.h"
+#include "separablesplitter.h"
+
+#include <unistd.h>
+#include <sstream>
+#include <algorithm>
+#include <climits>
 
 using namespace std;
 using namespace SageBuilder;
@@ -52,61 +68,37 @@ using namespace SageInterface;
 using namespace CommandlineProcessing;
 
 
-void patch_ast(SgProject* project)
-{
-    Rose_STL_Container<SgNode*> varRefs = NodeQuery::querySubTree(project, V_SgVarRefExp);
-    //This has to be the ugliest hack ever, somehow needed to fix AST due to template types for image arrays
-    //Should be moved to a separate function or something
-    for(SgNode* node : varRefs){
-        SgVarRefExp* varRef = isSgVarRefExp(node);
-
-        if(varRef->get_symbol()->get_name() == "idx"){
-            //cout << varRef->get_symbol()->get_name() << endl;
-
-            SgScopeStatement* scope = getEnclosingScope(varRef);
-            SgVarRefExp* newVarRef = buildVarRefExp("idx", scope);
-
-            replaceExpression(varRef, newVarRef);
-        }
-        else if(varRef->get_symbol()->get_name() == "idy"){
-            //cout << varRef->get_symbol()->get_name() << endl;
-
-            SgScopeStatement* scope = getEnclosingScope(varRef);
-            SgVarRefExp* newVarRef = buildVarRefExp("idy", scope);
-
-            replaceExpression(varRef, newVarRef);
-        }
-    }
-
-    Rose_STL_Container<SgNode*> tempDecl = NodeQuery::querySubTree(project, V_SgTemplateTypedefDeclaration);
-
-    for(SgNode* node : tempDecl){
-        SgTemplateTypedefDeclaration* temptypdef = isSgTemplateTypedefDeclaration(node);
-        removeStatement(temptypdef);
-    }
-}
-
 void generateCCode(SgProject* project, KernelInfo kernelInfo, Settings settings, Parameters params)
 {
     GlobalVariableRemover globalVarRemover;
     globalVarRemover.traverseInputFiles(project, preorder);
+    AstIndex::getInstance()->invalidate();
 
     ArrayFlattener arrayFlattener(project, params, kernelInfo, settings);
     arrayFlattener.transform();
 
     ArgumentHandler argumentHandler(project, kernelInfo, params, settings);
     argumentHandler.addCArguments();
+    AstIndex::getInstance()->invalidate();
 
-    Rose_STL_Container<SgNode*> tempDecl = NodeQuery::querySubTree(project, V_SgTemplateTypedefDeclaration);
+    Rose_STL_Container<SgNode*> tempDecl = AstIndex::getInstance()->query(project, V_SgTemplateTypedefDeclaration);
 
     for(SgNode* node : tempDecl){
         SgTemplateTypedefDeclaration* temptypdef = isSgTemplateTypedefDeclaration(node);
         removeStatement(temptypdef);
     }
 
+    FileHandler::setOutputFileNames(project, settings.inputBaseName, settings);
     project->unparse();
 }
 
+// Prints the pass timings, and writes them to <base>_pass_times.json, if -clite:time-passes is given
+void reportPassTimes(Settings settings)
+{
+    PassTimer::getInstance()->printReport();
+    PassTimer::getInstance()->writeJson(settings.inputBaseName + "_pass_times.json");
+}
+
 int main(int argc, char** argv)
 {
     Rose_STL_Container<string> commandLineArgs = generateArgListFromArgcArgv(argc, argv);
@@ -123,103 +115,287 @@ int main(int argc, char** argv)
     bool generateC;
     generateC = isOption(commandLineArgs, "-clite:", "c", false);
 
+    bool batchMode;
+    batchMode = isOption(commandLineArgs, "-clite:", "b", false);
+
+    bool dispatchMode;
+    dispatchMode = isOption(commandLineArgs, "-clite:", "d", false);
+
+    bool tuningMode;
+    tuningMode = isOption(commandLineArgs, "-clite:", "t", false);
+
+    bool serverMode;
+    serverMode = isOption(commandLineArgs, "-clite:", "server", false);
+
+    bool timePasses;
+    timePasses = isOption(commandLineArgs, "-clite:", "time-passes", false);
+
+    PassTimer* timer = PassTimer::getInstance();
+    if(timePasses){
+        timer->enable();
+    }
+
+    // In server mode, stdout carries the responses, so all diagnostics are sent to stderr
+    int serverOutputFd = -1;
+    if(serverMode){
+        cout.flush();
+        serverOutputFd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+
     Settings settings;
     settings.readSettingsFromFile("settings.txt");
     settings.inputBaseName = FileHandler::getFileNameBase(fileNames[0]);
     settings.setGenerateC(generateC);
     settings.printSettings();
 
+    // Single variants are looked up in the output cache before anything is parsed
+    bool singleVariant = !(generateParamSpec || batchMode || dispatchMode || tuningMode || serverMode);
+    OutputCache outputCache(settings);
+    string cacheKey;
+    if(settings.useOutputCache && singleVariant && outputCache.isCacheable()){
+        timer->begin("Output cache lookup");
+        vector<string> frontendArgs(commandLineArgs.begin() + 1, commandLineArgs.end());
+        cacheKey = outputCache.computeKey(fileNames[0], "config.txt", "settings.txt", frontendArgs);
+        bool hit = !cacheKey.empty() && outputCache.fetch(cacheKey);
+        timer->end();
+
+        if(hit){
+            reportPassTimes(settings);
+            return 0;
+        }
+    }
+
     FileHandler::fixFiles(fileNames, settings);
     char** newArgv = FileHandler::fixFileNames(argc, argv, fileNames);
 
+    timer->begin("Frontend");
     SgProject* project = frontend(argc, newArgv);
+    timer->end();
+
+    // Fused kernels replace their producers before anything is analyzed
+    timer->begin("Kernel fusion");
+    KernelFuser kernelFuser(project, settings);
+    kernelFuser.fuseKernels();
+    timer->end();
+
+    // Split kernels are compiled as a file with several kernels, so only single variants can be split
+    vector<SeparableFilter> separableFilters;
+    if(settings.splitSeparable && singleVariant && !generateC){
+        timer->begin("Separable filters");
+        SeparableSplitter separableSplitter(project, settings);
+        separableFilters = separableSplitter.splitFilters();
+        timer->end();
+    }
+
+    vector<SgFunctionDeclaration*> kernelDeclarations = AstUtil::findKernelDeclarations(project);
+    if(kernelDeclarations.size() > 1){
+        if(!singleVariant || generateC){
+            cerr << "ERROR: Files with several kernels can only be compiled to a single OpenCL program. Exiting..." << endl;
+            exit(-1);
+        }
 
+        // All kernels are analyzed before any of them is transformed. Each kernel uses
+        // config_<kernel>.txt if it exists, and config.txt otherwise.
+        vector<KernelInfo> kernels;
+        vector<Parameters> parameterSets;
+        for(SgFunctionDeclaration* kernelDeclaration : kernelDeclarations){
+            string kernelName = kernelDeclaration->get_name().getString();
+
+            timer->begin("Analysis " + kernelName);
+            KernelInfo kernelInfo(project, settings, kernelName);
+            kernelInfo.scanForInfo();
+            timer->end();
+            kernelInfo.printKernelInfo();
+
+            string configFileName = "config_" + kernelName + ".txt";
+            if(!ifstream(configFileName).good()){
+                configFileName = "config.txt";
+            }
+
+            Parameters kernelParams;
+            kernelParams.setDefaultParameters();
+            kernelParams.readParametersFromFile(kernelInfo, configFileName);
+            kernelParams.setParametersFromPragmas(kernelInfo.getPragmas());
+            kernelParams.validateParameters(kernelInfo);
+            kernelParams.printParameters();
+
+            kernels.push_back(kernelInfo);
+            parameterSets.push_back(kernelParams);
+        }
+
+        ProgramGenerator programGenerator(project, kernels, settings, fileNames, separableFilters);
+        programGenerator.generate(parameterSets);
+
+        FileHandler::removeTemporaryFiles(fileNames);
+        if(!cacheKey.empty()){
+            outputCache.store(cacheKey);
+        }
+        reportPassTimes(settings);
+        return 0;
+    }
+
+    timer->begin("Analysis");
     KernelInfo kernelInfo(project, settings);
     kernelInfo.scanForInfo();
+    timer->end();
     kernelInfo.printKernelInfo();
 
     Parameters params;
     if(generateParamSpec){
         params.generateParameterSpecification(kernelInfo);
+
+        timer->begin("DOT output");
         generateDOT(*project);
+        timer->end();
+
+        reportPassTimes(settings);
         return 0;
     }
 
-    params.setDefaultParameters();
-    if(!generateC){
-        params.readParametersFromFile(kernelInfo, "config.txt");
-        params.setParametersFromPragmas(kernelInfo.getPragmas());
-    }
-    params.validateParameters(kernelInfo);
-    params.printParameters();
+    if(batchMode){
+        // Analysis is done once, and shared by all the variants
+        vector<Parameters>* parameterSets = Parameters::readParameterSetsFromFile(kernelInfo, "batch_config.txt");
 
-    if(generateC){
-        generateCCode(project, kernelInfo, settings, params);
-        FileHandler::cleanUpFiles(fileNames, settings, false);
+        VariantGenerator variantGenerator(project, kernelInfo, settings, fileNames);
+        variantGenerator.generateAll(parameterSets);
+
+        FileHandler::removeTemporaryFiles(fileNames);
+        reportPassTimes(settings);
         return 0;
     }
 
-    LoopUnroller loopUnroller(project, params, kernelInfo);
-    loopUnroller.traverseInputFiles(project, postorder);
-    loopUnroller.unrollLoops();
+    if(dispatchMode){
+        // Each set in dispatch_config.txt is used for images of up to MAX_PIXELS pixels.
+        // Sets without MAX_PIXELS are used for all larger images.
+        vector<pair<long long, Parameters>> sizeClasses;
+        for(string setText : *Parameters::readParameterSetTexts("dispatch_config.txt")){
+            Parameters sizeClassParams;
+            sizeClassParams.setDefaultParameters();
+            istringstream setStream(setText);
+            sizeClassParams.readParametersFromStream(setStream);
+
+            long long maxPixels = LLONG_MAX;
+            istringstream lineStream(setText);
+            string line;
+            while(getline(lineStream, line)){
+                if(line.compare(0, 11, "MAX_PIXELS:") == 0 && stoll(line.substr(11)) > 0){
+                    maxPixels = stoll(line.substr(11));
+                }
+            }
+            sizeClasses.push_back(make_pair(maxPixels, sizeClassParams));
+        }
 
-    GlobalVariableRemover globalVarRemover;
-    globalVarRemover.traverseInputFiles(project, preorder);
+        if(sizeClasses.empty()){
+            cerr << "ERROR: No parameter sets in dispatch_config.txt. Exiting..." << endl;
+            exit(-1);
+        }
 
-    NaiveCoarsener naiveCoarsener(params, kernelInfo, settings);
-    naiveCoarsener.traverseInputFiles(project, preorder);
-    fixVariableReferences(project);
+        stable_sort(sizeClasses.begin(), sizeClasses.end(), [](const pair<long long, Parameters>& a, const pair<long long, Parameters>& b){ return a.first < b.first; });
 
-    if(params.useLocalMem()){
-        LocalMemTransformer localMemTransformer(project, params, kernelInfo, settings, naiveCoarsener.getOriginalFunctionBody());
-        localMemTransformer.transform();
-    }
+        vector<Parameters>* parameterSets = new vector<Parameters>();
+        vector<long long> maxPixels;
+        for(pair<long long, Parameters> sizeClass : sizeClasses){
+            maxPixels.push_back(sizeClass.first);
+            parameterSets->push_back(sizeClass.second);
+        }
 
-    IndexChanger indexChanger(kernelInfo, params, settings);
-    if(settings.generateMPI || settings.generateOMP){
-        indexChanger.replaceIndices(project);
+        VariantGenerator variantGenerator(project, kernelInfo, settings, fileNames);
+        variantGenerator.generateDispatch(parameterSets, maxPixels);
+
+        FileHandler::removeTemporaryFiles(fileNames);
+        reportPassTimes(settings);
+        return 0;
     }
 
-    BoundryGuardInserter boundryGuardInserter(kernelInfo, params, project, settings);
-    boundryGuardInserter.insertBoundryGuards();
+    if(tuningMode){
+        ifstream specFile("param_spec.txt");
+        if(!specFile.good()){
+            params.generateParameterSpecification(kernelInfo);
+        }
+        specFile.close();
 
-    if(settings.generateMPI || settings.generateOMP){
-        indexChanger.addPaddings(project);
-    }
+        ParameterSpace space;
+        space.readSpecificationFromFile("param_spec.txt");
+
+        VariantGenerator variantGenerator(project, kernelInfo, settings, fileNames);
+        Tuner tuner(&variantGenerator, kernelInfo, settings);
+        tuner.tune(&space);
+        tuner.writeBestConfiguration("config.txt");
 
-    if(params.useImageMem()){
-        ImageMemTransformer imageMemTransformer(project, params, kernelInfo, settings);
-        imageMemTransformer.transform();
+        FileHandler::removeTemporaryFiles(fileNames);
+        reportPassTimes(settings);
+        return 0;
     }
 
-    ArrayFlattener arrayFlattener(project, params, kernelInfo, settings);
-    arrayFlattener.transform();
+    if(serverMode){
+        VariantGenerator variantGenerator(project, kernelInfo, settings, fileNames);
+        CompileServer server(&variantGenerator, settings, serverOutputFd);
+        server.run();
 
+        FileHandler::removeTemporaryFiles(fileNames);
+        reportPassTimes(settings);
+        return 0;
+    }
 
-    if(params.useConstantMem()){
-        ConstantMemTransformer constantMemTransformer(project, kernelInfo, params);
-        constantMemTransformer.transform();
+    params.setDefaultParameters();
+    if(!generateC){
+        params.readParametersFromFile(kernelInfo, "config.txt");
+        params.setParametersFromPragmas(kernelInfo.getPragmas());
     }
 
-    KernelFinder kernelFinder(project, params, kernelInfo);
-    kernelFinder.transform();
+    if(settings.useTuningDatabase && !generateC){
+        TuningDatabase database(settings.tuningDatabase);
+        database.load();
 
-    ArgumentHandler argumentHandler(project, kernelInfo, params, settings);
-    vector<Argument>* arguments = argumentHandler.addAndGetArguments();
+        string deviceKey = TuningDatabase::getDeviceKey(settings.platformId, settings.deviceId);
+        TuningRecord best;
+        if(database.getBestRecord(kernelInfo.getSourceHash(), deviceKey, settings.tuningWidth, settings.tuningHeight, best)){
+            cout << "[TuningDB] Using best known configuration (" << best.time << " ms) instead of config.txt" << endl;
+            params = best.params;
+            params.setParametersFromPragmas(kernelInfo.getPragmas());
+        }
+        else{
+            cout << "[TuningDB] No known configuration, using config.txt" << endl;
+        }
+    }
+    params.validateParameters(kernelInfo);
+    params.printParameters();
 
-    patch_ast(project);
+    if(generateC){
+        timer->begin("Generate C");
+        generateCCode(project, kernelInfo, settings, params);
+        timer->end();
 
-    if(settings.generateStandalone){
-        WrapperGenerator wrapperGenerator(settings.inputBaseName + "_wrapper.c",arguments,params,kernelInfo, settings);
-        wrapperGenerator.generate();
-    }
-    if(settings.generateFAST){
-        FASTWrapperGenerator fastWrapperGenerator("FastWrapper", arguments, params, kernelInfo);
-        fastWrapperGenerator.generate();
+        FileHandler::cleanUpFiles(fileNames, settings, false);
+        if(!cacheKey.empty()){
+            outputCache.store(cacheKey);
+        }
+        reportPassTimes(settings);
+        return 0;
     }
 
+    VariantGenerator variantGenerator(project, kernelInfo, settings, fileNames);
+    timer->begin("Transform");
+    variantGenerator.transform(params, settings);
+    timer->end();
+
+    timer->begin("DOT output");
     generateDOT(*project);
+    timer->end();
+
+    timer->begin("Unparse");
+    FileHandler::setOutputFileNames(project, settings.inputBaseName, settings);
     project->unparse();
+    timer->end();
 
+    timer->begin("Clean up and format");
     FileHandler::cleanUpFiles(fileNames, settings, true);
+    timer->end();
+
+    if(!cacheKey.empty()){
+        outputCache.store(cacheKey);
+    }
+
+    reportPassTimes(settings);
 }
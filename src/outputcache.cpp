@@ -0,0 +1,262 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "outputcache.h"
+#include "pragma.h"
+#include "tuningdatabase.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glob.h>
+
+OutputCache::OutputCache(Settings settings) : settings(settings)
+{
+}
+
+// FAST wrappers are written to fixed file names, and are not cached
+bool OutputCache::isCacheable()
+{
+    return !settings.generateFAST;
+}
+
+string OutputCache::readFile(string fileName)
+{
+    ifstream file(fileName);
+    ostringstream content;
+    if(file.good()){
+        content << file.rdbuf();
+    }
+    return content.str();
+}
+
+bool OutputCache::copyFile(string from, string to)
+{
+    ifstream in(from, ios::binary);
+    if(!in.good()){
+        return false;
+    }
+    ofstream out(to, ios::binary);
+    out << in.rdbuf();
+    out.close();
+
+    return out.good();
+}
+
+// Pairs of the name of each generated file, and its name in the cache entry
+vector<pair<string,string>> OutputCache::getCachedFiles()
+{
+    vector<pair<string,string>> files;
+
+    if(settings.generateCl){
+        files.push_back(make_pair(settings.inputBaseName + ".cl", "kernel.cl"));
+    }
+    else{
+        files.push_back(make_pair(settings.inputBaseName + ".c", "kernel.c"));
+    }
+
+    if(settings.generateStandalone && !settings.generateC){
+        files.push_back(make_pair(settings.inputBaseName + "_wrapper.c", "wrapper.c"));
+    }
+
+    return files;
+}
+
+string OutputCache::getEntryDirectory(string key)
+{
+    return settings.cacheDirectory + "/" + key;
+}
+
+// Adds the contents of the files included with #include "..." by fileName, recursively.
+// They are searched for next to the including file, and then in includeDirectories, as by
+// the preprocessor. Returns false if an included file is not found.
+bool OutputCache::hashLocalIncludes(string fileName, vector<string>& includeDirectories, ostream& keyData, set<string>& includedFiles)
+{
+    size_t found = fileName.find_last_of('/');
+    string directory = found == string::npos ? string(".") : fileName.substr(0, found);
+
+    istringstream source(readFile(fileName));
+    string line;
+    while(getline(source, line)){
+        size_t start = line.find_first_not_of(" \t");
+        if(start == string::npos || line[start] != '#'){
+            continue;
+        }
+        size_t directive = line.find_first_not_of(" \t", start + 1);
+        if(directive == string::npos || line.compare(directive, 7, "include") != 0){
+            continue;
+        }
+        size_t open = line.find('"', directive + 7);
+        size_t close = open == string::npos ? string::npos : line.find('"', open + 1);
+        if(close == string::npos){
+            continue;
+        }
+        string header = line.substr(open + 1, close - open - 1);
+
+        vector<string> candidates;
+        candidates.push_back(header[0] == '/' ? header : directory + "/" + header);
+        for(string includeDirectory : includeDirectories){
+            candidates.push_back(includeDirectory + "/" + header);
+        }
+
+        string resolved;
+        for(string candidate : candidates){
+            if(access(candidate.c_str(), R_OK) == 0){
+                resolved = candidate;
+                break;
+            }
+        }
+        if(resolved.empty()){
+            return false;
+        }
+
+        if(!includedFiles.insert(resolved).second){
+            continue;
+        }
+        keyData << "INCLUDE " << header << ":" << endl << readFile(resolved) << endl;
+        if(!hashLocalIncludes(resolved, includeDirectories, keyData, includedFiles)){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The settings and configuration are hashed as written, since the effective values are
+// determined by them, the defaults and the pragmas of the source. Returns an empty key if
+// the output can not be cached.
+string OutputCache::computeKey(string inputFileName, string configFileName, string settingsFileName, vector<string> frontendArgs)
+{
+    ostringstream keyData;
+
+    // The arguments given to the frontend, in order, since macros defined with -D change the
+    // source, and the order of the -I directories decides which headers are found. The
+    // -clite: options select the mode, and only -clite:c changes a single variant.
+    vector<string> includeDirectories;
+    keyData << "ARGS:";
+    for(int i = 0; i < frontendArgs.size(); i++){
+        string arg = frontendArgs[i];
+        if(arg.compare(0, 7, "-clite:") == 0){
+            continue;
+        }
+        keyData << " " << arg;
+
+        if(arg == "-I" && i + 1 < frontendArgs.size()){
+            includeDirectories.push_back(frontendArgs[i + 1]);
+        }
+        else if(arg.compare(0, 2, "-I") == 0 && arg.size() > 2){
+            includeDirectories.push_back(arg.substr(2));
+        }
+    }
+    keyData << endl;
+
+    // A rebuilt compiler may generate different code for the same input
+    struct stat compilerStat;
+    if(stat("/proc/self/exe", &compilerStat) == 0){
+        keyData << "COMPILER:" << compilerStat.st_size << ":" << compilerStat.st_mtime << endl;
+    }
+
+    keyData << "BASE_NAME:" << settings.inputBaseName << endl;
+    keyData << "GENERATE_C:" << settings.generateC << endl;
+    keyData << "SOURCE:" << endl << readFile(inputFileName) << endl;
+
+    // Local headers are part of the source. If one can not be found, it is left to the
+    // frontend, and the output is not cached.
+    set<string> includedFiles;
+    if(!hashLocalIncludes(inputFileName, includeDirectories, keyData, includedFiles)){
+        cout << "[Cache] Bypassed: unresolved local include in " << inputFileName << endl;
+        return "";
+    }
+    keyData << "SETTINGS:" << endl << readFile(settingsFileName) << endl;
+    if(!settings.generateC){
+        keyData << "CONFIG:" << endl << readFile(configFileName) << endl;
+
+        // Configurations of the individual kernels of files with several kernels
+        glob_t kernelConfigs;
+        if(glob("config_*.txt", 0, NULL, &kernelConfigs) == 0){
+            for(size_t i = 0; i < kernelConfigs.gl_pathc; i++){
+                string kernelConfig = kernelConfigs.gl_pathv[i];
+                keyData << "CONFIG " << kernelConfig << ":" << endl << readFile(kernelConfig) << endl;
+            }
+        }
+        globfree(&kernelConfigs);
+    }
+
+    // With USE_TUNING_DB, the configuration is the best one known for this device
+    if(settings.useTuningDatabase && !settings.generateC){
+        keyData << "DEVICE:" << TuningDatabase::getDeviceKey(settings.platformId, settings.deviceId) << endl;
+        keyData << "TUNING_DB:" << endl << readFile(settings.tuningDatabase) << endl;
+    }
+
+    string data = keyData.str();
+    return StringUtils::hash(data) + "_" + to_string(data.size());
+}
+
+bool OutputCache::fetch(string key)
+{
+    string entry = getEntryDirectory(key);
+
+    for(pair<string,string> file : getCachedFiles()){
+        if(access((entry + "/" + file.second).c_str(), R_OK) != 0){
+            cout << "[Cache] Miss: " << key << endl;
+            return false;
+        }
+    }
+
+    for(pair<string,string> file : getCachedFiles()){
+        if(!copyFile(entry + "/" + file.second, file.first)){
+            cout << "WARNING: Could not copy " << file.second << " from the cache" << endl;
+            return false;
+        }
+    }
+
+    cout << "[Cache] Hit: " << key << endl;
+    return true;
+}
+
+// The entry is written to a temporary directory, which is then renamed, so that
+// concurrent runs never see a partially written entry
+void OutputCache::store(string key)
+{
+    string entry = getEntryDirectory(key);
+    if(access(entry.c_str(), F_OK) == 0){
+        return;
+    }
+
+    mkdir(settings.cacheDirectory.c_str(), 0755);
+
+    string tempTemplate = settings.cacheDirectory + "/tmp_XXXXXX";
+    vector<char> buffer(tempTemplate.begin(), tempTemplate.end());
+    buffer.push_back('\0');
+    if(mkdtemp(buffer.data()) == NULL){
+        cout << "WARNING: Could not create cache entry in " << settings.cacheDirectory << endl;
+        return;
+    }
+    string tempDirectory(buffer.data());
+
+    bool copied = true;
+    for(pair<string,string> file : getCachedFiles()){
+        copied = copied && copyFile(file.first, tempDirectory + "/" + file.second);
+    }
+
+    if(!copied || rename(tempDirectory.c_str(), entry.c_str()) != 0){
+        for(pair<string,string> file : getCachedFiles()){
+            unlink((tempDirectory + "/" + file.second).c_str());
+        }
+        rmdir(tempDirectory.c_str());
+        if(!copied){
+            cout << "WARNING: Could not store the generated files in the cache" << endl;
+        }
+        return;
+    }
+
+    cout << "[Cache] Stored: " << key << endl;
+}
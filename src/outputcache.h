@@ -0,0 +1,44 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef OUTPUTCACHE_H
+#define OUTPUTCACHE_H
+
+#include "settings.h"
+
+#include <string>
+#include <vector>
+#include <set>
+#include <ostream>
+
+using namespace std;
+
+// Cache of generated files, in CACHE_DIR, with one directory per key. The key is a hash
+// of everything the output depends on: the input source (including its pragmas and local
+// headers), the frontend arguments, the configuration, the settings, and the compiler itself. A hit is found before
+// the frontend is run.
+class OutputCache
+{
+public:
+    OutputCache(Settings settings);
+
+    bool isCacheable();
+    string computeKey(string inputFileName, string configFileName, string settingsFileName, vector<string> frontendArgs);
+    bool fetch(string key);
+    void store(string key);
+
+private:
+    vector<pair<string,string>> getCachedFiles();
+    static bool hashLocalIncludes(string fileName, vector<string>& includeDirectories, ostream& keyData, set<string>& includedFiles);
+    string getEntryDirectory(string key);
+    static string readFile(string fileName);
+    static bool copyFile(string from, string to);
+
+    Settings settings;
+};
+
+#endif // OUTPUTCACHE_H
@@ -12,6 +12,8 @@
 #include <set>
 #include <string>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 
 using namespace std;
 
@@ -34,6 +36,12 @@ void Parameters::setDefaultParameters()
     localSizeZ = 1;
 
     interleaved = true;
+    borderSplit = false;
+    registerTiling = false;
+    vectorize = false;
+    localMemAsync = false;
+    localMemPadding = -1;
+    temporalSteps = 1;
 
     localMemArrays = new set<string>();
     imageMemArrays = new set<string>();
@@ -71,27 +79,46 @@ void Parameters::setParametersFromPragmas(set<Pragma> *pragmas)
 
 
 void Parameters::validateParameters(KernelInfo kernelInfo)
+{
+    string error;
+    if(!checkParameters(kernelInfo, error)){
+        cerr << "ERROR: " << error << ". Exiting... " << endl;
+        exit(-1);
+    }
+}
+
+
+// Like validateParameters, but returns false, with the reason in error, instead of exiting
+bool Parameters::checkParameters(KernelInfo kernelInfo, string& error)
 {
     for(string imageMemArray : *(imageMemArrays)){
         if(!kernelInfo.isImageArray(imageMemArray)){
-            cerr << "ERROR: Illegal array for image memory: " << imageMemArray << ". Not Image array. Exiting... " << endl;
-            exit(-1);
+            error = "Illegal array for image memory: " + imageMemArray + ". Not Image array";
+            return false;
         }
     }
 
     for(string localMemArray : *localMemArrays){
         if(!kernelInfo.isImageArray(localMemArray)){
-            cerr << "ERROR: Illegal array for local memory: " << localMemArray << ". Not Image array. Exiting... " << endl;
-            exit(-1);
+            error = "Illegal array for local memory: " + localMemArray + ". Not Image array";
+            return false;
         }
     }
 
     for(string constantArray : *(constantMemArrays)){
         if(this->imageMemArrays->count(constantArray) == 1){
-            cerr << "ERROR: Illegal parameter combination (image memory, constant memory), for " << constantArray << ". Exiting..." << endl;
-            exit(-1);
+            error = "Illegal parameter combination (image memory, constant memory), for " + constantArray;
+            return false;
         }
     }
+
+    // The source and target of an iterated kernel are swapped, and must both be buffers
+    if(kernelInfo.getIterations() > 1 && imageMemArrays->count(kernelInfo.getIterationSource()) == 1){
+        error = "Illegal array for image memory: " + kernelInfo.getIterationSource() + ". Iterated image";
+        return false;
+    }
+
+    return true;
 }
 
 void Parameters::printParameters()
@@ -108,6 +135,12 @@ void Parameters::printParameters()
     cout << "Local size z: " << localSizeZ << endl;
 
     cout << "Interleaved: " << interleaved << endl;
+    cout << "Border split: " << borderSplit << endl;
+    cout << "Register tiling: " << registerTiling << endl;
+    cout << "Vectorize: " << vectorize << endl;
+    cout << "Local memory async: " << localMemAsync << endl;
+    cout << "Local memory padding: " << localMemPadding << endl;
+    cout << "Temporal steps: " << temporalSteps << endl;
 
     cout << "Local memory arrays: ";
     for(string s : *localMemArrays){
@@ -170,8 +203,16 @@ void Parameters::readParametersFromFile(KernelInfo kernelInfo, string fileName)
     ifstream file;
     file.open(fileName);
 
+    readParametersFromStream(file);
+
+    file.close();
+}
+
+
+void Parameters::readParametersFromStream(istream& stream)
+{
     string line;
-    while(getline(file, line)){
+    while(getline(stream, line)){
 
         int split = line.find(":");
         string property = line.substr(0,split);
@@ -198,6 +239,24 @@ void Parameters::readParametersFromFile(KernelInfo kernelInfo, string fileName)
         if(property.compare("INTERLEAVED") == 0)
             interleaved = (stoi(value) == 1);
 
+        if(property.compare("BORDER_SPLIT") == 0)
+            borderSplit = (stoi(value) == 1);
+
+        if(property.compare("REGISTER_TILING") == 0)
+            registerTiling = (stoi(value) == 1);
+
+        if(property.compare("VECTORIZE") == 0)
+            vectorize = (stoi(value) == 1);
+
+        if(property.compare("LOCAL_MEM_ASYNC") == 0)
+            localMemAsync = (stoi(value) == 1);
+
+        if(property.compare("LOCAL_MEM_PADDING") == 0)
+            localMemPadding = stoi(value);
+
+        if(property.compare("TEMPORAL_STEPS") == 0)
+            temporalSteps = stoi(value);
+
         if(property.compare("LOCAL_MEMORY") == 0){
             istringstream iss(value);
             string token;
@@ -231,8 +290,138 @@ void Parameters::readParametersFromFile(KernelInfo kernelInfo, string fileName)
         }
 
     }
+}
+
+
+// Same work sizes as the generated wrapper, see WrapperGenerator::writeWorkGroupSetUp
+void Parameters::getWorkSizes(int gridSizeX, int gridSizeY, size_t* localWorkSize, size_t* globalWorkSize)
+{
+    localWorkSize[0] = localSizeX;
+    localWorkSize[1] = localSizeY;
+
+    int pixelsPerGroupX = localSizeX * elementsPerThreadX;
+    int pixelsPerGroupY = localSizeY * elementsPerThreadY;
+    globalWorkSize[0] = ((gridSizeX + pixelsPerGroupX - 1) / pixelsPerGroupX) * localSizeX;
+    globalWorkSize[1] = ((gridSizeY + pixelsPerGroupY - 1) / pixelsPerGroupY) * localSizeY;
+}
+
+
+void Parameters::writeParametersToStream(ostream& stream)
+{
+    stream << "ELEMENTS_PER_THREAD_X:" << elementsPerThreadX << endl;
+    stream << "ELEMENTS_PER_THREAD_Y:" << elementsPerThreadY << endl;
+    stream << "ELEMENTS_PER_THREAD_Z:" << elementsPerThreadZ << endl;
+
+    stream << "LOCAL_SIZE_X:" << localSizeX << endl;
+    stream << "LOCAL_SIZE_Y:" << localSizeY << endl;
+    stream << "LOCAL_SIZE_Z:" << localSizeZ << endl;
+
+    stream << "INTERLEAVED:" << (interleaved ? 1 : 0) << endl;
+    stream << "BORDER_SPLIT:" << (borderSplit ? 1 : 0) << endl;
+    stream << "REGISTER_TILING:" << (registerTiling ? 1 : 0) << endl;
+    stream << "VECTORIZE:" << (vectorize ? 1 : 0) << endl;
+    stream << "LOCAL_MEM_ASYNC:" << (localMemAsync ? 1 : 0) << endl;
+    stream << "LOCAL_MEM_PADDING:" << localMemPadding << endl;
+    stream << "TEMPORAL_STEPS:" << temporalSteps << endl;
+
+    if(useLocalMem()){
+        stream << "LOCAL_MEMORY:";
+        for(auto it = localMemArrays->begin(); it != localMemArrays->end(); ++it){
+            if(it != localMemArrays->begin()){
+                stream << ",";
+            }
+            stream << *it;
+        }
+        stream << endl;
+    }
+
+    if(useImageMem()){
+        stream << "IMAGE_MEMORY:";
+        for(auto it = imageMemArrays->begin(); it != imageMemArrays->end(); ++it){
+            if(it != imageMemArrays->begin()){
+                stream << ",";
+            }
+            stream << *it;
+        }
+        stream << endl;
+    }
+
+    if(useConstantMem()){
+        stream << "CONSTANT_MEMORY:";
+        for(auto it = constantMemArrays->begin(); it != constantMemArrays->end(); ++it){
+            if(it != constantMemArrays->begin()){
+                stream << ",";
+            }
+            stream << *it;
+        }
+        stream << endl;
+    }
+
+    for(pair<int,int> forLoop : *forLoops){
+        stream << "LOOP" << forLoop.first - FileHandler::preambleLength << ":" << forLoop.second << endl;
+    }
+}
+
+
+// Parameter sets are written in the same format as config.txt, separated by blank lines.
+// Keys that are not parameters are ignored, so the files can carry additional information per set.
+vector<string>* Parameters::readParameterSetTexts(string fileName)
+{
+    vector<string>* setTexts = new vector<string>();
+
+    ifstream file;
+    file.open(fileName);
+    if(!file.is_open()){
+        cerr << "ERROR: Could not open parameter set file " << fileName << ". Exiting..." << endl;
+        exit(-1);
+    }
+
+    ostringstream currentSet;
+    bool currentSetEmpty = true;
+    string line;
+    while(true){
+        bool gotLine = (bool)getline(file, line);
+
+        if(!gotLine || line.find_first_not_of(" \t\r") == string::npos){
+            if(!currentSetEmpty){
+                setTexts->push_back(currentSet.str());
+
+                currentSet.str("");
+                currentSetEmpty = true;
+            }
+            if(!gotLine){
+                break;
+            }
+            continue;
+        }
+
+        if(line[0] == '#'){
+            continue;
+        }
+
+        currentSet << line << endl;
+        currentSetEmpty = false;
+    }
 
     file.close();
+
+    return setTexts;
+}
+
+
+vector<Parameters>* Parameters::readParameterSetsFromFile(KernelInfo kernelInfo, string fileName)
+{
+    vector<Parameters>* parameterSets = new vector<Parameters>();
+
+    for(string setText : *readParameterSetTexts(fileName)){
+        Parameters params;
+        params.setDefaultParameters();
+        istringstream setStream(setText);
+        params.readParametersFromStream(setStream);
+        parameterSets->push_back(params);
+    }
+
+    return parameterSets;
 }
 
 
@@ -250,10 +439,24 @@ void Parameters::generateParameterSpecification(KernelInfo kernelInfo)
     //file << "LOCAL_SIZE_Z:1,2,4,8,16,32,64,128" << endl;
 
     file << "INTERLEAVED:0,1" << endl;
+    file << "VECTORIZE:0,1" << endl;
+
+    // Splitting only pays off if some image is read with an offset
+    bool hasHalo = false;
+    for(string s : *kernelInfo.getImageArrays()){
+        hasHalo = hasHalo || kernelInfo.getHaloSize(s).getMax() > 0;
+    }
+    if(hasHalo){
+        file << "BORDER_SPLIT:0,1" << endl;
+        file << "REGISTER_TILING:0,1" << endl;
+    }
 
     file << "IMAGE_MEMORY:";
     bool first = true;
     for(string readOnlyArray: *(kernelInfo.getReadOnlyArrays())){
+        if(kernelInfo.getIterations() > 1 && readOnlyArray == kernelInfo.getIterationSource()){
+            continue;
+        }
         if(kernelInfo.isImageArray(readOnlyArray)){
             if(!first){
                 file << ",";
@@ -269,15 +472,11 @@ void Parameters::generateParameterSpecification(KernelInfo kernelInfo)
     file << "LOCAL_MEMORY:";
     bool firstCommaPrinted = false;
     for(string s : *kernelInfo.getReadOnlyArrays()){
-        Footprint f;
-        try{
-            f = kernelInfo.getFootprintTable().at(s);
-        }
-        catch(exception e){
+        if(!kernelInfo.hasFootprint(s)){
             continue;
         }
 
-        if(f.computeHaloSize().getMax() > 0 && !f.threadStatic){
+        if(kernelInfo.getHaloSize(s).getMax() > 0 && !kernelInfo.getFootprintTable().at(s).threadStatic){
             if(!firstCommaPrinted){
                 file << s;
                 firstCommaPrinted = true;
@@ -289,6 +488,22 @@ void Parameters::generateParameterSpecification(KernelInfo kernelInfo)
     }
     file << endl;
 
+    if(firstCommaPrinted){
+        file << "LOCAL_MEM_ASYNC:0,1" << endl;
+        file << "LOCAL_MEM_PADDING:-1,0,1,2,4" << endl;
+    }
+
+    // Only step counts dividing the number of iterations, so that every launch does the same
+    if(kernelInfo.getIterations() > 1 && kernelInfo.canBlockTemporally()){
+        file << "TEMPORAL_STEPS:1";
+        for(int steps : {2, 3, 4, 8}){
+            if(kernelInfo.getIterations() % steps == 0){
+                file << "," << steps;
+            }
+        }
+        file << endl;
+    }
+
     file << "CONSTANT_MEMORY:";
     for(auto it = kernelInfo.getConstantArrays()->begin(); it != kernelInfo.getConstantArrays()->end(); ++it){
         if(it != kernelInfo.getConstantArrays()->begin()){
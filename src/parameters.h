@@ -13,6 +13,9 @@
 
 #include <string>
 #include <set>
+#include <vector>
+#include <istream>
+#include <ostream>
 
 using namespace std;
 
@@ -27,8 +30,14 @@ public:
     bool useConstantMem();
     void generateParameterSpecification(KernelInfo kernelInfo);
     void readParametersFromFile(KernelInfo kernelInfo, string fileName);
+    void readParametersFromStream(istream& stream);
+    void writeParametersToStream(ostream& stream);
+    static vector<Parameters>* readParameterSetsFromFile(KernelInfo kernelInfo, string fileName);
+    static vector<string>* readParameterSetTexts(string fileName);
     void printParameters();
     void validateParameters(KernelInfo kernelInfo);
+    bool checkParameters(KernelInfo kernelInfo, string& error);
+    void getWorkSizes(int gridSizeX, int gridSizeY, size_t* localWorkSize, size_t* globalWorkSize);
 
     int localSizeX;
     int localSizeY;
@@ -40,6 +49,25 @@ public:
 
     bool interleaved;
 
+    // Generate a guard-free path for pixels whose footprints are inside all images
+    bool borderSplit;
+
+    // Load the footprints of all the elements of a thread into registers once
+    bool registerTiling;
+
+    // Compute the elements of a row of a thread with vector types, see Vectorizer
+    bool vectorize;
+
+    // Load local memory tiles inside the image with async_work_group_copy
+    bool localMemAsync;
+
+    // Elements added to each line of the local memory buffers, -1 chooses automatically,
+    // see LocalMemTransformer::getPitch
+    int localMemPadding;
+
+    // Iterations of an iterate(N) kernel done in each launch, see TemporalBlocker
+    int temporalSteps;
+
     set<string>* localMemArrays;
     set<string>* imageMemArrays;
     set<string>* constantMemArrays;
@@ -0,0 +1,397 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "parameterspace.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <cmath>
+
+using namespace std;
+
+ParameterSpace::ParameterSpace()
+{
+    names = new vector<string>();
+    values = new vector<vector<string>*>();
+    validPoints = NULL;
+}
+
+
+bool ParameterSpace::isArrayDimension(string name)
+{
+    return name.compare("IMAGE_MEMORY") == 0 || name.compare("LOCAL_MEMORY") == 0 || name.compare("CONSTANT_MEMORY") == 0;
+}
+
+
+vector<string>* ParameterSpace::getSubsets(vector<string> arrays)
+{
+    vector<string>* subsets = new vector<string>();
+
+    for(long long mask = 0; mask < (1LL << arrays.size()); mask++){
+        ostringstream subset;
+        bool first = true;
+        for(int i = 0; i < arrays.size(); i++){
+            if(mask & (1LL << i)){
+                if(!first){
+                    subset << ",";
+                }
+                subset << arrays[i];
+                first = false;
+            }
+        }
+        subsets->push_back(subset.str());
+    }
+
+    return subsets;
+}
+
+
+void ParameterSpace::readSpecificationFromFile(string fileName)
+{
+    ifstream file;
+    file.open(fileName);
+    if(!file.is_open()){
+        cerr << "ERROR: Could not open parameter specification " << fileName << ". Exiting..." << endl;
+        exit(-1);
+    }
+
+    string line;
+    while(getline(file, line)){
+        if(line.empty() || line[0] == '#'){
+            continue;
+        }
+
+        int split = line.find(":");
+        string property = line.substr(0,split);
+        string value = line.substr(split+1,line.size());
+
+        vector<string> listedValues;
+        istringstream iss(value);
+        string token;
+        while(getline(iss, token, ',')){
+            if(!token.empty()){
+                listedValues.push_back(token);
+            }
+        }
+
+        if(isArrayDimension(property)){
+            if(listedValues.empty()){
+                continue;
+            }
+            names->push_back(property);
+            values->push_back(getSubsets(listedValues));
+        }
+        else{
+            if(listedValues.empty()){
+                cerr << "ERROR: No values given for " << property << " in " << fileName << ". Exiting..." << endl;
+                exit(-1);
+            }
+            names->push_back(property);
+            values->push_back(new vector<string>(listedValues));
+        }
+    }
+
+    file.close();
+}
+
+
+long long ParameterSpace::size()
+{
+    if(validPoints != NULL){
+        return validPoints->size();
+    }
+    return getCrossProductSize();
+}
+
+
+long long ParameterSpace::getCrossProductSize()
+{
+    long long size = 1;
+    for(vector<string>* dimensionValues : *values){
+        size *= dimensionValues->size();
+    }
+    return size;
+}
+
+
+int ParameterSpace::getNumberOfDimensions()
+{
+    return names->size();
+}
+
+
+string ParameterSpace::getName(int dimension)
+{
+    return names->at(dimension);
+}
+
+
+vector<string>* ParameterSpace::getValues(int dimension)
+{
+    return values->at(dimension);
+}
+
+
+// Values can only be removed before the valid points are set, since the points refer to
+// value indices
+void ParameterSpace::removeValues(int dimension, vector<bool> remove)
+{
+    if(validPoints != NULL){
+        cerr << "ERROR: Cannot remove values from a space with valid points. Exiting..." << endl;
+        exit(-1);
+    }
+
+    vector<string>* kept = new vector<string>();
+    for(int i = 0; i < values->at(dimension)->size(); i++){
+        if(!remove[i]){
+            kept->push_back(values->at(dimension)->at(i));
+        }
+    }
+    values->at(dimension) = kept;
+}
+
+
+void ParameterSpace::setValidPoints(vector<long long>* validPoints)
+{
+    this->validPoints = validPoints;
+}
+
+
+bool ParameterSpace::hasValidPoints()
+{
+    return validPoints != NULL;
+}
+
+
+vector<int> ParameterSpace::getPoint(long long index)
+{
+    if(validPoints != NULL){
+        return getCrossProductPoint(validPoints->at(index));
+    }
+    return getCrossProductPoint(index);
+}
+
+
+// Configurations are numbered with the first dimension varying fastest
+vector<int> ParameterSpace::getCrossProductPoint(long long index)
+{
+    vector<int> point;
+    for(vector<string>* dimensionValues : *values){
+        point.push_back(index % dimensionValues->size());
+        index /= dimensionValues->size();
+    }
+    return point;
+}
+
+
+long long ParameterSpace::getCrossProductIndex(vector<int> point)
+{
+    long long index = 0;
+    for(int i = values->size() - 1; i >= 0; i--){
+        index = index * values->at(i)->size() + point[i];
+    }
+    return index;
+}
+
+
+// The points that differ from the given point in one dimension, by taking the next or
+// previous value, or, for memory space options, by adding or removing one array
+vector<vector<int>> ParameterSpace::getNeighbours(vector<int> point)
+{
+    vector<vector<int>> neighbours;
+    for(int i = 0; i < names->size(); i++){
+        if(isArrayDimension(names->at(i))){
+            int nArrays = countArrays(values->at(i));
+            for(int a = 0; a < nArrays; a++){
+                vector<int> neighbour = point;
+                neighbour[i] = point[i] ^ (1 << a);
+                neighbours.push_back(neighbour);
+            }
+        }
+        else{
+            if(point[i] > 0){
+                vector<int> neighbour = point;
+                neighbour[i]--;
+                neighbours.push_back(neighbour);
+            }
+            if(point[i] < values->at(i)->size() - 1){
+                vector<int> neighbour = point;
+                neighbour[i]++;
+                neighbours.push_back(neighbour);
+            }
+        }
+    }
+    return neighbours;
+}
+
+
+Parameters ParameterSpace::getConfiguration(vector<int> point)
+{
+    ostringstream config;
+    for(int i = 0; i < names->size(); i++){
+        string value = values->at(i)->at(point[i]);
+        if(value.empty()){
+            continue;
+        }
+        config << names->at(i) << ":" << value << endl;
+    }
+
+    Parameters params;
+    params.setDefaultParameters();
+    istringstream configStream(config.str());
+    params.readParametersFromStream(configStream);
+
+    return params;
+}
+
+
+map<string, string> ParameterSpace::getConfigValues(Parameters params)
+{
+    ostringstream config;
+    params.writeParametersToStream(config);
+
+    map<string, string> configValues;
+    istringstream configStream(config.str());
+    string line;
+    while(getline(configStream, line)){
+        int split = line.find(":");
+        configValues[line.substr(0,split)] = line.substr(split+1,line.size());
+    }
+
+    return configValues;
+}
+
+
+// The point of a configuration, if it is in the space. Used to map stored measurements
+// back into the space.
+bool ParameterSpace::findPoint(Parameters params, vector<int>& point)
+{
+    map<string, string> configValues = getConfigValues(params);
+
+    point.clear();
+    for(int i = 0; i < names->size(); i++){
+        string value = "";
+        if(configValues.count(names->at(i)) == 1){
+            value = configValues[names->at(i)];
+        }
+        else if(!isArrayDimension(names->at(i))){
+            return false;
+        }
+
+        int found = -1;
+        for(int j = 0; j < values->at(i)->size() && found < 0; j++){
+            if(isArrayDimension(names->at(i))){
+                vector<string> a = StringUtils::tokenize(values->at(i)->at(j), ",");
+                vector<string> b = StringUtils::tokenize(value, ",");
+                if(set<string>(a.begin(), a.end()) == set<string>(b.begin(), b.end())){
+                    found = j;
+                }
+            }
+            else if(values->at(i)->at(j).compare(value) == 0){
+                found = j;
+            }
+        }
+
+        if(found < 0){
+            return false;
+        }
+        point.push_back(found);
+    }
+
+    return true;
+}
+
+
+// The point closest to a configuration that may not be in the space. Numerical parameters
+// get the closest value in the space, and the first value if they are not given, which for
+// LOOP parameters is the smallest unroll factor. Arrays that are not in the space are
+// ignored for the memory space options.
+vector<int> ParameterSpace::getClosestPoint(Parameters params)
+{
+    map<string, string> configValues = getConfigValues(params);
+
+    vector<int> point;
+    for(int i = 0; i < names->size(); i++){
+        int closest = 0;
+
+        if(configValues.count(names->at(i)) == 1){
+            string value = configValues[names->at(i)];
+
+            if(isArrayDimension(names->at(i))){
+                vector<string> wanted = StringUtils::tokenize(value, ",");
+                set<string> wantedSet(wanted.begin(), wanted.end());
+
+                vector<string> all = StringUtils::tokenize(values->at(i)->back(), ",");
+                for(int a = 0; a < all.size(); a++){
+                    if(wantedSet.count(all[a]) == 1){
+                        closest |= 1 << a;
+                    }
+                }
+            }
+            else{
+                double target = stod(value);
+                for(int j = 1; j < values->at(i)->size(); j++){
+                    if(fabs(stod(values->at(i)->at(j)) - target) < fabs(stod(values->at(i)->at(closest)) - target)){
+                        closest = j;
+                    }
+                }
+            }
+        }
+
+        point.push_back(closest);
+    }
+
+    return point;
+}
+
+
+// The number of arrays a memory space dimension was built from, the last subset contains all of them
+int ParameterSpace::countArrays(vector<string>* subsets)
+{
+    string all = subsets->back();
+    return count(all.begin(), all.end(), ',') + 1;
+}
+
+
+// Numerical description of a point, used by the surrogate model. Numerical parameters
+// are used directly, and memory space options give one 0/1 feature per array.
+vector<double> ParameterSpace::getFeatures(vector<int> point)
+{
+    vector<double> features;
+    for(int i = 0; i < names->size(); i++){
+        if(isArrayDimension(names->at(i))){
+            int nArrays = countArrays(values->at(i));
+            for(int a = 0; a < nArrays; a++){
+                features.push_back((point[i] >> a) & 1);
+            }
+        }
+        else{
+            features.push_back(stod(values->at(i)->at(point[i])));
+        }
+    }
+    return features;
+}
+
+
+void ParameterSpace::printSpace()
+{
+    char esc_char = 27;
+    cout << esc_char << "[1m" << "== Parameter space ==" << esc_char << "[0m" << endl;
+
+    for(int i = 0; i < names->size(); i++){
+        cout << names->at(i) << ": " << values->at(i)->size() << " values" << endl;
+    }
+    cout << "Total configurations: " << getCrossProductSize() << endl;
+    if(validPoints != NULL){
+        cout << "Valid configurations: " << validPoints->size() << endl;
+    }
+    cout << endl;
+}
@@ -0,0 +1,62 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef PARAMETERSPACE_H
+#define PARAMETERSPACE_H
+
+#include "parameters.h"
+
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+// The tuning parameters listed in param_spec.txt. Each line is one dimension of the space.
+// For the memory space options, the values are all subsets of the listed arrays.
+// A configuration is identified by a point, holding one value index per dimension.
+// After pruning, the space can be restricted to an explicit list of valid points.
+class ParameterSpace
+{
+public:
+    ParameterSpace();
+    void readSpecificationFromFile(string fileName);
+
+    long long size();
+    long long getCrossProductSize();
+    int getNumberOfDimensions();
+    string getName(int dimension);
+    vector<string>* getValues(int dimension);
+
+    void removeValues(int dimension, vector<bool> remove);
+    void setValidPoints(vector<long long>* validPoints);
+    bool hasValidPoints();
+
+    vector<int> getPoint(long long index);
+    vector<int> getCrossProductPoint(long long index);
+    long long getCrossProductIndex(vector<int> point);
+    vector<vector<int>> getNeighbours(vector<int> point);
+    Parameters getConfiguration(vector<int> point);
+    vector<double> getFeatures(vector<int> point);
+    bool findPoint(Parameters params, vector<int>& point);
+    vector<int> getClosestPoint(Parameters params);
+    void printSpace();
+
+private:
+    static bool isArrayDimension(string name);
+    static vector<string>* getSubsets(vector<string> arrays);
+    static int countArrays(vector<string>* subsets);
+    static map<string, string> getConfigValues(Parameters params);
+
+    vector<string>* names;
+    vector<vector<string>*>* values;
+
+    // Indices into the cross product of the points known to be valid, NULL if not pruned
+    vector<long long>* validPoints;
+};
+
+#endif // PARAMETERSPACE_H
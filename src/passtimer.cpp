@@ -0,0 +1,142 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "passtimer.h"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+PassTimer* PassTimer::instance;
+
+PassTimer::PassTimer()
+{
+    enabled = false;
+    creationTime = chrono::steady_clock::now();
+}
+
+PassTimer* PassTimer::getInstance()
+{
+    if(PassTimer::instance == NULL){
+        instance = new PassTimer();
+    }
+
+    return instance;
+}
+
+void PassTimer::enable()
+{
+    enabled = true;
+}
+
+bool PassTimer::isEnabled()
+{
+    return enabled;
+}
+
+// Peak resident set size of this process so far, in kB
+long PassTimer::getPeakRss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void PassTimer::begin(string name)
+{
+    if(!enabled){
+        return;
+    }
+
+    PassRecord record;
+    record.name = name;
+    record.depth = openPasses.size();
+    record.seconds = 0;
+    record.peakRssKb = 0;
+    record.rssGrowthKb = 0;
+
+    records.push_back(record);
+    openPasses.push_back(records.size() - 1);
+    startRss.push_back(getPeakRss());
+    startTimes.push_back(chrono::steady_clock::now());
+}
+
+void PassTimer::end()
+{
+    if(!enabled){
+        return;
+    }
+
+    if(openPasses.empty()){
+        cout << "WARNING: Ending pass timing without a started pass" << endl;
+        return;
+    }
+
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - startTimes.back();
+
+    PassRecord& record = records[openPasses.back()];
+    record.seconds = elapsed.count();
+    record.peakRssKb = getPeakRss();
+    record.rssGrowthKb = record.peakRssKb - startRss.back();
+
+    openPasses.pop_back();
+    startTimes.pop_back();
+    startRss.pop_back();
+}
+
+void PassTimer::printReport()
+{
+    if(!enabled){
+        return;
+    }
+
+    chrono::duration<double> total = chrono::steady_clock::now() - creationTime;
+
+    char esc_char = 27;
+    cout << esc_char << "[1m" << "== Pass timing ==" << esc_char << "[0m" << endl;
+
+    cout << left << setw(40) << "Pass" << right << setw(12) << "Time (s)" << setw(8) << "%" << setw(16) << "Peak RSS (kB)" << setw(14) << "Growth (kB)" << endl;
+    for(PassRecord record : records){
+        string name = string(2 * record.depth, ' ') + record.name;
+        double percent = total.count() > 0 ? 100.0 * record.seconds / total.count() : 0;
+
+        cout << left << setw(40) << name << right << fixed << setprecision(3) << setw(12) << record.seconds << setprecision(1) << setw(8) << percent << setw(16) << record.peakRssKb << setw(14) << record.rssGrowthKb << endl;
+    }
+    cout << left << setw(40) << "Total" << right << setprecision(3) << setw(12) << total.count() << setw(8) << "" << setw(16) << getPeakRss() << endl;
+
+    cout.unsetf(ios::floatfield | ios::adjustfield);
+    cout << setprecision(6);
+}
+
+void PassTimer::writeJson(string fileName)
+{
+    if(!enabled){
+        return;
+    }
+
+    chrono::duration<double> total = chrono::steady_clock::now() - creationTime;
+
+    ofstream file(fileName);
+    file << "{" << endl;
+    file << "  \"total_seconds\": " << total.count() << "," << endl;
+    file << "  \"peak_rss_kb\": " << getPeakRss() << "," << endl;
+    file << "  \"passes\": [" << endl;
+
+    for(int i = 0; i < records.size(); i++){
+        PassRecord record = records[i];
+        file << "    {\"name\": \"" << record.name << "\", \"depth\": " << record.depth;
+        file << ", \"seconds\": " << record.seconds << ", \"peak_rss_kb\": " << record.peakRssKb;
+        file << ", \"rss_growth_kb\": " << record.rssGrowthKb << "}";
+        file << (i + 1 < records.size() ? "," : "") << endl;
+    }
+
+    file << "  ]" << endl;
+    file << "}" << endl;
+    file.close();
+}
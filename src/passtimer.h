@@ -0,0 +1,60 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef PASSTIMER_H
+#define PASSTIMER_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+class PassRecord
+{
+public:
+    string name;
+    int depth;
+    double seconds;
+    long peakRssKb;
+    long rssGrowthKb;
+};
+
+// Records the wall time and peak resident set size of each compiler pass, when enabled
+// with -clite:time-passes. Passes can be nested, e.g. the individual transformations
+// within the generation of a variant.
+class PassTimer
+{
+public:
+    static PassTimer* getInstance();
+
+    void enable();
+    bool isEnabled();
+
+    void begin(string name);
+    void end();
+
+    void printReport();
+    void writeJson(string fileName);
+
+private:
+    PassTimer();
+    long getPeakRss();
+
+    static PassTimer* instance;
+    bool enabled;
+
+    vector<PassRecord> records;
+
+    // Indices into records of the passes that have been started, but not ended
+    vector<int> openPasses;
+    vector<chrono::steady_clock::time_point> startTimes;
+    vector<long> startRss;
+    chrono::steady_clock::time_point creationTime;
+};
+
+#endif // PASSTIMER_H
@@ -26,17 +26,35 @@ Pragma::Pragma(string pragmaString) : pragmaString(pragmaString)
         break;
     case PIXEL:
     case BOUNDARY_COND:
+    case FUSE:
 
         parseValuePairs();
         break;
     case GRID_SIZE:
         parseGridSize();
         break;
+    case ITERATE:
+        parseIterations();
+        break;
     }
 }
 
+// The option is the word before the parenthesis, as in "clite fuse(a:b)", so that option
+// names in the values do not match. Other pragmas fall back to the longest option name found.
 PragmaOption Pragma::findPragmaOption()
 {
+    string name = pragmaString.substr(0, pragmaString.find('('));
+    size_t nameEnd = name.find_last_not_of(" \t");
+    name = nameEnd == string::npos ? "" : name.substr(0, nameEnd + 1);
+    size_t nameStart = name.find_last_of(" \t");
+    if(nameStart != string::npos){
+        name = name.substr(nameStart + 1);
+    }
+    if(pragmaStringToOption.count(name) == 1){
+        this->option = pragmaStringToOption.at(name);
+        return this->option;
+    }
+
     int matchlength = 0;
     for(pair<string,PragmaOption>  sp : pragmaStringToOption){
         if(pragmaString.find(sp.first) != string::npos){
@@ -46,6 +64,7 @@ PragmaOption Pragma::findPragmaOption()
             }
         }
     }
+    return this->option;
 }
 
 void Pragma::parseValues()
@@ -77,6 +96,12 @@ void Pragma::parseGridSize()
     this->y = stoi(StringUtils::strip(rawValues[1]));
 }
 
+// iterate(N), the number of time steps, is kept in x
+void Pragma::parseIterations()
+{
+    this->x = stoi(StringUtils::strip(StringUtils::getParenValue(pragmaString)));
+}
+
 
 bool Pragma::operator <(const Pragma& lhs) const
 {
@@ -102,6 +127,7 @@ string Pragma::str()
         break;
     case PIXEL:
     case BOUNDARY_COND:
+    case FUSE:
         for(pair<string, string> ps : pairValues){
             s << ps.first << ":" << ps.second << ", ";
         }
@@ -109,6 +135,9 @@ string Pragma::str()
     case GRID_SIZE:
         s << this->x << "," << this->y;
         break;
+    case ITERATE:
+        s << this->x;
+        break;
     }
 
     return s.str();
@@ -159,3 +188,18 @@ vector<string> StringUtils::tokenize(string s, string split){
 
     return tokens;
 }
+
+
+// 64 bit FNV-1a, as hex. Not cryptographic, only used to identify kernels.
+string StringUtils::hash(string s)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    for(unsigned char c : s){
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+
+    ostringstream hex;
+    hex << std::hex << h;
+    return hex.str();
+}
@@ -21,9 +21,10 @@ public:
     static string strip(string s);
     static string getParenValue(string s);
     static vector<string> tokenize(string s, string split);
+    static string hash(string s);
 };
 
-enum PragmaOption {GRID,IMAGE_MEM,LOCAL_MEM,CONSTANT_MEM,PIXEL,BOUNDARY_COND,GRID_SIZE,CONSTANT_MEM_CAND};
+enum PragmaOption {GRID,IMAGE_MEM,LOCAL_MEM,CONSTANT_MEM,PIXEL,BOUNDARY_COND,GRID_SIZE,CONSTANT_MEM_CAND,FUSE,ITERATE};
 
 class Pragma
 {
@@ -47,7 +48,9 @@ private:
                                                            {"constant_mem_cand",CONSTANT_MEM_CAND},
                                                            {"pixel",PIXEL},
                                                            {"boundary_cond",BOUNDARY_COND},
-                                                           {"grid_size",GRID_SIZE}
+                                                           {"grid_size",GRID_SIZE},
+                                                           {"fuse",FUSE},
+                                                           {"iterate",ITERATE}
                                                           };
 
     const map<PragmaOption, string> pragmaOptionToString = {{GRID, "grid"},
@@ -57,12 +60,15 @@ private:
                                                            {CONSTANT_MEM_CAND, "constant_mem_cand"},
                                                            {PIXEL, "pixel"},
                                                            {BOUNDARY_COND, "boundary_cond"},
-                                                           {GRID_SIZE, "grid_size"}
+                                                           {GRID_SIZE, "grid_size"},
+                                                           {FUSE, "fuse"},
+                                                           {ITERATE, "iterate"}
                                                           };
     PragmaOption findPragmaOption();
     void parseValues();
     void parseValuePairs();
     void parseGridSize();
+    void parseIterations();
 
     string pragmaString;
 
@@ -0,0 +1,184 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "programgenerator.h"
+
+#include "variantgenerator.h"
+#include "wrappergenerator.h"
+#include "filehandler.h"
+#include "astutil.h"
+#include "astindex.h"
+#include "passtimer.h"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+ProgramGenerator::ProgramGenerator(SgProject *project, vector<KernelInfo> kernels, Settings settings, Rose_STL_Container<string> fileNames, vector<SeparableFilter> separableFilters) : project(project), kernels(kernels), settings(settings), fileNames(fileNames), separableFilters(separableFilters)
+{
+    for(KernelInfo kernel : kernels){
+        declarations.push_back(findKernelDeclaration(kernel.getKernelName()));
+    }
+}
+
+
+SgFunctionDeclaration* ProgramGenerator::findKernelDeclaration(string kernelName)
+{
+    for(SgFunctionDeclaration* funcDec : AstUtil::findKernelDeclarations(project)){
+        if(funcDec->get_name().getString() == kernelName){
+            return funcDec;
+        }
+    }
+
+    cerr << "ERROR: Could not find kernel " << kernelName << ". Exiting..." << endl;
+    exit(-1);
+}
+
+
+int ProgramGenerator::findKernel(string kernelName)
+{
+    for(int i = 0; i < kernels.size(); i++){
+        if(kernels[i].getKernelName() == kernelName){
+            return i;
+        }
+    }
+
+    cerr << "ERROR: Could not find kernel " << kernelName << ". Exiting..." << endl;
+    exit(-1);
+}
+
+
+// Each kernel remembers the statement after it, so that it can be put back in its
+// original place. Kernels are detached in source order, and reattached in reverse order.
+void ProgramGenerator::detachOtherKernels(int kernel)
+{
+    for(int i = 0; i < declarations.size(); i++){
+        if(i == kernel){
+            continue;
+        }
+
+        SgFunctionDeclaration* funcDec = declarations[i];
+        DetachedKernel entry;
+        entry.declaration = funcDec;
+        entry.next = getNextStatement(funcDec);
+        entry.global = isSgGlobal(funcDec->get_scope());
+
+        removeStatement(funcDec);
+        detached.push_back(entry);
+    }
+
+    AstIndex::getInstance()->invalidate();
+}
+
+
+void ProgramGenerator::reattachKernels()
+{
+    for(auto entry = detached.rbegin(); entry != detached.rend(); ++entry){
+        if(entry->next != NULL){
+            insertStatementBefore(entry->next, entry->declaration);
+        }
+        else{
+            appendStatement(entry->declaration, entry->global);
+        }
+    }
+    detached.clear();
+
+    AstIndex::getInstance()->invalidate();
+}
+
+
+void ProgramGenerator::generate(vector<Parameters> parameterSets)
+{
+    if(settings.generateMPI || settings.generateOMP || settings.generateFAST){
+        cerr << "ERROR: Files with several kernels are not supported with MPI, OpenMP or FAST. Exiting..." << endl;
+        exit(-1);
+    }
+
+    PassTimer* timer = PassTimer::getInstance();
+    string wrapperFileName = settings.inputBaseName + "_wrapper.c";
+
+    Settings kernelSettings = settings;
+    kernelSettings.generateStandalone = false;
+
+    vector<vector<Argument>*> kernelArguments;
+    for(int i = 0; i < kernels.size(); i++){
+        string kernelName = kernels[i].getKernelName();
+        cout << "[Program] Transforming kernel " << kernelName << endl;
+
+        // The intermediate image of a split kernel is shared by the passes as a buffer
+        for(SeparableFilter filter : separableFilters){
+            if((filter.kernel == kernelName || filter.rowsKernel == kernelName) && parameterSets[i].imageMemArrays->erase(filter.intermediate) == 1){
+                cout << "WARNING: " << filter.intermediate << " can not use image memory, it is kept in a buffer between the passes" << endl;
+            }
+        }
+
+        timer->begin("Transform " + kernelName);
+        detachOtherKernels(i);
+        VariantGenerator variantGenerator(project, kernels[i], kernelSettings, fileNames);
+        vector<Argument>* arguments = variantGenerator.transform(parameterSets[i], kernelSettings);
+        reattachKernels();
+        timer->end();
+        kernelArguments.push_back(arguments);
+
+        // The passes of a split kernel get the intermediate image as a buffer on the device
+        string functionName = "process_" + kernelName;
+        string residentImage;
+        for(SeparableFilter filter : separableFilters){
+            if(filter.kernel == kernelName){
+                functionName += "_cols";
+                residentImage = filter.intermediate;
+            }
+            if(filter.rowsKernel == kernelName){
+                residentImage = filter.intermediate;
+            }
+        }
+
+        if(settings.generateStandalone){
+            WrapperGenerator wrapperGenerator(wrapperFileName, arguments, parameterSets[i], kernels[i], settings);
+            if(i == 0){
+                wrapperGenerator.generateHeader();
+            }
+            wrapperGenerator.generateFunction(functionName, residentImage);
+        }
+    }
+
+    if(settings.generateStandalone){
+        generateSeparableFunctions(parameterSets, kernelArguments);
+    }
+
+    timer->begin("Unparse");
+    FileHandler::setOutputFileNames(project, settings.inputBaseName, settings);
+    project->unparse();
+    timer->end();
+
+    if(settings.generateStandalone){
+        timer->begin("Format wrapper");
+        FileHandler::indentWrapper(settings);
+        timer->end();
+    }
+}
+
+
+void ProgramGenerator::generateSeparableFunctions(vector<Parameters> parameterSets, vector<vector<Argument>*> arguments)
+{
+    string wrapperFileName = settings.inputBaseName + "_wrapper.c";
+
+    for(SeparableFilter filter : separableFilters){
+        int columns = findKernel(filter.kernel);
+        int rows = findKernel(filter.rowsKernel);
+
+        Argument source("", Type());
+        for(Argument arg : *arguments[rows]){
+            if(arg.name == filter.source){
+                source = arg;
+            }
+        }
+
+        WrapperGenerator wrapperGenerator(wrapperFileName, arguments[columns], parameterSets[columns], kernels[columns], settings);
+        wrapperGenerator.generateSeparableFunction("process_" + filter.kernel, filter, source, kernels[rows].getPixelType(filter.source));
+    }
+}
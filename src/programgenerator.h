@@ -0,0 +1,62 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef PROGRAMGENERATOR_H
+#define PROGRAMGENERATOR_H
+
+#include "rose.h"
+
+#include "kernelinfo.h"
+#include "parameters.h"
+#include "settings.h"
+#include "separablesplitter.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class DetachedKernel
+{
+public:
+    SgFunctionDeclaration* declaration;
+    SgStatement* next;
+    SgGlobal* global;
+};
+
+// Generates one OpenCL program, <base>.cl, and one wrapper, with a function process_<kernel>
+// for each kernel, from a file with several kernels. The kernels share one AST, so helper
+// functions and types are only emitted once. While a kernel is transformed, the other
+// kernels are detached from the AST, so that the passes, which work on the whole project,
+// only see that kernel. For each separable filter, process_<kernel> runs both passes, and
+// the function for the column pass is named process_<kernel>_cols.
+class ProgramGenerator
+{
+public:
+    ProgramGenerator(SgProject* project, vector<KernelInfo> kernels, Settings settings, Rose_STL_Container<string> fileNames, vector<SeparableFilter> separableFilters = vector<SeparableFilter>());
+
+    void generate(vector<Parameters> parameterSets);
+
+private:
+    void detachOtherKernels(int kernel);
+    void reattachKernels();
+    SgFunctionDeclaration* findKernelDeclaration(string kernelName);
+    int findKernel(string kernelName);
+    void generateSeparableFunctions(vector<Parameters> parameterSets, vector<vector<Argument>*> arguments);
+
+    SgProject* project;
+    vector<KernelInfo> kernels;
+    Settings settings;
+    Rose_STL_Container<string> fileNames;
+    vector<SeparableFilter> separableFilters;
+
+    // Found before any transformation, since transformed kernels no longer have Image arguments
+    vector<SgFunctionDeclaration*> declarations;
+    vector<DetachedKernel> detached;
+};
+
+#endif // PROGRAMGENERATOR_H
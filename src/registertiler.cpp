@@ -0,0 +1,246 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "registertiler.h"
+
+#include "astutil.h"
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+RegisterTiler::RegisterTiler(SgProject *project, Parameters params, KernelInfo kernelInfo, Settings settings, SgBasicBlock *loopBody) : project(project), params(params), kernelInfo(kernelInfo), settings(settings), loopBody(loopBody)
+{
+}
+
+
+SgExpression* buildOffsetExpression(SgExpression* base, int offset)
+{
+    if(offset < 0){
+        return buildSubtractOp(base, buildIntVal(-offset));
+    }
+    if(offset > 0){
+        return buildAddOp(base, buildIntVal(offset));
+    }
+    return base;
+}
+
+
+// index, index + c or index - c, for an integer constant c
+bool isIndexWithOffset(SgExpression* expression, string index, int* offset)
+{
+    SgVarRefExp* varRef = isSgVarRefExp(expression);
+    if(varRef){
+        *offset = 0;
+        return varRef->get_symbol()->get_name().getString() == index;
+    }
+
+    SgBinaryOp* binaryOp = isSgBinaryOp(expression);
+    if(!(isSgAddOp(expression) || isSgSubtractOp(expression))){
+        return false;
+    }
+
+    SgVarRefExp* lhs = isSgVarRefExp(binaryOp->get_lhs_operand());
+    SgIntVal* rhs = isSgIntVal(binaryOp->get_rhs_operand());
+    if(!lhs || !rhs || lhs->get_symbol()->get_name().getString() != index){
+        return false;
+    }
+
+    *offset = isSgAddOp(expression) ? rhs->get_value() : -rhs->get_value();
+    return true;
+}
+
+
+// Only read-only images in global memory, read at offsets from the thread, are tiled. The
+// elements of a thread must be adjacent, which they are only without interleaving.
+bool RegisterTiler::isRegisterTiled(string arrayName, KernelInfo& kernelInfo, Parameters& params, Settings& settings)
+{
+    if(!params.registerTiling || params.interleaved || settings.generateMPI || settings.generateOMP){
+        return false;
+    }
+    if(params.elementsPerThreadX * params.elementsPerThreadY <= 1){
+        return false;
+    }
+    if(!kernelInfo.isImageArray(arrayName) || kernelInfo.getReadOnlyArrays()->count(arrayName) == 0){
+        return false;
+    }
+    if(params.localMemArrays->count(arrayName) == 1 || params.imageMemArrays->count(arrayName) == 1 || params.constantMemArrays->count(arrayName) == 1){
+        return false;
+    }
+    if(!kernelInfo.hasFootprint(arrayName) || kernelInfo.getFootprintTable().at(arrayName).threadStatic){
+        return false;
+    }
+    return kernelInfo.getHaloSize(arrayName).getMax() > 0;
+}
+
+
+void RegisterTiler::transform()
+{
+    SgForStatement* innerLoop = isSgForStatement(loopBody->get_parent());
+    SgForStatement* outerLoop = isSgForStatement(innerLoop->get_parent()->get_parent());
+    SgBasicBlock* functionBody = isSgBasicBlock(outerLoop->get_parent());
+
+    bool tiled = false;
+    for(string arrayName : *kernelInfo.getImageArrays()){
+        if(!isRegisterTiled(arrayName, kernelInfo, params, settings)){
+            continue;
+        }
+
+        vector<SgPntrArrRefExp*> tileReads = findTileReads(arrayName);
+        if(tileReads.empty()){
+            cout << "WARNING: " << arrayName << " is not read at constant offsets from idx and idy, not register tiling it" << endl;
+            continue;
+        }
+
+        if(!tiled){
+            SgFunctionCallExp* getGlobalIdx = buildFunctionCallExp("get_global_id", buildIntType(), buildExprListExp(buildIntVal(0)), functionBody);
+            SgAssignInitializer* baseX = buildAssignInitializer(buildMultiplyOp(getGlobalIdx, buildIntVal(params.elementsPerThreadX)));
+            insertStatementBefore(outerLoop, buildVariableDeclaration("reg_base_x", buildIntType(), baseX, functionBody));
+
+            SgFunctionCallExp* getGlobalIdy = buildFunctionCallExp("get_global_id", buildIntType(), buildExprListExp(buildIntVal(1)), functionBody);
+            SgAssignInitializer* baseY = buildAssignInitializer(buildMultiplyOp(getGlobalIdy, buildIntVal(params.elementsPerThreadY)));
+            insertStatementBefore(outerLoop, buildVariableDeclaration("reg_base_y", buildIntType(), baseY, functionBody));
+            tiled = true;
+        }
+
+        set<Point> tilePoints = findTilePoints(arrayName);
+        cout << "[RegisterTiler] loading " << tilePoints.size() << " pixels of " << arrayName << " per thread" << endl;
+
+        insertTileLoads(arrayName, tilePoints);
+        replaceWithTileReads(arrayName, tileReads);
+    }
+
+    if(tiled){
+        unrollCoarseningLoops();
+    }
+}
+
+
+// The union of the footprints of the elements of a thread, relative to its first element
+set<Point> RegisterTiler::findTilePoints(string arrayName)
+{
+    set<Point> tilePoints;
+    set<Point>* footprintPoints = kernelInfo.getFootprintTable().at(arrayName).getPoints();
+
+    for(int x = 0; x < params.elementsPerThreadX; x++){
+        for(int y = 0; y < params.elementsPerThreadY; y++){
+            for(Point p : *footprintPoints){
+                tilePoints.insert(Point(x + p.x, y + p.y));
+            }
+        }
+    }
+
+    return tilePoints;
+}
+
+
+// The tile covers the bounding box of the footprints, but only the pixels actually read are
+// loaded. The loads read outside the image for threads at the edge, so they are guarded like
+// any other read, see BoundryGuardInserter::needsBoundaryGuard.
+void RegisterTiler::insertTileLoads(string arrayName, set<Point> tilePoints)
+{
+    SgForStatement* innerLoop = isSgForStatement(loopBody->get_parent());
+    SgForStatement* outerLoop = isSgForStatement(innerLoop->get_parent()->get_parent());
+    SgBasicBlock* functionBody = isSgBasicBlock(outerLoop->get_parent());
+
+    HaloSize hs = kernelInfo.getHaloSize(arrayName);
+    int tileSizeX = params.elementsPerThreadX + hs.left + hs.right;
+    int tileSizeY = params.elementsPerThreadY + hs.up + hs.down;
+
+    string tileName = "reg_tile_" + arrayName;
+    SgType* tileType = buildArrayType(buildArrayType(buildPixelType(arrayName), buildIntVal(tileSizeY)), buildIntVal(tileSizeX));
+    insertStatementBefore(outerLoop, buildVariableDeclaration(tileName, tileType, NULL, functionBody));
+
+    for(Point p : tilePoints){
+        SgExpression* tileX = buildIntVal(p.x + hs.left);
+        SgExpression* tileY = buildIntVal(p.y + hs.up);
+        SgExpression* tileRef = buildPntrArrRefExp(buildPntrArrRefExp(buildVarRefExp(tileName, functionBody), tileX), tileY);
+
+        SgExpression* imageX = buildOffsetExpression(buildVarRefExp("reg_base_x", functionBody), p.x);
+        SgExpression* imageY = buildOffsetExpression(buildVarRefExp("reg_base_y", functionBody), p.y);
+        SgExpression* imageRef = buildPntrArrRefExp(buildPntrArrRefExp(buildVarRefExp(arrayName, functionBody), imageX), imageY);
+
+        insertStatementBefore(outerLoop, buildAssignStatement(tileRef, imageRef));
+    }
+}
+
+
+// Only reads at constant offsets from idx and idy, inside the halo, are in the tile; other
+// reads, such as at absolute positions, are left as reads from global memory.
+vector<SgPntrArrRefExp*> RegisterTiler::findTileReads(string arrayName)
+{
+    HaloSize hs = kernelInfo.getHaloSize(arrayName);
+    vector<SgPntrArrRefExp*> tileReads;
+
+    Rose_STL_Container<SgNode*> arrRefNodes = NodeQuery::querySubTree(loopBody, V_SgPntrArrRefExp);
+    for(SgNode* arrRefNode : arrRefNodes){
+        SgPntrArrRefExp* arrRef = isSgPntrArrRefExp(arrRefNode);
+        if(isSgPntrArrRefExp(arrRef->get_parent()) || AstUtil::getArrayName(arrRef) != arrayName){
+            continue;
+        }
+
+        SgPntrArrRefExp* middle = isSgPntrArrRefExp(arrRef->get_lhs_operand());
+        SgExpression* x = middle->get_rhs_operand();
+        SgExpression* y = arrRef->get_rhs_operand();
+
+        int dx, dy;
+        if(!isIndexWithOffset(x, "idx", &dx) || !isIndexWithOffset(y, "idy", &dy)){
+            continue;
+        }
+        if(dx < -hs.left || dx > hs.right || dy < -hs.up || dy > hs.down){
+            continue;
+        }
+
+        tileReads.push_back(arrRef);
+    }
+
+    return tileReads;
+}
+
+
+// Since idx = reg_base_x + coars_x, a read at idx + dx is at coars_x + dx in the tile
+void RegisterTiler::replaceWithTileReads(string arrayName, vector<SgPntrArrRefExp*> tileReads)
+{
+    HaloSize hs = kernelInfo.getHaloSize(arrayName);
+    string tileName = "reg_tile_" + arrayName;
+
+    for(SgPntrArrRefExp* arrRef : tileReads){
+        SgScopeStatement* scope = getScope(arrRef);
+        SgPntrArrRefExp* middle = isSgPntrArrRefExp(arrRef->get_lhs_operand());
+        SgExpression* x = middle->get_rhs_operand();
+        SgExpression* y = arrRef->get_rhs_operand();
+
+        SgExpression* tileX = buildOffsetExpression(buildSubtractOp(copyExpression(x), buildVarRefExp("reg_base_x", scope)), hs.left);
+        SgExpression* tileY = buildOffsetExpression(buildSubtractOp(copyExpression(y), buildVarRefExp("reg_base_y", scope)), hs.up);
+
+        replaceExpression(arrRef, buildPntrArrRefExp(buildPntrArrRefExp(buildVarRefExp(tileName, scope), tileX), tileY));
+    }
+}
+
+
+// The tile only stays in registers if every index into it is known at compile time
+void RegisterTiler::unrollCoarseningLoops()
+{
+    SgForStatement* innerLoop = isSgForStatement(loopBody->get_parent());
+    SgForStatement* outerLoop = isSgForStatement(innerLoop->get_parent()->get_parent());
+
+    insertStatementBefore(innerLoop, buildPragmaDeclaration("unroll", getEnclosingScope(innerLoop)));
+    insertStatementBefore(outerLoop, buildPragmaDeclaration("unroll", getEnclosingScope(outerLoop)));
+}
+
+
+SgType* RegisterTiler::buildPixelType(string arrayName)
+{
+    switch(kernelInfo.getPixelType(arrayName)){
+    case INT:
+        return buildIntType();
+    case UCHAR:
+        return buildUnsignedCharType();
+    default:
+        return buildFloatType();
+    }
+}
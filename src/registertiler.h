@@ -0,0 +1,50 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef REGISTERTILER_H
+#define REGISTERTILER_H
+
+#include "rose.h"
+#include "footprintfinder.h"
+#include "parameters.h"
+#include "kernelinfo.h"
+#include "settings.h"
+
+#include <string>
+#include <set>
+#include <vector>
+
+using namespace std;
+
+// With non-interleaved coarsening, loads the union of the footprints of all the elements of
+// a thread into a private array once, before the coarsening loops, and reads the elements'
+// stencils from it. Each distinct pixel is then loaded once per thread, instead of once per
+// element reading it.
+class RegisterTiler
+{
+public:
+    RegisterTiler(SgProject* project, Parameters params, KernelInfo kernelInfo, Settings settings, SgBasicBlock* loopBody);
+    void transform();
+
+    static bool isRegisterTiled(string arrayName, KernelInfo& kernelInfo, Parameters& params, Settings& settings);
+
+private:
+    set<Point> findTilePoints(string arrayName);
+    void insertTileLoads(string arrayName, set<Point> tilePoints);
+    vector<SgPntrArrRefExp*> findTileReads(string arrayName);
+    void replaceWithTileReads(string arrayName, vector<SgPntrArrRefExp*> tileReads);
+    void unrollCoarseningLoops();
+    SgType* buildPixelType(string arrayName);
+
+    SgProject* project;
+    Parameters params;
+    KernelInfo kernelInfo;
+    Settings settings;
+    SgBasicBlock* loopBody;
+};
+
+#endif // REGISTERTILER_H
@@ -0,0 +1,715 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "separablesplitter.h"
+
+#include "pragma.h"
+#include "argument.h"
+#include "astutil.h"
+#include "astindex.h"
+
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+SeparableSplitter::SeparableSplitter(SgProject *project, Settings settings) : project(project), settings(settings)
+{
+}
+
+
+vector<SeparableFilter> SeparableSplitter::splitFilters()
+{
+    vector<SeparableFilter> filters;
+
+    if(settings.generateMPI || settings.generateOMP || settings.generateFAST){
+        cout << "WARNING: SPLIT_SEPARABLE is ignored with MPI, OpenMP or FAST" << endl;
+        return filters;
+    }
+
+    vector<SgFunctionDeclaration*> kernels = AstUtil::findKernelDeclarations(project);
+
+    nextLine = 0;
+    for(SgFunctionDeclaration* kernel : kernels){
+        nextLine = max(nextLine, kernel->get_endOfConstruct()->get_line());
+    }
+    for(SgNode* n : AstIndex::getInstance()->query(project, V_SgPragmaDeclaration)){
+        nextLine = max(nextLine, isSgPragmaDeclaration(n)->get_file_info()->get_line());
+    }
+    nextLine++;
+
+    for(int i = 0; i < kernels.size(); i++){
+        SgFunctionDeclaration* kernel = kernels[i];
+        string kernelName = kernel->get_name().getString();
+
+        if(!findConvolution(kernel)){
+            continue;
+        }
+
+        SgType* intermediateType = findIntermediateType(kernel);
+        if(intermediateType == NULL){
+            cout << "[Separable] Not splitting " << kernelName << ", it has no float image argument to use as type of the intermediate image" << endl;
+            continue;
+        }
+
+        SeparableFilter filter;
+        filter.kernel = kernelName;
+        filter.rowsKernel = kernelName + "_rows";
+        filter.source = source;
+        filter.intermediate = kernelName + "_intermediate";
+        for(SgInitializedName* argument : kernel->get_args()){
+            if(AstUtil::isImageType(argument->get_type())){
+                filter.imageArguments.push_back(argument->get_name().getString());
+            }
+        }
+
+        cout << "[Separable] Splitting " << kernelName << " into " << filter.rowsKernel << " and " << kernelName << ", " << rowWeights.size() << "x" << columnWeights.size() << " weights" << endl;
+
+        int previousKernelEnd = i > 0 ? kernels[i - 1]->get_endOfConstruct()->get_line() : 0;
+        split(kernel, filter, intermediateType, previousKernelEnd);
+        filters.push_back(filter);
+
+        AstIndex::getInstance()->invalidate();
+    }
+
+    if(!filters.empty()){
+        AstUtil::fixUniqueNameAttributes(project);
+    }
+
+    return filters;
+}
+
+
+// Only the first separable convolution of a kernel is split
+bool SeparableSplitter::findConvolution(SgFunctionDeclaration *kernel)
+{
+    Rose_STL_Container<SgNode*> loopNodes = NodeQuery::querySubTree(kernel->get_definition(), V_SgForStatement);
+    for(SgNode* loopNode : loopNodes){
+        if(!matchLoopNest(isSgForStatement(loopNode))){
+            continue;
+        }
+
+        vector<vector<double>> values;
+        if(!readWeights(values)){
+            continue;
+        }
+
+        if(!factorize(values)){
+            cout << "[Separable] The weights " << weights->get_name().getString() << " of " << kernel->get_name().getString() << " are not separable" << endl;
+            continue;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+
+// Two perfectly nested loops with constant bounds, whose body is a single statement
+// acc += w[..][..] * image[idx + ..][idy + ..], where acc is a float, and each index is
+// one of the loop variables plus a constant. A double accumulator is not matched, since the
+// passes sum in float, as the intermediate image holds float pixels.
+bool SeparableSplitter::matchLoopNest(SgForStatement *outer)
+{
+    if(!isSgBasicBlock(outer->get_parent())){
+        return false;
+    }
+
+    lower.clear();
+    upper.clear();
+    varRefs.clear();
+
+    string innerVar;
+    int outerLower, outerUpper, innerLower, innerUpper;
+    if(!parseLoop(outer, outerVar, outerLower, outerUpper)){
+        return false;
+    }
+
+    SgStatement* body = outer->get_loop_body();
+    if(isSgBasicBlock(body) && isSgBasicBlock(body)->get_statements().size() == 1){
+        body = isSgBasicBlock(body)->get_statements()[0];
+    }
+    SgForStatement* inner = isSgForStatement(body);
+    if(!inner || !parseLoop(inner, innerVar, innerLower, innerUpper) || innerVar == outerVar){
+        return false;
+    }
+    lower[outerVar] = outerLower;
+    upper[outerVar] = outerUpper;
+    lower[innerVar] = innerLower;
+    upper[innerVar] = innerUpper;
+
+    body = inner->get_loop_body();
+    if(isSgBasicBlock(body) && isSgBasicBlock(body)->get_statements().size() == 1){
+        body = isSgBasicBlock(body)->get_statements()[0];
+    }
+    SgExprStatement* statement = isSgExprStatement(body);
+    SgPlusAssignOp* plusAssign = statement ? isSgPlusAssignOp(statement->get_expression()) : NULL;
+    if(!plusAssign){
+        return false;
+    }
+
+    SgVarRefExp* acc = isSgVarRefExp(plusAssign->get_lhs_operand());
+    if(!acc){
+        return false;
+    }
+    SgType* accType = acc->get_type()->stripTypedefsAndModifiers();
+    if(!isSgTypeFloat(accType)){
+        return false;
+    }
+
+    SgMultiplyOp* product = isSgMultiplyOp(stripCasts(plusAssign->get_rhs_operand()));
+    if(!product){
+        return false;
+    }
+
+    SgPntrArrRefExp* a = isSgPntrArrRefExp(stripCasts(product->get_lhs_operand()));
+    SgPntrArrRefExp* b = isSgPntrArrRefExp(stripCasts(product->get_rhs_operand()));
+    SgPntrArrRefExp* aMiddle = a ? isSgPntrArrRefExp(a->get_lhs_operand()) : NULL;
+    SgPntrArrRefExp* bMiddle = b ? isSgPntrArrRefExp(b->get_lhs_operand()) : NULL;
+    if(!aMiddle || !bMiddle || !isSgVarRefExp(aMiddle->get_lhs_operand()) || !isSgVarRefExp(bMiddle->get_lhs_operand())){
+        return false;
+    }
+
+    SgInitializedName* aArray = isSgVarRefExp(aMiddle->get_lhs_operand())->get_symbol()->get_declaration();
+    SgInitializedName* bArray = isSgVarRefExp(bMiddle->get_lhs_operand())->get_symbol()->get_declaration();
+    SgPntrArrRefExp* weightRef;
+    if(AstUtil::isImageType(aArray->get_type()) && !AstUtil::isImageType(bArray->get_type())){
+        imageRef = a;
+        weightRef = b;
+        weights = bArray;
+    }
+    else if(AstUtil::isImageType(bArray->get_type()) && !AstUtil::isImageType(aArray->get_type())){
+        imageRef = b;
+        weightRef = a;
+        weights = aArray;
+    }
+    else{
+        return false;
+    }
+    source = AstUtil::getArrayName(imageRef);
+
+    map<string, int> xCoefficients;
+    map<string, int> yCoefficients;
+    xOffset = 0;
+    yOffset = 0;
+    SgExpression* x = isSgPntrArrRefExp(imageRef->get_lhs_operand())->get_rhs_operand();
+    SgExpression* y = imageRef->get_rhs_operand();
+    if(!parseOffset(x, 1, xCoefficients, xOffset) || !parseOffset(y, 1, yCoefficients, yOffset)){
+        return false;
+    }
+
+    xVar = "";
+    yVar = "";
+    for(string var : {outerVar, innerVar}){
+        if(xCoefficients.size() == 2 && xCoefficients.count("idx") == 1 && xCoefficients["idx"] == 1 && xCoefficients.count(var) == 1 && xCoefficients[var] == 1){
+            xVar = var;
+        }
+        if(yCoefficients.size() == 2 && yCoefficients.count("idy") == 1 && yCoefficients["idy"] == 1 && yCoefficients.count(var) == 1 && yCoefficients[var] == 1){
+            yVar = var;
+        }
+    }
+    if(xVar.empty() || yVar.empty() || xVar == yVar){
+        return false;
+    }
+
+    SgExpression* weightIndices[2] = {isSgPntrArrRefExp(weightRef->get_lhs_operand())->get_rhs_operand(), weightRef->get_rhs_operand()};
+    for(int d = 0; d < 2; d++){
+        map<string, int> coefficients;
+        weightOffset[d] = 0;
+        if(!parseOffset(weightIndices[d], 1, coefficients, weightOffset[d]) || coefficients.size() != 1){
+            return false;
+        }
+        weightVar[d] = coefficients.begin()->first;
+        if(coefficients.begin()->second != 1 || (weightVar[d] != xVar && weightVar[d] != yVar)){
+            return false;
+        }
+    }
+    if(weightVar[0] == weightVar[1]){
+        return false;
+    }
+
+    outerLoop = outer;
+    innerLoop = inner;
+    accumulation = plusAssign;
+
+    return true;
+}
+
+
+// Loops with constant bounds and a step of 1. The upper bound is inclusive.
+bool SeparableSplitter::parseLoop(SgForStatement *loop, string &var, int &lower, int &upper)
+{
+    SgInitializedName* ivar = NULL;
+    SgExpression *lb = NULL;
+    SgExpression *ub = NULL;
+    SgExpression *step = NULL;
+    bool isIncremental, isInclusiveUpperBound;
+    SgStatement* lbody = NULL;
+    if(!isCanonicalForLoop(loop, &ivar, &lb, &ub, &step, &lbody, &isIncremental, &isInclusiveUpperBound)){
+        return false;
+    }
+
+    double lbValue, ubValue, stepValue;
+    if(!evaluate(lb, lbValue) || !evaluate(ub, ubValue) || !evaluate(step, stepValue) || !isIncremental || stepValue != 1){
+        return false;
+    }
+
+    var = ivar->get_name().getString();
+    lower = (int)lbValue;
+    upper = isInclusiveUpperBound ? (int)ubValue : (int)ubValue - 1;
+
+    return upper >= lower;
+}
+
+
+// Sums of variables and integer constants, as the coefficient of each variable and the constant
+bool SeparableSplitter::parseOffset(SgExpression *e, int sign, map<string, int> &coefficients, int &constant)
+{
+    e = stripCasts(e);
+
+    if(isSgAddOp(e)){
+        return parseOffset(isSgAddOp(e)->get_lhs_operand(), sign, coefficients, constant) && parseOffset(isSgAddOp(e)->get_rhs_operand(), sign, coefficients, constant);
+    }
+    if(isSgSubtractOp(e)){
+        return parseOffset(isSgSubtractOp(e)->get_lhs_operand(), sign, coefficients, constant) && parseOffset(isSgSubtractOp(e)->get_rhs_operand(), -sign, coefficients, constant);
+    }
+    if(isSgMinusOp(e)){
+        return parseOffset(isSgMinusOp(e)->get_operand(), -sign, coefficients, constant);
+    }
+    if(isSgIntVal(e)){
+        constant += sign * isSgIntVal(e)->get_value();
+        return true;
+    }
+    if(isSgVarRefExp(e)){
+        string name = isSgVarRefExp(e)->get_symbol()->get_name().getString();
+        coefficients[name] += sign;
+        varRefs[name] = isSgVarRefExp(e);
+        return true;
+    }
+
+    return false;
+}
+
+
+// Arithmetic on literals, with integer division for integer operands, as in C
+bool SeparableSplitter::evaluate(SgExpression *e, double &value)
+{
+    e = stripCasts(e);
+
+    if(isSgIntVal(e)){
+        value = isSgIntVal(e)->get_value();
+        return true;
+    }
+    if(isSgFloatVal(e)){
+        value = isSgFloatVal(e)->get_value();
+        return true;
+    }
+    if(isSgDoubleVal(e)){
+        value = isSgDoubleVal(e)->get_value();
+        return true;
+    }
+    if(isSgMinusOp(e)){
+        bool ok = evaluate(isSgMinusOp(e)->get_operand(), value);
+        value = -value;
+        return ok;
+    }
+    if(isSgUnaryAddOp(e)){
+        return evaluate(isSgUnaryAddOp(e)->get_operand(), value);
+    }
+
+    SgBinaryOp* binaryOp = isSgBinaryOp(e);
+    if(!binaryOp){
+        return false;
+    }
+
+    double lhs, rhs;
+    if(!evaluate(binaryOp->get_lhs_operand(), lhs) || !evaluate(binaryOp->get_rhs_operand(), rhs)){
+        return false;
+    }
+
+    if(isSgAddOp(e)){
+        value = lhs + rhs;
+    }
+    else if(isSgSubtractOp(e)){
+        value = lhs - rhs;
+    }
+    else if(isSgMultiplyOp(e)){
+        value = lhs * rhs;
+    }
+    else if(isSgDivideOp(e) && rhs != 0){
+        value = isStrictIntegerType(e->get_type()) ? (double)((long)lhs / (long)rhs) : lhs / rhs;
+    }
+    else{
+        return false;
+    }
+
+    return true;
+}
+
+
+// The weights must be a two dimensional array, with an initializer of literals, which is
+// never written. Missing elements of a row are zero.
+bool SeparableSplitter::readWeights(vector<vector<double>> &values)
+{
+    SgAggregateInitializer* initializer = isSgAggregateInitializer(weights->get_initializer());
+    if(!initializer || isWritten(weights)){
+        return false;
+    }
+
+    for(SgExpression* row : initializer->get_initializers()->get_expressions()){
+        SgAggregateInitializer* rowInitializer = isSgAggregateInitializer(row);
+        if(!rowInitializer){
+            return false;
+        }
+
+        vector<double> rowValues;
+        for(SgExpression* element : rowInitializer->get_initializers()->get_expressions()){
+            SgAssignInitializer* assignInitializer = isSgAssignInitializer(element);
+            double value;
+            if(!evaluate(assignInitializer ? assignInitializer->get_operand() : element, value)){
+                return false;
+            }
+            rowValues.push_back(value);
+        }
+        values.push_back(rowValues);
+    }
+
+    return true;
+}
+
+
+bool SeparableSplitter::isWritten(SgInitializedName *declaration)
+{
+    Rose_STL_Container<SgNode*> varRefNodes = AstIndex::getInstance()->query(project, V_SgVarRefExp);
+    for(SgNode* n : varRefNodes){
+        SgVarRefExp* varRef = isSgVarRefExp(n);
+        if(varRef->get_symbol()->get_declaration() != declaration){
+            continue;
+        }
+
+        SgNode* top = varRef;
+        while(isSgPntrArrRefExp(top->get_parent()) && isSgPntrArrRefExp(top->get_parent())->get_lhs_operand() == top){
+            top = top->get_parent();
+        }
+
+        SgNode* parent = top->get_parent();
+        SgBinaryOp* parentOp = isSgBinaryOp(parent);
+        if(parentOp && (isSgAssignOp(parentOp) || isSgCompoundAssignOp(parentOp)) && parentOp->get_lhs_operand() == top){
+            return true;
+        }
+        if(isSgPlusPlusOp(parent) || isSgMinusMinusOp(parent) || isSgAddressOfOp(parent) || (top == varRef && isSgExprListExp(parent))){
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+// The weights used by the loops, e[x][y], are separable if e[x][y] = row[x] * column[y].
+// With the largest weight at (px, py), row[x] = e[x][py] and column[y] = e[px][y] / e[px][py].
+bool SeparableSplitter::factorize(vector<vector<double>> values)
+{
+    int nx = upper[xVar] - lower[xVar] + 1;
+    int ny = upper[yVar] - lower[yVar] + 1;
+    if(nx < 2 || ny < 2){
+        return false;
+    }
+
+    vector<vector<double>> e(nx, vector<double>(ny));
+    double largest = 0;
+    int px = 0;
+    int py = 0;
+    for(int x = 0; x < nx; x++){
+        for(int y = 0; y < ny; y++){
+            int position[2];
+            for(int d = 0; d < 2; d++){
+                position[d] = (weightVar[d] == xVar ? lower[xVar] + x : lower[yVar] + y) + weightOffset[d];
+            }
+            if(position[0] < 0 || position[0] >= values.size() || position[1] < 0){
+                return false;
+            }
+
+            e[x][y] = position[1] < values[position[0]].size() ? values[position[0]][position[1]] : 0;
+            if(fabs(e[x][y]) > largest){
+                largest = fabs(e[x][y]);
+                px = x;
+                py = y;
+            }
+        }
+    }
+    if(largest == 0){
+        return false;
+    }
+
+    rowWeights.clear();
+    columnWeights.clear();
+    for(int x = 0; x < nx; x++){
+        rowWeights.push_back(e[x][py]);
+    }
+    for(int y = 0; y < ny; y++){
+        columnWeights.push_back(e[px][y] / e[px][py]);
+    }
+
+    for(int x = 0; x < nx; x++){
+        for(int y = 0; y < ny; y++){
+            if(fabs(e[x][y] - rowWeights[x] * columnWeights[y]) > 1e-6 * largest){
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+// The intermediate image holds the sums of the row pass, and must have float pixels. Its type
+// is taken from the source image, or from another image argument, if it has float pixels.
+SgType* SeparableSplitter::findIntermediateType(SgFunctionDeclaration *kernel)
+{
+    SgType* type = NULL;
+    for(SgInitializedName* argument : kernel->get_args()){
+        if(!AstUtil::isImageType(argument->get_type()) || Argument::convertType(argument->get_type(), settings).baseType != FLOAT){
+            continue;
+        }
+        if(type == NULL || argument->get_name().getString() == source){
+            type = argument->get_type();
+        }
+    }
+
+    return type;
+}
+
+
+// The row kernel is added after all the kernels, and is given lines after all the other
+// kernels and pragmas, so that only the pragmas built for it apply to it
+void SeparableSplitter::split(SgFunctionDeclaration *kernel, SeparableFilter &filter, SgType *intermediateType, int previousKernelEnd)
+{
+    SgFunctionDeclaration* rowsKernel = buildRowsKernel(kernel, filter, intermediateType);
+    buildColumnPass(kernel, filter, intermediateType);
+
+    bool sourceRemoved = false;
+    Rose_STL_Container<SgNode*> varRefNodes = NodeQuery::querySubTree(kernel->get_definition(), V_SgVarRefExp);
+    if(none_of(varRefNodes.begin(), varRefNodes.end(), [&] (SgNode* n) -> bool {return isSgVarRefExp(n)->get_symbol()->get_name().getString() == filter.source;})){
+        SgInitializedNamePtrList& args = kernel->get_parameterList()->get_args();
+        args.erase(remove_if(args.begin(), args.end(), [&] (SgInitializedName* arg) -> bool {return arg->get_name().getString() == filter.source;}), args.end());
+        sourceRemoved = true;
+    }
+
+    SgVariableDeclaration* weightsDeclaration = isSgVariableDeclaration(weights->get_declaration());
+    bool weightsUsed = any_of(varRefNodes.begin(), varRefNodes.end(), [&] (SgNode* n) -> bool {return isSgVarRefExp(n)->get_symbol()->get_declaration() == weights;});
+    if(weightsDeclaration && isAncestor(kernel->get_definition(), weightsDeclaration) && !weightsUsed){
+        removeStatement(weightsDeclaration);
+    }
+
+    for(string pragmaString : rewritePragmas(kernel, filter, sourceRemoved, previousKernelEnd)){
+        SgPragmaDeclaration* pragmaDecl = buildPragmaDeclaration(pragmaString, getGlobalScope(kernel));
+        insertStatementBefore(rowsKernel, pragmaDecl);
+        pragmaDecl->get_file_info()->set_line(nextLine);
+    }
+    rowsKernel->get_startOfConstruct()->set_line(nextLine + 1);
+    rowsKernel->get_endOfConstruct()->set_line(nextLine + 1);
+    nextLine += 2;
+}
+
+
+// void <kernel>_rows(Image<T> source, Image<float> intermediate){
+//     float <w>_rows[n] = {...};
+//     float sum = 0;
+//     for(int x = lower; x <= upper; x++){
+//         sum += <w>_rows[x - lower] * source[idx + x + xOffset][idy];
+//     }
+//     intermediate[idx][idy] = sum;
+// }
+SgFunctionDeclaration* SeparableSplitter::buildRowsKernel(SgFunctionDeclaration *kernel, SeparableFilter &filter, SgType *intermediateType)
+{
+    SgType* sourceType = NULL;
+    for(SgInitializedName* argument : kernel->get_args()){
+        if(argument->get_name().getString() == filter.source){
+            sourceType = argument->get_type();
+        }
+    }
+
+    SgGlobal* global = getGlobalScope(kernel);
+    SgFunctionParameterList* parameters = buildFunctionParameterList();
+    appendArg(parameters, buildInitializedName(filter.source, sourceType));
+    appendArg(parameters, buildInitializedName(filter.intermediate, intermediateType));
+    SgFunctionDeclaration* rowsKernel = buildDefiningFunctionDeclaration(filter.rowsKernel, buildVoidType(), parameters, global);
+    appendStatement(rowsKernel, global);
+
+    SgBasicBlock* body = rowsKernel->get_definition()->get_body();
+    string weightName = weights->get_name().getString() + "_rows";
+    appendStatement(buildWeightDeclaration(weightName, rowWeights, body), body);
+    appendStatement(buildVariableDeclaration("sum", buildFloatType(), buildAssignInitializer(buildFloatVal(0)), body), body);
+
+    SgVariableDeclaration* init = buildVariableDeclaration(xVar, buildIntType(), buildAssignInitializer(buildIntVal(lower[xVar])), body);
+    SgExprStatement* test = buildExprStatement(buildLessOrEqualOp(buildVarRefExp(xVar, body), buildIntVal(upper[xVar])));
+    SgExpression* inc = buildPlusPlusOp(buildVarRefExp(xVar, body), SgUnaryOp::postfix);
+
+    SgExpression* weight = buildPntrArrRefExp(buildVarRefExp(weightName, body), addOffset(buildVarRefExp(xVar, body), -lower[xVar]));
+    SgExpression* x = addOffset(buildAddOp(buildVarRefExp("idx", body), buildVarRefExp(xVar, body)), xOffset);
+    SgExpression* pixel = buildPntrArrRefExp(buildPntrArrRefExp(buildVarRefExp(filter.source, body), x), buildVarRefExp("idy", body));
+    SgBasicBlock* loopBody = buildBasicBlock(buildExprStatement(buildPlusAssignOp(buildVarRefExp("sum", body), buildMultiplyOp(weight, pixel))));
+    appendStatement(buildForStatement(init, test, inc, loopBody), body);
+
+    SgExpression* output = buildPntrArrRefExp(buildPntrArrRefExp(buildVarRefExp(filter.intermediate, body), buildVarRefExp("idx", body)), buildVarRefExp("idy", body));
+    appendStatement(buildAssignStatement(output, buildVarRefExp("sum", body)), body);
+
+    return rowsKernel;
+}
+
+
+// The loop nest is replaced by the loop over y, with the body
+// acc += <w>_cols[y - lower] * intermediate[idx][idy + y + yOffset]
+void SeparableSplitter::buildColumnPass(SgFunctionDeclaration *kernel, SeparableFilter &filter, SgType *intermediateType)
+{
+    SgFunctionDefinition* definition = kernel->get_definition();
+    SgInitializedName* intermediateArg = buildInitializedName(filter.intermediate, intermediateType);
+    kernel->append_arg(intermediateArg);
+    intermediateArg->set_scope(definition);
+    definition->insert_symbol(SgName(filter.intermediate), new SgVariableSymbol(intermediateArg));
+
+    SgBasicBlock* scope = isSgBasicBlock(outerLoop->get_parent());
+    string weightName = weights->get_name().getString() + "_cols";
+    insertStatementBefore(outerLoop, buildWeightDeclaration(weightName, columnWeights, scope));
+
+    SgExpression* weight = buildPntrArrRefExp(buildVarRefExp(weightName, scope), addOffset(copyExpression(varRefs[yVar]), -lower[yVar]));
+    SgExpression* y = addOffset(buildAddOp(copyExpression(varRefs["idy"]), copyExpression(varRefs[yVar])), yOffset);
+    SgExpression* pixel = buildPntrArrRefExp(buildPntrArrRefExp(buildVarRefExp(filter.intermediate, scope), copyExpression(varRefs["idx"])), y);
+    SgExprStatement* columnAccumulation = buildExprStatement(buildPlusAssignOp(copyExpression(accumulation->get_lhs_operand()), buildMultiplyOp(weight, pixel)));
+
+    if(yVar == outerVar){
+        setLoopBody(outerLoop, buildBasicBlock(columnAccumulation));
+    }
+    else{
+        setLoopBody(innerLoop, buildBasicBlock(columnAccumulation));
+        setLoopBody(outerLoop, buildBasicBlock());
+        replaceStatement(outerLoop, innerLoop);
+    }
+}
+
+
+// Pragmas of the kernel naming the source image are rewritten for the intermediate image,
+// which has the boundary condition of the source. Returns the pragmas of the row kernel,
+// whose grid is the intermediate image, and which keeps the pragmas for the source image.
+vector<string> SeparableSplitter::rewritePragmas(SgFunctionDeclaration *kernel, SeparableFilter &filter, bool sourceRemoved, int previousKernelEnd)
+{
+    vector<string> rowsPragmas = {"clite grid(" + filter.intermediate + ")"};
+
+    Rose_STL_Container<SgNode*> pragmaNodes = AstIndex::getInstance()->query(project, V_SgPragmaDeclaration);
+    for(SgNode* n : pragmaNodes){
+        SgPragmaDeclaration* pragmaDecl = isSgPragmaDeclaration(n);
+        int line = pragmaDecl->get_file_info()->get_line();
+        string pragmaString = pragmaDecl->get_pragma()->get_pragma();
+        if(line <= previousKernelEnd || line > kernel->get_endOfConstruct()->get_line() || pragmaString.find("clite") >= pragmaString.size()){
+            continue;
+        }
+
+        Pragma p(pragmaString);
+        string prefix = pragmaString.substr(0, pragmaString.find("("));
+        vector<string> items;
+        bool changed = false;
+
+        if(p.option == PIXEL || p.option == BOUNDARY_COND){
+            for(pair<string,string> ps : p.pairValues){
+                if(ps.first != filter.source){
+                    items.push_back(ps.first + ":" + ps.second);
+                    continue;
+                }
+
+                changed = true;
+                rowsPragmas.push_back(prefix + "(" + ps.first + ":" + ps.second + ")");
+                if(!sourceRemoved){
+                    items.push_back(ps.first + ":" + ps.second);
+                }
+                if(p.option == BOUNDARY_COND){
+                    items.push_back(filter.intermediate + ":" + ps.second);
+                }
+            }
+        }
+        else if(p.option == GRID || p.option == IMAGE_MEM || p.option == LOCAL_MEM){
+            for(string v : p.values){
+                if(v != filter.source){
+                    items.push_back(v);
+                    continue;
+                }
+
+                changed = true;
+                if(p.option != GRID){
+                    rowsPragmas.push_back(prefix + "(" + v + ")");
+                }
+                items.push_back(sourceRemoved ? filter.intermediate : v);
+            }
+        }
+
+        if(!changed){
+            continue;
+        }
+
+        if(items.empty()){
+            removeStatement(pragmaDecl);
+            continue;
+        }
+
+        string newPragma = prefix + "(";
+        for(int i = 0; i < items.size(); i++){
+            newPragma += (i > 0 ? ", " : "") + items[i];
+        }
+        newPragma += ")";
+
+        pragmaDecl->get_pragma()->set_pragma(newPragma);
+    }
+
+    return rowsPragmas;
+}
+
+
+SgVariableDeclaration* SeparableSplitter::buildWeightDeclaration(string name, vector<double> weights, SgScopeStatement *scope)
+{
+    vector<SgExpression*> values;
+    for(double w : weights){
+        ostringstream text;
+        text << setprecision(9) << w;
+        string valueString = text.str();
+        if(valueString.find_first_of(".e") == string::npos){
+            valueString += ".0";
+        }
+
+        SgFloatVal* value = buildFloatVal(w);
+        value->set_valueString(valueString + "f");
+        values.push_back(value);
+    }
+
+    SgType* type = buildArrayType(buildFloatType(), buildIntVal(weights.size()));
+    return buildVariableDeclaration(name, type, buildAggregateInitializer(buildExprListExp(values), type), scope);
+}
+
+
+SgExpression* SeparableSplitter::addOffset(SgExpression *e, int offset)
+{
+    if(offset > 0){
+        return buildAddOp(e, buildIntVal(offset));
+    }
+    if(offset < 0){
+        return buildSubtractOp(e, buildIntVal(-offset));
+    }
+    return e;
+}
+
+
+SgExpression* SeparableSplitter::stripCasts(SgExpression *e)
+{
+    while(isSgCastExp(e)){
+        e = isSgCastExp(e)->get_operand();
+    }
+    return e;
+}
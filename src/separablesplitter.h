@@ -0,0 +1,100 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef SEPARABLESPLITTER_H
+#define SEPARABLESPLITTER_H
+
+#include "rose.h"
+
+#include "settings.h"
+
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+// A kernel split in two passes. The row pass, rowsKernel, convolves the rows of source and
+// writes intermediate, which the column pass, the kernel itself, convolves instead of source.
+class SeparableFilter
+{
+public:
+    string kernel;
+    string rowsKernel;
+    string source;
+    string intermediate;
+
+    // Image arguments of the kernel before it was split, in order
+    vector<string> imageArguments;
+};
+
+// Finds kernels convolving an image with a constant, separable weight matrix, in loops like
+//
+//     for(int i = -R; i <= R; i++)
+//         for(int j = -R; j <= R; j++)
+//             sum += w[i+R][j+R] * input[idx+i][idy+j];
+//
+// where w is an array with a literal initializer, whose matrix is the outer product of a
+// row vector and a column vector. Such a kernel is split in two kernels, a row pass doing
+// the K multiply-adds over x, and a column pass doing the K multiply-adds over y, instead
+// of the K*K of the original kernel.
+class SeparableSplitter
+{
+public:
+    SeparableSplitter(SgProject* project, Settings settings);
+
+    vector<SeparableFilter> splitFilters();
+
+private:
+    bool findConvolution(SgFunctionDeclaration* kernel);
+    bool matchLoopNest(SgForStatement* outer);
+    bool parseLoop(SgForStatement* loop, string& var, int& lower, int& upper);
+    bool parseOffset(SgExpression* e, int sign, map<string, int>& coefficients, int& constant);
+    bool evaluate(SgExpression* e, double& value);
+    bool readWeights(vector<vector<double>>& values);
+    bool isWritten(SgInitializedName* declaration);
+    bool factorize(vector<vector<double>> values);
+    SgType* findIntermediateType(SgFunctionDeclaration* kernel);
+    void split(SgFunctionDeclaration* kernel, SeparableFilter& filter, SgType* intermediateType, int previousKernelEnd);
+    SgFunctionDeclaration* buildRowsKernel(SgFunctionDeclaration* kernel, SeparableFilter& filter, SgType* intermediateType);
+    void buildColumnPass(SgFunctionDeclaration* kernel, SeparableFilter& filter, SgType* intermediateType);
+    vector<string> rewritePragmas(SgFunctionDeclaration* kernel, SeparableFilter& filter, bool sourceRemoved, int previousKernelEnd);
+    SgVariableDeclaration* buildWeightDeclaration(string name, vector<double> weights, SgScopeStatement* scope);
+    SgExpression* addOffset(SgExpression* e, int offset);
+    SgExpression* stripCasts(SgExpression* e);
+
+    SgProject* project;
+    Settings settings;
+
+    // Lines given to the row kernels and their pragmas, which come after all the kernels in
+    // the file, so that KernelInfo assigns the pragmas to them
+    int nextLine;
+
+    // The convolution found by findConvolution
+    SgForStatement* outerLoop;
+    SgForStatement* innerLoop;
+    SgPlusAssignOp* accumulation;
+    SgPntrArrRefExp* imageRef;
+    SgInitializedName* weights;
+    string source;
+    string outerVar;
+    string xVar;
+    string yVar;
+    map<string, int> lower;
+    map<string, int> upper;
+    map<string, SgVarRefExp*> varRefs;
+    int xOffset;
+    int yOffset;
+    // Index of each dimension of the weights, as the loop variable and an offset
+    string weightVar[2];
+    int weightOffset[2];
+
+    vector<double> rowWeights;
+    vector<double> columnWeights;
+};
+
+#endif // SEPARABLESPLITTER_H
@@ -58,6 +58,64 @@ void Settings::readSettingsFromFile(string fileName)
         if(property.compare("PLATFORM_ID") == 0)
             platformId = stoi(value);
 
+        if(property.compare("SERVER_SOCKET") == 0)
+            serverSocket = value;
+
+        if(property.compare("TUNING_WIDTH") == 0)
+            tuningWidth = stoi(value);
+
+        if(property.compare("TUNING_HEIGHT") == 0)
+            tuningHeight = stoi(value);
+
+        if(property.compare("TUNING_STRATEGY") == 0){
+            if(value.compare("exhaustive") == 0){
+                tuningStrategy = EXHAUSTIVE;
+            }
+            if(value.compare("random") == 0){
+                tuningStrategy = RANDOM;
+            }
+            if(value.compare("model") == 0){
+                tuningStrategy = MODEL;
+            }
+        }
+
+        if(property.compare("TUNING_SAMPLES") == 0)
+            tuningSamples = stoi(value);
+
+        if(property.compare("TUNING_DB") == 0)
+            tuningDatabase = value;
+
+        if(property.compare("USE_TUNING_DB") == 0)
+            useTuningDatabase = stoi(value) != 0;
+
+        if(property.compare("TUNING_TRANSFER") == 0)
+            tuningTransferKernels = stoi(value);
+
+        if(property.compare("USE_OUTPUT_CACHE") == 0)
+            useOutputCache = stoi(value) != 0;
+
+        if(property.compare("CACHE_DIR") == 0)
+            cacheDirectory = value;
+
+        if(property.compare("TUNING_TIME_BUDGET") == 0)
+            tuningTimeBudget = stoi(value);
+
+        if(property.compare("TUNING_PATIENCE") == 0)
+            tuningPatience = stoi(value);
+
+        if(property.compare("TUNING_MIN_IMPROVEMENT") == 0)
+            tuningMinImprovement = stod(value);
+
+        if(property.compare("SPLIT_SEPARABLE") == 0)
+            splitSeparable = stoi(value) != 0;
+
+        if(property.compare("N_WORKERS") == 0){
+            nWorkers = stoi(value);
+            if(nWorkers < 0){
+                nWorkers = 0;
+            }
+        }
+
 
         if(property.compare("N_LAUNCHES") == 0){
             nLaunchesForTiming = stoi(value);
@@ -102,6 +160,8 @@ void Settings::printSettings()
     cout << "N_LAUNCHES: " << nLaunchesForTiming << endl;
     cout << "PLATFORM_ID: " << platformId << endl;
     cout << "DEVICE_ID: " << deviceId << endl;
+    cout << "N_WORKERS: " << nWorkers << endl;
+    cout << "SERVER_SOCKET: " << serverSocket << endl;
     cout << "BOUNDARY_CONDITION: ";
     if(boundaryCondition == CLAMPED){
         cout << "CLAMPED";
@@ -110,6 +170,29 @@ void Settings::printSettings()
         cout << "CONSTANT";
     }
     cout << endl;
+    cout << "TUNING_WIDTH: " << tuningWidth << endl;
+    cout << "TUNING_HEIGHT: " << tuningHeight << endl;
+    cout << "TUNING_STRATEGY: ";
+    if(tuningStrategy == EXHAUSTIVE){
+        cout << "EXHAUSTIVE";
+    }
+    else if(tuningStrategy == RANDOM){
+        cout << "RANDOM";
+    }
+    else if(tuningStrategy == MODEL){
+        cout << "MODEL";
+    }
+    cout << endl;
+    cout << "TUNING_SAMPLES: " << tuningSamples << endl;
+    cout << "TUNING_TIME_BUDGET: " << tuningTimeBudget << endl;
+    cout << "TUNING_PATIENCE: " << tuningPatience << endl;
+    cout << "TUNING_MIN_IMPROVEMENT: " << tuningMinImprovement << endl;
+    cout << "TUNING_DB: " << tuningDatabase << endl;
+    cout << "USE_TUNING_DB: " << useTuningDatabase << endl;
+    cout << "TUNING_TRANSFER: " << tuningTransferKernels << endl;
+    cout << "USE_OUTPUT_CACHE: " << useOutputCache << endl;
+    cout << "CACHE_DIR: " << cacheDirectory << endl;
+    cout << "SPLIT_SEPARABLE: " << splitSeparable << endl;
     cout << "DEFAULT_PIXEL_TYPE: " << Type::baseTypeToString(defaultPixelType) << endl;
     cout << "INPUT BASE NAME: " << inputBaseName << endl;
     cout << "GENERATE C: " << generateC << endl;
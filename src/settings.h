@@ -15,6 +15,7 @@
 using namespace std;
 
 enum BoundaryCondition {CONSTANT,CLAMPED};
+enum TuningStrategy {EXHAUSTIVE,RANDOM,MODEL};
 
 class Settings
 {
@@ -37,6 +38,40 @@ public:
     int deviceId = 0;
     int platformId = 0;
 
+    // Number of worker processes for batch generation, 0 means one per core
+    int nWorkers = 0;
+
+    // Unix domain socket used in server mode, stdin/stdout is used if empty
+    string serverSocket;
+
+    // Image size and search used by the autotuner
+    int tuningWidth = 1024;
+    int tuningHeight = 1024;
+    TuningStrategy tuningStrategy = RANDOM;
+    int tuningSamples = 100;
+
+    // Stopping rules for the autotuner. The time budget is in seconds, 0 means no limit.
+    // The model based search stops after TUNING_PATIENCE measurements without an
+    // improvement of at least TUNING_MIN_IMPROVEMENT percent.
+    int tuningTimeBudget = 0;
+    int tuningPatience = 50;
+    double tuningMinImprovement = 1.0;
+
+    // All tuning measurements are recorded in the tuning database. If USE_TUNING_DB is set,
+    // the best known configuration for TUNING_WIDTH x TUNING_HEIGHT replaces config.txt.
+    string tuningDatabase = "tuning_db.txt";
+    bool useTuningDatabase = false;
+
+    // Number of similar kernels from the tuning database whose best configurations are measured first
+    int tuningTransferKernels = 3;
+
+    // Generated files are cached in CACHE_DIR if USE_OUTPUT_CACHE is set
+    bool useOutputCache = false;
+    string cacheDirectory = ".imcl_cache";
+
+    // Kernels convolving an image with separable weights are split into two passes
+    bool splitSeparable = false;
+
     string inputBaseName;
 
     bool generateC = false;
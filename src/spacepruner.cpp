@@ -0,0 +1,198 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "spacepruner.h"
+#include "footprintfinder.h"
+#include "localmemtransformer.h"
+#include "temporalblocker.h"
+#include "type.h"
+#include "clutil/clutil.h"
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+SpacePruner::SpacePruner(KernelInfo kernelInfo, Settings settings, cl_device_id device) : kernelInfo(kernelInfo), settings(settings), device(device)
+{
+    cl_int error = clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &localMemSize, NULL);
+    if(error == CL_SUCCESS){
+        error = clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &maxWorkGroupSize, NULL);
+    }
+
+    // The sizes are given for every dimension of the device, which may be more than 3
+    cl_uint nDimensions = 0;
+    if(error == CL_SUCCESS){
+        error = clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS, sizeof(cl_uint), &nDimensions, NULL);
+    }
+    if(error == CL_SUCCESS){
+        maxWorkItemSizes.resize(nDimensions);
+        error = clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, nDimensions * sizeof(size_t), maxWorkItemSizes.data(), NULL);
+    }
+
+    if(error != CL_SUCCESS){
+        cerr << "ERROR: Could not query the work-group limits of the device: " << clErrorStr(error) << ". Exiting..." << endl;
+        exit(-1);
+    }
+    if(nDimensions < 2){
+        cerr << "ERROR: The device does not support two dimensional work-groups. Exiting..." << endl;
+        exit(-1);
+    }
+
+    nRejectedWorkGroup = 0;
+    nRejectedLocalMemory = 0;
+    nRejectedImage = 0;
+    nRejectedTemporalSteps = 0;
+}
+
+
+bool SpacePruner::exceedsWorkGroupLimits(Parameters params)
+{
+    size_t localWorkSize[2];
+    size_t globalWorkSize[2];
+    params.getWorkSizes(settings.tuningWidth, settings.tuningHeight, localWorkSize, globalWorkSize);
+
+    return invalid_work_group_size_static(device, 2, localWorkSize, globalWorkSize);
+}
+
+
+// Same buffer size as LocalMemTransformer::insertSharedMemLoading, which stores int
+// images as int, and everything else as float
+long long SpacePruner::getLocalMemoryUsage(Parameters params)
+{
+    long long usage = 0;
+
+    for(string localArray : *(params.localMemArrays)){
+        HaloSize haloSize = kernelInfo.getHaloSize(localArray);
+
+        BaseType bufferType = kernelInfo.getPixelType(localArray) == INT ? INT : FLOAT;
+        usage += LocalMemTransformer::getBufferSize(params, haloSize) * Type::getBaseTypeSize(bufferType);
+    }
+
+    usage += TemporalBlocker::getLocalMemoryUsage(kernelInfo, params, settings);
+
+    return usage;
+}
+
+
+bool SpacePruner::exceedsLocalMemory(Parameters params)
+{
+    return getLocalMemoryUsage(params) > localMemSize;
+}
+
+
+// A work-group covering more than twice the image has more than half its work-items idle,
+// and does the same work as the configuration with half the coarsening
+bool SpacePruner::exceedsImage(Parameters params)
+{
+    if(params.elementsPerThreadX > settings.tuningWidth || params.elementsPerThreadY > settings.tuningHeight){
+        return true;
+    }
+
+    long long pixelsPerGroupX = params.localSizeX * params.elementsPerThreadX;
+    long long pixelsPerGroupY = params.localSizeY * params.elementsPerThreadY;
+
+    bool coarsenedX = params.elementsPerThreadX > 1 && pixelsPerGroupX >= 2 * settings.tuningWidth;
+    bool coarsenedY = params.elementsPerThreadY > 1 && pixelsPerGroupY >= 2 * settings.tuningHeight;
+
+    return coarsenedX || coarsenedY;
+}
+
+
+// A configuration where TemporalBlocker can not be used is the same as the one with
+// TEMPORAL_STEPS:1
+bool SpacePruner::ignoresTemporalSteps(Parameters params)
+{
+    return params.temporalSteps > 1 && !TemporalBlocker::isTemporallyBlocked(kernelInfo, params, settings);
+}
+
+
+bool SpacePruner::isValid(Parameters params)
+{
+    if(exceedsWorkGroupLimits(params)){
+        nRejectedWorkGroup++;
+        return false;
+    }
+    if(exceedsImage(params)){
+        nRejectedImage++;
+        return false;
+    }
+    if(ignoresTemporalSteps(params)){
+        nRejectedTemporalSteps++;
+        return false;
+    }
+    if(exceedsLocalMemory(params)){
+        nRejectedLocalMemory++;
+        return false;
+    }
+    return true;
+}
+
+
+// Values that are invalid whatever the other parameters are, are removed first, so
+// that the cross product that has to be checked is as small as possible
+void SpacePruner::pruneValues(ParameterSpace* space)
+{
+    for(int i = 0; i < space->getNumberOfDimensions(); i++){
+        string name = space->getName(i);
+        vector<string>* values = space->getValues(i);
+        vector<bool> remove(values->size(), false);
+
+        for(int j = 0; j < values->size(); j++){
+            if(name.compare("LOCAL_SIZE_X") == 0){
+                size_t value = stoi(values->at(j));
+                remove[j] = value > maxWorkItemSizes[0] || value > maxWorkGroupSize;
+            }
+            if(name.compare("LOCAL_SIZE_Y") == 0){
+                size_t value = stoi(values->at(j));
+                remove[j] = value > maxWorkItemSizes[1] || value > maxWorkGroupSize;
+            }
+            if(name.compare("ELEMENTS_PER_THREAD_X") == 0){
+                remove[j] = stoi(values->at(j)) > settings.tuningWidth;
+            }
+            if(name.compare("ELEMENTS_PER_THREAD_Y") == 0){
+                remove[j] = stoi(values->at(j)) > settings.tuningHeight;
+            }
+        }
+
+        space->removeValues(i, remove);
+    }
+}
+
+
+void SpacePruner::prune(ParameterSpace* space)
+{
+    pruneValues(space);
+
+    long long crossProductSize = space->getCrossProductSize();
+    if(crossProductSize > maxEnumeratedPoints){
+        cout << "[Pruner] Space too large to enumerate (" << crossProductSize << " configurations), pruning when sampled" << endl;
+        return;
+    }
+
+    vector<long long>* validPoints = new vector<long long>();
+    for(long long i = 0; i < crossProductSize; i++){
+        Parameters params = space->getConfiguration(space->getCrossProductPoint(i));
+        params.setParametersFromPragmas(kernelInfo.getPragmas());
+        if(isValid(params)){
+            validPoints->push_back(i);
+        }
+    }
+    space->setValidPoints(validPoints);
+
+    cout << "[Pruner] " << validPoints->size() << " of " << crossProductSize << " configurations are valid" << endl;
+    printStatistics();
+}
+
+
+void SpacePruner::printStatistics()
+{
+    cout << "[Pruner] Rejected for work-group size: " << nRejectedWorkGroup << endl;
+    cout << "[Pruner] Rejected for image size: " << nRejectedImage << endl;
+    cout << "[Pruner] Rejected for local memory: " << nRejectedLocalMemory << endl;
+    cout << "[Pruner] Rejected for temporal steps: " << nRejectedTemporalSteps << endl;
+}
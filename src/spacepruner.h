@@ -0,0 +1,59 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef SPACEPRUNER_H
+#define SPACEPRUNER_H
+
+#include "parameterspace.h"
+#include "parameters.h"
+#include "kernelinfo.h"
+#include "settings.h"
+
+#include <CL/cl.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Removes configurations that can not run on the device, or that are pointless for the
+// image size, before any variant is generated
+class SpacePruner
+{
+public:
+    SpacePruner(KernelInfo kernelInfo, Settings settings, cl_device_id device);
+
+    void prune(ParameterSpace* space);
+    bool isValid(Parameters params);
+    void printStatistics();
+
+private:
+    void pruneValues(ParameterSpace* space);
+    bool exceedsWorkGroupLimits(Parameters params);
+    bool exceedsLocalMemory(Parameters params);
+    bool exceedsImage(Parameters params);
+    bool ignoresTemporalSteps(Parameters params);
+    long long getLocalMemoryUsage(Parameters params);
+
+    KernelInfo kernelInfo;
+    Settings settings;
+    cl_device_id device;
+
+    cl_ulong localMemSize;
+    size_t maxWorkGroupSize;
+    vector<size_t> maxWorkItemSizes;
+
+    long long nRejectedWorkGroup;
+    long long nRejectedLocalMemory;
+    long long nRejectedImage;
+    long long nRejectedTemporalSteps;
+
+    // Larger spaces are only pruned per value, and the remaining points are checked when they are sampled
+    static const long long maxEnumeratedPoints = 1000000;
+};
+
+#endif // SPACEPRUNER_H
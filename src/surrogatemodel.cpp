@@ -0,0 +1,159 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "surrogatemodel.h"
+
+#include <algorithm>
+
+using namespace std;
+
+SurrogateModel::SurrogateModel(int nTrees, int maxDepth, double learningRate) : nTrees(nTrees), maxDepth(maxDepth), learningRate(learningRate)
+{
+    baseValue = 0;
+}
+
+
+// Each tree is fitted to the residuals of the trees before it, minimizing the squared error
+void SurrogateModel::fit(vector<vector<double>>& features, vector<double>& targets)
+{
+    trees.clear();
+    baseValue = 0;
+
+    if(targets.empty()){
+        return;
+    }
+
+    for(double target : targets){
+        baseValue += target;
+    }
+    baseValue /= targets.size();
+
+    vector<double> predictions(targets.size(), baseValue);
+    vector<int> allSamples;
+    for(int i = 0; i < targets.size(); i++){
+        allSamples.push_back(i);
+    }
+
+    for(int t = 0; t < nTrees; t++){
+        vector<double> residuals(targets.size());
+        for(int i = 0; i < targets.size(); i++){
+            residuals[i] = targets[i] - predictions[i];
+        }
+
+        vector<RegressionTreeNode> tree;
+        buildNode(tree, features, residuals, allSamples, 0);
+
+        for(int i = 0; i < targets.size(); i++){
+            predictions[i] += learningRate * predictTree(tree, features[i]);
+        }
+
+        trees.push_back(tree);
+    }
+}
+
+
+int SurrogateModel::buildNode(vector<RegressionTreeNode>& tree, vector<vector<double>>& features, vector<double>& residuals, vector<int> samples, int depth)
+{
+    int nodeIndex = tree.size();
+    tree.push_back(RegressionTreeNode());
+
+    double sum = 0;
+    for(int sample : samples){
+        sum += residuals[sample];
+    }
+
+    tree[nodeIndex].feature = -1;
+    tree[nodeIndex].value = sum / samples.size();
+
+    if(depth >= maxDepth || samples.size() < 2 * minSamplesPerLeaf){
+        return nodeIndex;
+    }
+
+    // Find the split with the largest reduction in squared error, using prefix sums
+    // over the samples sorted by each feature
+    int bestFeature = -1;
+    double bestThreshold = 0;
+    double bestScore = sum * sum / samples.size();
+
+    int nFeatures = features[samples[0]].size();
+    for(int f = 0; f < nFeatures; f++){
+        vector<int> sorted = samples;
+        sort(sorted.begin(), sorted.end(), [&](int a, int b){ return features[a][f] < features[b][f]; });
+
+        double leftSum = 0;
+        for(int i = 0; i < sorted.size() - 1; i++){
+            leftSum += residuals[sorted[i]];
+
+            double value = features[sorted[i]][f];
+            double nextValue = features[sorted[i+1]][f];
+            int nLeft = i + 1;
+            int nRight = sorted.size() - nLeft;
+
+            if(value == nextValue || nLeft < minSamplesPerLeaf || nRight < minSamplesPerLeaf){
+                continue;
+            }
+
+            double rightSum = sum - leftSum;
+            double score = leftSum * leftSum / nLeft + rightSum * rightSum / nRight;
+            if(score > bestScore){
+                bestScore = score;
+                bestFeature = f;
+                bestThreshold = (value + nextValue) / 2;
+            }
+        }
+    }
+
+    if(bestFeature < 0){
+        return nodeIndex;
+    }
+
+    vector<int> leftSamples;
+    vector<int> rightSamples;
+    for(int sample : samples){
+        if(features[sample][bestFeature] <= bestThreshold){
+            leftSamples.push_back(sample);
+        }
+        else{
+            rightSamples.push_back(sample);
+        }
+    }
+
+    int left = buildNode(tree, features, residuals, leftSamples, depth + 1);
+    int right = buildNode(tree, features, residuals, rightSamples, depth + 1);
+
+    tree[nodeIndex].feature = bestFeature;
+    tree[nodeIndex].threshold = bestThreshold;
+    tree[nodeIndex].left = left;
+    tree[nodeIndex].right = right;
+
+    return nodeIndex;
+}
+
+
+double SurrogateModel::predictTree(vector<RegressionTreeNode>& tree, vector<double>& features)
+{
+    int node = 0;
+    while(tree[node].feature >= 0){
+        if(features[tree[node].feature] <= tree[node].threshold){
+            node = tree[node].left;
+        }
+        else{
+            node = tree[node].right;
+        }
+    }
+    return tree[node].value;
+}
+
+
+double SurrogateModel::predict(vector<double>& features)
+{
+    double prediction = baseValue;
+    for(vector<RegressionTreeNode>& tree : trees){
+        prediction += learningRate * predictTree(tree, features);
+    }
+    return prediction;
+}
@@ -0,0 +1,49 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef SURROGATEMODEL_H
+#define SURROGATEMODEL_H
+
+#include <vector>
+
+using namespace std;
+
+class RegressionTreeNode
+{
+public:
+    // Leaf nodes have feature -1
+    int feature;
+    double threshold;
+    double value;
+    int left;
+    int right;
+};
+
+// Gradient boosted regression trees, used by the tuner to predict the execution time
+// of configurations that have not been measured
+class SurrogateModel
+{
+public:
+    SurrogateModel(int nTrees, int maxDepth, double learningRate);
+
+    void fit(vector<vector<double>>& features, vector<double>& targets);
+    double predict(vector<double>& features);
+
+private:
+    int buildNode(vector<RegressionTreeNode>& tree, vector<vector<double>>& features, vector<double>& residuals, vector<int> samples, int depth);
+    double predictTree(vector<RegressionTreeNode>& tree, vector<double>& features);
+
+    int nTrees;
+    int maxDepth;
+    double learningRate;
+    int minSamplesPerLeaf = 2;
+
+    double baseValue;
+    vector<vector<RegressionTreeNode>> trees;
+};
+
+#endif // SURROGATEMODEL_H
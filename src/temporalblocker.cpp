@@ -0,0 +1,346 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "temporalblocker.h"
+#include "astutil.h"
+#include "astindex.h"
+#include "type.h"
+
+#include "rose.h"
+
+using namespace SageBuilder;
+using namespace SageInterface;
+
+TemporalBlocker::TemporalBlocker(SgProject *project, Parameters params, KernelInfo kernelInfo, Settings settings, SgBasicBlock *loopBody) : project(project), params(params), kernelInfo(kernelInfo), settings(settings), loopBody(loopBody)
+{
+    source = kernelInfo.getIterationSource();
+    target = kernelInfo.getIterationTarget();
+    haloSize = kernelInfo.getHaloSize(source);
+
+    tileSizeX = params.localSizeX + params.temporalSteps * (haloSize.left + haloSize.right);
+    tileSizeY = params.localSizeY + params.temporalSteps * (haloSize.up + haloSize.down);
+}
+
+
+// The steps are computed one pixel per work-item, and the source must be read from global
+// memory by the loading loop, so coarsening, vectorization, and local or image memory for
+// the source are not combined with it
+bool TemporalBlocker::isTemporallyBlocked(KernelInfo& kernelInfo, Parameters& params, Settings& settings)
+{
+    if(params.temporalSteps <= 1 || !kernelInfo.canBlockTemporally() || settings.generateMPI || settings.generateOMP){
+        return false;
+    }
+    if(kernelInfo.getIterations() % params.temporalSteps != 0){
+        return false;
+    }
+    if(params.elementsPerThreadX != 1 || params.elementsPerThreadY != 1 || params.vectorize){
+        return false;
+    }
+
+    string source = kernelInfo.getIterationSource();
+    return params.localMemArrays->count(source) == 0 && params.imageMemArrays->count(source) == 0;
+}
+
+
+int TemporalBlocker::getStepsPerLaunch(KernelInfo& kernelInfo, Parameters& params, Settings& settings)
+{
+    return isTemporallyBlocked(kernelInfo, params, settings) ? params.temporalSteps : 1;
+}
+
+
+// The two tile buffers, of the pixel type of the source
+long long TemporalBlocker::getLocalMemoryUsage(KernelInfo& kernelInfo, Parameters& params, Settings& settings)
+{
+    if(!isTemporallyBlocked(kernelInfo, params, settings)){
+        return 0;
+    }
+
+    HaloSize hs = kernelInfo.getHaloSize(kernelInfo.getIterationSource());
+    long long tileSizeX = params.localSizeX + params.temporalSteps * (hs.left + hs.right);
+    long long tileSizeY = params.localSizeY + params.temporalSteps * (hs.up + hs.down);
+
+    return 2 * tileSizeX * tileSizeY * Type::getBaseTypeSize(kernelInfo.getPixelType(kernelInfo.getIterationSource()));
+}
+
+
+void TemporalBlocker::transform()
+{
+    if(!isTemporallyBlocked(kernelInfo, params, settings)){
+        cout << "WARNING: TEMPORAL_STEPS needs an iterate(N) kernel, with N a multiple of it, one element per thread, no vectorization, and the iterated image in global memory. It is ignored" << endl;
+        return;
+    }
+
+    SgFunctionDeclaration* funcDef = AstUtil::getFunctionDeclaration(project, kernelInfo.getKernelName());
+    SgBasicBlock* functionBody = funcDef->get_definition()->get_body();
+
+    SgStatementPtrList statements = loopBody->get_statements();
+    int first = 0;
+    while(first < statements.size()){
+        SgIfStmt* ifStmt = isSgIfStmt(statements[first++]);
+        if(ifStmt && isSgContinueStmt(ifStmt->get_true_body())){
+            break;
+        }
+    }
+    for(int i = first; i < statements.size(); i++){
+        pixelStatements.push_back(statements[i]);
+    }
+
+    SgFunctionCallExp* getLocalIdx = buildFunctionCallExp("get_local_id", buildIntType(), buildExprListExp(buildIntVal(0)), functionBody);
+    SgFunctionCallExp* getLocalIdy = buildFunctionCallExp("get_local_id", buildIntType(), buildExprListExp(buildIntVal(1)), functionBody);
+    SgAssignInitializer* threadId = buildAssignInitializer(buildAddOp(buildMultiplyOp(getLocalIdy, buildIntVal(params.localSizeX)), getLocalIdx));
+
+    vector<SgStatement*> prologue;
+    prologue.push_back(buildBufferDeclaration(0, functionBody));
+    prologue.push_back(buildBufferDeclaration(1, functionBody));
+    prologue.push_back(buildVariableDeclaration("temporal_thread_id", buildIntType(), threadId, functionBody));
+    prologue.push_back(buildTileOriginDeclaration(0, functionBody));
+    prologue.push_back(buildTileOriginDeclaration(1, functionBody));
+    prologue.push_back(buildLoadingLoop(functionBody));
+    prologue.push_back(buildExprStatement(buildBarrierCall(functionBody)));
+
+    // The steps are copied before the per pixel body is changed, it is the last step
+    vector<SgBasicBlock*> pixelBodies;
+    for(int step = 1; step < params.temporalSteps; step++){
+        SgBasicBlock* pixelBody;
+        prologue.push_back(buildStepLoop(step, functionBody, &pixelBody));
+        prologue.push_back(buildExprStatement(buildBarrierCall(functionBody)));
+        pixelBodies.push_back(pixelBody);
+    }
+
+    for(auto it = prologue.rbegin(); it != prologue.rend(); ++it){
+        prependStatement(*it, functionBody);
+    }
+
+    for(int step = 1; step < params.temporalSteps; step++){
+        rebindStep(pixelBodies[step - 1], step);
+    }
+    replaceSourceReads(loopBody, (params.temporalSteps - 1) % 2);
+
+    cout << "[TemporalBlocker] " << params.temporalSteps << " iterations per launch, " << tileSizeX << "x" << tileSizeY << " tile of " << source << endl;
+
+    fixVariableReferences(project);
+    AstIndex::getInstance()->invalidate();
+}
+
+
+SgType* TemporalBlocker::buildPixelType()
+{
+    switch(kernelInfo.getPixelType(source)){
+    case INT:
+        return buildIntType();
+    case UCHAR:
+        return buildUnsignedCharType();
+    default:
+        return buildFloatType();
+    }
+}
+
+
+// __local float temporal_buffer_0[tileSizeY][tileSizeX];
+SgVariableDeclaration* TemporalBlocker::buildBufferDeclaration(int buffer, SgScopeStatement* funcScope)
+{
+    SgType* arrayType = buildArrayType(buildArrayType(buildPixelType(), buildIntVal(tileSizeX)), buildIntVal(tileSizeY));
+    SgModifierType* modifierType = buildModifierType(arrayType);
+    modifierType->get_typeModifier().setOpenclLocal();
+
+    return buildVariableDeclaration("temporal_buffer_" + to_string(buffer), modifierType, NULL, funcScope);
+}
+
+
+// Position in the image of element [0][0] of the buffers
+SgVariableDeclaration* TemporalBlocker::buildTileOriginDeclaration(int dim, SgScopeStatement* funcScope)
+{
+    int groupSize = dim == 0 ? params.localSizeX : params.localSizeY;
+    int padding = params.temporalSteps * (dim == 0 ? haloSize.left : haloSize.up);
+
+    SgFunctionCallExp* getGroupId = buildFunctionCallExp("get_group_id", buildIntType(), buildExprListExp(buildIntVal(dim)), funcScope);
+    SgExpression* origin = buildSubtractOp(buildMultiplyOp(getGroupId, buildIntVal(groupSize)), buildIntVal(padding));
+
+    return buildVariableDeclaration(dim == 0 ? "temporal_tile_x" : "temporal_tile_y", buildIntType(), buildAssignInitializer(origin), funcScope);
+}
+
+
+// Copies the whole tile of the source to buffer 0. The reads are guarded like other reads of
+// the source, except past the end of the image in a direction without halo, where the tile
+// is only larger than the image for the last work-groups, and there is no guard.
+SgForStatement* TemporalBlocker::buildLoadingLoop(SgScopeStatement* funcScope)
+{
+    string iterVar = "temporal_load_i";
+    SgBasicBlock* block = buildBasicBlock();
+
+    SgAssignInitializer* computeX = buildAssignInitializer(buildModOp(buildVarRefExp(iterVar, block), buildIntVal(tileSizeX)));
+    block->append_statement(buildVariableDeclaration("temporal_x", buildIntType(), computeX, block));
+    SgAssignInitializer* computeY = buildAssignInitializer(buildDivideOp(buildVarRefExp(iterVar, block), buildIntVal(tileSizeX)));
+    block->append_statement(buildVariableDeclaration("temporal_y", buildIntType(), computeY, block));
+
+    SgExpression* globalX = buildAddOp(buildVarRefExp("temporal_tile_x", funcScope), buildVarRefExp("temporal_x", block));
+    SgExpression* globalY = buildAddOp(buildVarRefExp("temporal_tile_y", funcScope), buildVarRefExp("temporal_y", block));
+
+    SgExpression* isOutside = NULL;
+    if(haloSize.left == 0 && haloSize.right == 0){
+        isOutside = buildGreaterOrEqualOp(copyExpression(globalX), buildOpaqueVarRefExp(source + "_width", funcScope));
+    }
+    if(haloSize.up == 0 && haloSize.down == 0){
+        SgExpression* outsideY = buildGreaterOrEqualOp(copyExpression(globalY), buildOpaqueVarRefExp(source + "_height", funcScope));
+        isOutside = isOutside == NULL ? outsideY : buildOrOp(isOutside, outsideY);
+    }
+    if(isOutside != NULL){
+        block->append_statement(buildIfStmt(isOutside, buildContinueStmt(), buildNullStatement()));
+    }
+
+    SgPntrArrRefExp* sourceRef = buildPntrArrRefExp(buildPntrArrRefExp(buildVarRefExp(source, funcScope), globalX), globalY);
+    SgPntrArrRefExp* bufferRef = buildBufferRef(0, buildVarRefExp("temporal_x", block), buildVarRefExp("temporal_y", block), block);
+    block->append_statement(buildExprStatement(buildAssignOp(bufferRef, sourceRef)));
+
+    SgVariableDeclaration* init = buildVariableDeclaration(iterVar, buildIntType(), buildAssignInitializer(buildVarRefExp("temporal_thread_id", funcScope)), funcScope);
+    SgExprStatement* test = buildExprStatement(buildLessThanOp(buildVarRefExp(iterVar, funcScope), buildIntVal(tileSizeX * tileSizeY)));
+    SgExpression* inc = buildPlusAssignOp(buildVarRefExp(iterVar, funcScope), buildIntVal(params.localSizeX * params.localSizeY));
+
+    return buildForStatement(init, test, inc, block);
+}
+
+
+// Position in the image whose value is computed for the tile position temporal_x/y. With
+// clamped boundaries, pixels outside the image have the value of the closest pixel inside
+// it, so that pixel is computed instead.
+SgExpression* TemporalBlocker::buildPixelPosition(int dim, SgScopeStatement* scope)
+{
+    string tile = dim == 0 ? "temporal_tile_x" : "temporal_tile_y";
+    string local = dim == 0 ? "temporal_x" : "temporal_y";
+    string size = source + (dim == 0 ? "_width" : "_height");
+
+    SgExpression* position = buildAddOp(buildVarRefExp(tile, scope), buildVarRefExp(local, scope));
+    if(kernelInfo.getBoundaryConditionForArray(source) == CLAMPED){
+        SgFunctionCallExp* maxPos = buildFunctionCallExp("max", buildIntType(), buildExprListExp(buildIntVal(0), position), scope);
+        SgExpression* last = buildSubtractOp(buildOpaqueVarRefExp(size, scope), buildIntVal(1));
+        position = buildFunctionCallExp("min", buildIntType(), buildExprListExp(maxPos, last), scope);
+    }
+
+    return position;
+}
+
+
+// Step s reads buffer (s-1)%2, and writes buffer s%2 for the part of the tile the last
+// steps still need, a halo of (T - s) halos of the kernel around the work-group's pixels:
+//
+// for(int temporal_i = temporal_thread_id; temporal_i < sizeX*sizeY; temporal_i += LSX*LSY){
+//     int temporal_x = temporal_i % sizeX + s*left;
+//     int temporal_y = temporal_i / sizeX + s*up;
+//     int temporal_idx = temporal_tile_x + temporal_x;
+//     int temporal_idy = temporal_tile_y + temporal_y;
+//     if(outside image){ temporal_buffer_1[temporal_y][temporal_x] = 0; continue; }  (constant boundary)
+//     { kernel body, for pixel temporal_idx, temporal_idy }
+// }
+SgForStatement* TemporalBlocker::buildStepLoop(int step, SgScopeStatement* funcScope, SgBasicBlock** pixelBody)
+{
+    int sizeX = tileSizeX - step * (haloSize.left + haloSize.right);
+    int sizeY = tileSizeY - step * (haloSize.up + haloSize.down);
+
+    string iterVar = "temporal_i";
+    SgBasicBlock* block = buildBasicBlock();
+
+    SgExpression* computeX = buildAddOp(buildModOp(buildVarRefExp(iterVar, block), buildIntVal(sizeX)), buildIntVal(step * haloSize.left));
+    block->append_statement(buildVariableDeclaration("temporal_x", buildIntType(), buildAssignInitializer(computeX), block));
+    SgExpression* computeY = buildAddOp(buildDivideOp(buildVarRefExp(iterVar, block), buildIntVal(sizeX)), buildIntVal(step * haloSize.up));
+    block->append_statement(buildVariableDeclaration("temporal_y", buildIntType(), buildAssignInitializer(computeY), block));
+
+    block->append_statement(buildVariableDeclaration("temporal_idx", buildIntType(), buildAssignInitializer(buildPixelPosition(0, block)), block));
+    block->append_statement(buildVariableDeclaration("temporal_idy", buildIntType(), buildAssignInitializer(buildPixelPosition(1, block)), block));
+
+    if(kernelInfo.getBoundaryConditionForArray(source) == CONSTANT){
+        SgExpression* outsideX = buildOrOp(buildLessThanOp(buildVarRefExp("temporal_idx", block), buildIntVal(0)),
+                                           buildGreaterOrEqualOp(buildVarRefExp("temporal_idx", block), buildOpaqueVarRefExp(source + "_width", block)));
+        SgExpression* outsideY = buildOrOp(buildLessThanOp(buildVarRefExp("temporal_idy", block), buildIntVal(0)),
+                                           buildGreaterOrEqualOp(buildVarRefExp("temporal_idy", block), buildOpaqueVarRefExp(source + "_height", block)));
+
+        SgPntrArrRefExp* bufferRef = buildBufferRef(step % 2, buildVarRefExp("temporal_x", block), buildVarRefExp("temporal_y", block), block);
+        SgBasicBlock* outsideBody = buildBasicBlock(buildExprStatement(buildAssignOp(bufferRef, buildIntVal(0))), buildContinueStmt());
+        block->append_statement(buildIfStmt(buildOrOp(outsideX, outsideY), outsideBody, NULL));
+    }
+
+    *pixelBody = buildBasicBlock();
+    for(SgStatement* statement : pixelStatements){
+        appendStatement(copyStatement(statement), *pixelBody);
+    }
+    block->append_statement(*pixelBody);
+
+    SgVariableDeclaration* init = buildVariableDeclaration(iterVar, buildIntType(), buildAssignInitializer(buildVarRefExp("temporal_thread_id", funcScope)), funcScope);
+    SgExprStatement* test = buildExprStatement(buildLessThanOp(buildVarRefExp(iterVar, funcScope), buildIntVal(sizeX * sizeY)));
+    SgExpression* inc = buildPlusAssignOp(buildVarRefExp(iterVar, funcScope), buildIntVal(params.localSizeX * params.localSizeY));
+
+    return buildForStatement(init, test, inc, block);
+}
+
+
+// In a copy of the kernel body, the target is written to the tile position of the step,
+// the source is read from the previous step's buffer, and idx and idy are the pixel computed.
+// The copy's references to its own local variables are looked up again, as in
+// BoundryGuardInserter::splitBorder.
+void TemporalBlocker::rebindStep(SgBasicBlock* pixelBody, int step)
+{
+    Rose_STL_Container<SgNode*> arrRefNodes = NodeQuery::querySubTree(pixelBody, V_SgPntrArrRefExp);
+    for(SgNode* n : arrRefNodes){
+        SgPntrArrRefExp* arrRef = isSgPntrArrRefExp(n);
+        if(AstUtil::is2DArrayRoot(arrRef) && AstUtil::getArrayName(arrRef) == target){
+            SgScopeStatement* scope = getScope(arrRef);
+            replaceExpression(arrRef, buildBufferRef(step % 2, buildVarRefExp("temporal_x", scope), buildVarRefExp("temporal_y", scope), scope));
+        }
+    }
+
+    replaceSourceReads(pixelBody, (step - 1) % 2);
+
+    Rose_STL_Container<SgNode*> varRefNodes = NodeQuery::querySubTree(pixelBody, V_SgVarRefExp);
+    for(SgNode* n : varRefNodes){
+        SgVarRefExp* varRef = isSgVarRefExp(n);
+        string name = varRef->get_symbol()->get_name().getString();
+
+        if(name == "idx"){
+            replaceExpression(varRef, buildVarRefExp("temporal_idx", getScope(varRef)));
+        }
+        else if(name == "idy"){
+            replaceExpression(varRef, buildVarRefExp("temporal_idy", getScope(varRef)));
+        }
+        else if(isAncestor(loopBody, varRef->get_symbol()->get_declaration())){
+            replaceExpression(varRef, buildVarRefExp(name, getScope(varRef)));
+        }
+    }
+}
+
+
+// source[x][y] becomes temporal_buffer_n[y - temporal_tile_y][x - temporal_tile_x]
+void TemporalBlocker::replaceSourceReads(SgNode* body, int buffer)
+{
+    Rose_STL_Container<SgNode*> arrRefNodes = NodeQuery::querySubTree(body, V_SgPntrArrRefExp);
+    for(SgNode* n : arrRefNodes){
+        SgPntrArrRefExp* arrRef = isSgPntrArrRefExp(n);
+        if(!AstUtil::is2DArrayRoot(arrRef) || AstUtil::getArrayName(arrRef) != source){
+            continue;
+        }
+
+        SgScopeStatement* scope = getScope(arrRef);
+        SgExpression* x = copyExpression(isSgPntrArrRefExp(arrRef->get_lhs_operand())->get_rhs_operand());
+        SgExpression* y = copyExpression(arrRef->get_rhs_operand());
+        SgExpression* localX = buildSubtractOp(x, buildVarRefExp("temporal_tile_x", scope));
+        SgExpression* localY = buildSubtractOp(y, buildVarRefExp("temporal_tile_y", scope));
+
+        replaceExpression(arrRef, buildBufferRef(buffer, localX, localY, scope));
+    }
+}
+
+
+SgPntrArrRefExp* TemporalBlocker::buildBufferRef(int buffer, SgExpression* x, SgExpression* y, SgScopeStatement* scope)
+{
+    SgVarRefExp* bufferRef = buildVarRefExp("temporal_buffer_" + to_string(buffer), scope);
+    return buildPntrArrRefExp(buildPntrArrRefExp(bufferRef, y), x);
+}
+
+
+SgFunctionCallExp* TemporalBlocker::buildBarrierCall(SgScopeStatement* funcScope)
+{
+    SgExpression* localMemFence = buildOpaqueVarRefExp("CLK_LOCAL_MEM_FENCE", getGlobalScope(funcScope));
+    return buildFunctionCallExp("barrier", buildVoidType(), buildExprListExp(localMemFence), funcScope);
+}
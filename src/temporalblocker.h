@@ -0,0 +1,66 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef TEMPORALBLOCKER_H
+#define TEMPORALBLOCKER_H
+
+#include "rose.h"
+#include "footprintfinder.h"
+#include "parameters.h"
+#include "kernelinfo.h"
+#include "settings.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Does TEMPORAL_STEPS iterations of an iterate(N) kernel in each launch. Each work-group
+// loads its tile of the source image, with a halo TEMPORAL_STEPS times as large as the one
+// of the kernel, into local memory. Every step but the last computes the kernel for the
+// part of the tile still valid, shrinking by one halo per step, into a second local buffer,
+// and the two buffers are swapped. The last step is the kernel itself, reading the source
+// from local memory, and writing the target image as before.
+class TemporalBlocker
+{
+public:
+    TemporalBlocker(SgProject* project, Parameters params, KernelInfo kernelInfo, Settings settings, SgBasicBlock* loopBody);
+    void transform();
+
+    static bool isTemporallyBlocked(KernelInfo& kernelInfo, Parameters& params, Settings& settings);
+    static int getStepsPerLaunch(KernelInfo& kernelInfo, Parameters& params, Settings& settings);
+    static long long getLocalMemoryUsage(KernelInfo& kernelInfo, Parameters& params, Settings& settings);
+
+private:
+    SgVariableDeclaration* buildBufferDeclaration(int buffer, SgScopeStatement* funcScope);
+    SgVariableDeclaration* buildTileOriginDeclaration(int dim, SgScopeStatement* funcScope);
+    SgForStatement* buildLoadingLoop(SgScopeStatement* funcScope);
+    SgForStatement* buildStepLoop(int step, SgScopeStatement* funcScope, SgBasicBlock** pixelBody);
+    SgExpression* buildPixelPosition(int dim, SgScopeStatement* scope);
+    SgPntrArrRefExp* buildBufferRef(int buffer, SgExpression* x, SgExpression* y, SgScopeStatement* scope);
+    SgFunctionCallExp* buildBarrierCall(SgScopeStatement* funcScope);
+    void replaceSourceReads(SgNode* body, int buffer);
+    void rebindStep(SgBasicBlock* pixelBody, int step);
+    SgType* buildPixelType();
+
+    SgProject* project;
+    Parameters params;
+    KernelInfo kernelInfo;
+    Settings settings;
+    SgBasicBlock* loopBody;
+
+    string source;
+    string target;
+    HaloSize haloSize;
+    int tileSizeX;
+    int tileSizeY;
+
+    // The statements of the per pixel body after the GS_X/GS_Y test, copied into every step
+    vector<SgStatement*> pixelStatements;
+};
+
+#endif // TEMPORALBLOCKER_H
@@ -0,0 +1,693 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "tuner.h"
+#include "temporalblocker.h"
+#include "clutil/clutil.h"
+
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <set>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <sstream>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+Tuner::Tuner(VariantGenerator* variantGenerator, KernelInfo kernelInfo, Settings settings) : variantGenerator(variantGenerator), kernelInfo(kernelInfo), settings(settings)
+{
+    nMeasured = 0;
+    foundValid = false;
+    bestTime = 0;
+    lastImprovement = 0;
+
+    // Fixed seed, so that repeated tuning runs measure the same variants
+    generator.seed(0);
+
+    // The wrapper is not needed to time a variant
+    this->settings.generateStandalone = false;
+    this->settings.generateFAST = false;
+
+    setUpOpenCL();
+}
+
+
+Tuner::~Tuner()
+{
+    delete pruner;
+    delete database;
+    clReleaseCommandQueue(queue);
+    clReleaseContext(context);
+}
+
+
+void Tuner::setUpOpenCL()
+{
+    cl_int error;
+
+    device = get_device_by_id(settings.platformId, settings.deviceId);
+
+    char deviceName[256];
+    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(deviceName), deviceName, NULL);
+    cout << "[Tuner] Tuning for " << deviceName << endl;
+
+    context = clCreateContext(NULL, 1, &device, NULL, NULL, &error);
+    if(error != CL_SUCCESS){
+        cerr << "ERROR: Could not create OpenCL context: " << clErrorStr(error) << ". Exiting..." << endl;
+        exit(-1);
+    }
+
+    queue = clCreateCommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE, &error);
+    if(error != CL_SUCCESS){
+        cerr << "ERROR: Could not create OpenCL command queue: " << clErrorStr(error) << ". Exiting..." << endl;
+        exit(-1);
+    }
+
+    pruner = new SpacePruner(kernelInfo, settings, device);
+
+    deviceKey = TuningDatabase::getDeviceKey(device);
+    database = new TuningDatabase(settings.tuningDatabase);
+    database->load();
+}
+
+
+// Image arrays cover the tuning image. Other arrays have their declared size if it is
+// known, and are otherwise as large as the image.
+size_t Tuner::getNumberOfElements(Argument arg)
+{
+    size_t imageSize = (size_t)settings.tuningWidth * settings.tuningHeight;
+
+    if(kernelInfo.isImageArray(arg.name)){
+        return imageSize;
+    }
+
+    size_t size = 1;
+    for(int index : arg.type.indices){
+        if(index <= 0){
+            return imageSize;
+        }
+        size *= index;
+    }
+    return size;
+}
+
+
+// The input is filled with small, deterministic values, so that the kernels do the same
+// work for every variant and floating point data does not contain NaNs. Types without a
+// known size, which are filled as int, use the size of an int.
+void Tuner::fillHostData(vector<unsigned char>& data, BaseType baseType, size_t nElements)
+{
+    int elementSize = Type::getBaseTypeSize(baseType);
+    if(elementSize == 0){
+        elementSize = sizeof(cl_int);
+    }
+    data.resize(nElements * elementSize);
+
+    for(size_t i = 0; i < nElements; i++){
+        int value = (i * 7 + i / 13) % 255;
+        if(baseType == FLOAT){
+            ((cl_float*)data.data())[i] = value / 255.0f;
+        }
+        else if(baseType == UCHAR || baseType == CHAR){
+            data[i] = value;
+        }
+        else{
+            ((cl_int*)data.data())[i] = value;
+        }
+    }
+}
+
+
+cl_mem Tuner::createMemoryObject(Argument arg, cl_int* error)
+{
+    vector<unsigned char> hostData;
+
+    if(arg.type.baseType == IMAGE2D_T){
+        BaseType pixelType = kernelInfo.getPixelType(arg.name);
+        fillHostData(hostData, pixelType, getNumberOfElements(arg));
+
+        cl_image_format format;
+        format.image_channel_order = CL_R;
+        if(pixelType == FLOAT){
+            format.image_channel_data_type = CL_FLOAT;
+        }
+        else if(pixelType == UCHAR){
+            format.image_channel_data_type = CL_UNSIGNED_INT8;
+        }
+        else{
+            format.image_channel_data_type = CL_SIGNED_INT32;
+        }
+
+        cl_image_desc desc = {};
+        desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+        desc.image_width = settings.tuningWidth;
+        desc.image_height = settings.tuningHeight;
+
+        return clCreateImage(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, &format, &desc, hostData.data(), error);
+    }
+
+    fillHostData(hostData, arg.type.baseType, getNumberOfElements(arg));
+    return clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, hostData.size(), hostData.data(), error);
+}
+
+
+// The variant is generated in a forked child, like the workers of
+// VariantGenerator::generateParallel, so that a transformation exiting on an invalid
+// combination of parameters only loses that variant. The children inherit the analyzed AST
+// copy-on-write, so no snapshot is needed. The arguments of the kernel are passed back in
+// <base>.args, one argument per line.
+bool Tuner::generateVariant(Parameters params, string baseName, vector<Argument>& arguments)
+{
+    string argumentsFileName = baseName + ".args";
+
+    cout.flush();
+    fflush(stdout);
+
+    pid_t pid = fork();
+
+    if(pid == 0){
+        Settings variantSettings = settings;
+        variantSettings.inputBaseName = baseName;
+        vector<Argument>* generated = variantGenerator->generate(params, variantSettings);
+
+        ofstream argumentsFile(argumentsFileName);
+        for(Argument arg : *generated){
+            argumentsFile << arg.name << " " << arg.type.baseType << " " << arg.type.pointerLevel << " ";
+            argumentsFile << arg.isImageWidth << " " << arg.isImageHeight << " " << arg.type.indices.size();
+            for(int index : arg.type.indices){
+                argumentsFile << " " << index;
+            }
+            argumentsFile << " " << arg.imageName << endl;
+        }
+        argumentsFile.close();
+
+        cout.flush();
+        fflush(stdout);
+        _exit(argumentsFile.fail() ? 1 : 0);
+    }
+
+    if(pid < 0){
+        cerr << "WARNING: Could not fork worker for variant" << endl;
+        return false;
+    }
+
+    int childStatus;
+    if(waitpid(pid, &childStatus, 0) < 0 || !WIFEXITED(childStatus) || WEXITSTATUS(childStatus) != 0){
+        remove(argumentsFileName.c_str());
+        return false;
+    }
+
+    ifstream argumentsFile(argumentsFileName);
+    string line;
+    while(getline(argumentsFile, line)){
+        istringstream fields(line);
+        string name;
+        int baseType;
+        Type type;
+        bool isImageWidth, isImageHeight;
+        int nIndices;
+        fields >> name >> baseType >> type.pointerLevel >> isImageWidth >> isImageHeight >> nIndices;
+        type.baseType = (BaseType)baseType;
+        for(int i = 0; i < nIndices; i++){
+            int index;
+            fields >> index;
+            type.indices.push_back(index);
+        }
+        string imageName;
+        fields >> imageName;
+
+        arguments.push_back(Argument(name, type, isImageWidth, isImageHeight, imageName));
+    }
+    argumentsFile.close();
+    remove(argumentsFileName.c_str());
+
+    return true;
+}
+
+
+// Returns the average kernel execution time in ms, or a negative value if the
+// variant could not be built or run
+double Tuner::measure(Parameters params)
+{
+    size_t localWorkSize[2];
+    size_t globalWorkSize[2];
+    params.getWorkSizes(settings.tuningWidth, settings.tuningHeight, localWorkSize, globalWorkSize);
+
+    string baseName = settings.inputBaseName + "_tuning";
+
+    vector<Argument> variantArguments;
+    if(!generateVariant(params, baseName, variantArguments)){
+        cout << "WARNING: Could not generate variant, skipping" << endl;
+        return -1;
+    }
+    vector<Argument>* arguments = &variantArguments;
+
+    cl_int error = CL_SUCCESS;
+    char options[100];
+    sprintf(options, "-DGS_X=%d -DGS_Y=%d", settings.tuningWidth, settings.tuningHeight);
+    string kernelFileName = baseName + ".cl";
+    string kernelName = kernelInfo.getKernelName();
+
+    cl_kernel kernel = buildKernel(&kernelFileName[0], &kernelName[0], options, context, device, &error);
+    if(kernel == NULL){
+        cout << "WARNING: Could not build variant, skipping" << endl;
+        return -1;
+    }
+
+    vector<cl_mem> memoryObjects;
+    bool argumentsSet = true;
+
+    for(int i = 0; i < arguments->size(); i++){
+        Argument arg = arguments->at(i);
+
+        if(arg.type.pointerLevel > 0 || arg.type.baseType == IMAGE2D_T){
+            cl_mem memoryObject = createMemoryObject(arg, &error);
+            if(error != CL_SUCCESS){
+                argumentsSet = false;
+                break;
+            }
+            memoryObjects.push_back(memoryObject);
+            error = clSetKernelArg(kernel, i, sizeof(cl_mem), &memoryObject);
+        }
+        else if(arg.isImageWidth){
+            cl_int value = settings.tuningWidth;
+            error = clSetKernelArg(kernel, i, sizeof(cl_int), &value);
+        }
+        else if(arg.isImageHeight){
+            cl_int value = settings.tuningHeight;
+            error = clSetKernelArg(kernel, i, sizeof(cl_int), &value);
+        }
+        else if(arg.type.baseType == FLOAT){
+            cl_float value = 1.0f;
+            error = clSetKernelArg(kernel, i, sizeof(cl_float), &value);
+        }
+        else if(arg.type.baseType == UCHAR){
+            cl_uchar value = 1;
+            error = clSetKernelArg(kernel, i, sizeof(cl_uchar), &value);
+        }
+        else{
+            cl_int value = 1;
+            error = clSetKernelArg(kernel, i, sizeof(cl_int), &value);
+        }
+
+        if(error != CL_SUCCESS){
+            argumentsSet = false;
+            break;
+        }
+    }
+
+    double time = -1;
+
+    if(argumentsSet){
+        // One untimed launch, so that one time costs are not included
+        error = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalWorkSize, localWorkSize, 0, NULL, NULL);
+        clFinish(queue);
+
+        cl_ulong elapsedTime = 0;
+        for(int i = 0; i < settings.nLaunchesForTiming && error == CL_SUCCESS; i++){
+            cl_event timingEvent;
+            error = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalWorkSize, localWorkSize, 0, NULL, &timingEvent);
+            if(error != CL_SUCCESS){
+                break;
+            }
+            clWaitForEvents(1, &timingEvent);
+
+            cl_ulong startTime = 0, endTime = 0;
+            clGetEventProfilingInfo(timingEvent, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &startTime, NULL);
+            clGetEventProfilingInfo(timingEvent, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &endTime, NULL);
+            clReleaseEvent(timingEvent);
+
+            elapsedTime += endTime - startTime;
+        }
+
+        // Variants doing several iterations per launch are compared by the time per iteration
+        if(error == CL_SUCCESS){
+            int steps = TemporalBlocker::getStepsPerLaunch(kernelInfo, params, settings);
+            time = elapsedTime / (settings.nLaunchesForTiming * steps * 1000000.0);
+        }
+        else{
+            cout << "WARNING: Could not run variant: " << clErrorStr(error) << ", skipping" << endl;
+        }
+    }
+    else{
+        cout << "WARNING: Could not set up arguments for variant: " << clErrorStr(error) << ", skipping" << endl;
+    }
+
+    for(cl_mem memoryObject : memoryObjects){
+        clReleaseMemObject(memoryObject);
+    }
+    clReleaseKernel(kernel);
+    remove(kernelFileName.c_str());
+
+    return time;
+}
+
+
+void Tuner::recordMeasurement(Parameters params, vector<int> point, double time)
+{
+    nMeasured++;
+
+    if(time < 0){
+        cout << "[Tuner] Variant " << nMeasured << ": invalid" << endl;
+        return;
+    }
+
+    cout << "[Tuner] Variant " << nMeasured << ": " << time << " ms" << endl;
+
+    measuredPoints.push_back(point);
+    measuredTimes.push_back(time);
+
+    if(!foundValid || time < bestTime * (1 - settings.tuningMinImprovement / 100)){
+        lastImprovement = nMeasured;
+    }
+
+    if(!foundValid || time < bestTime){
+        foundValid = true;
+        bestTime = time;
+        bestParams = params;
+        bestPoint = point;
+    }
+}
+
+
+// Points are only measured once. If the space was too large to be enumerated by the
+// pruner, or the point was not drawn from the valid points, invalid points are rejected
+// here, before the variant is generated. Returns true if the point was measured.
+bool Tuner::evaluate(ParameterSpace* space, vector<int> point)
+{
+    if(!tried.insert(space->getCrossProductIndex(point)).second){
+        return false;
+    }
+
+    Parameters params = space->getConfiguration(point);
+    params.setParametersFromPragmas(kernelInfo.getPragmas());
+
+    // An invalid configuration is skipped, rather than ending the tuning run
+    string error;
+    if(!params.checkParameters(kernelInfo, error)){
+        cout << "[Tuner] Skipping configuration: " << error << endl;
+        return false;
+    }
+
+    if(!pruner->isValid(params)){
+        return false;
+    }
+
+    double time = measure(params);
+    recordMeasurement(params, point, time);
+
+    TuningRecord record;
+    record.kernelHash = kernelInfo.getSourceHash();
+    record.device = deviceKey;
+    record.gridWidth = settings.tuningWidth;
+    record.gridHeight = settings.tuningHeight;
+    record.time = time;
+    record.params = params;
+    record.signature = kernelInfo.getSignature();
+    database->addRecord(record);
+
+    return true;
+}
+
+
+// Measurements of the same kernel, on the same device and image size, from earlier tuning
+// runs are used as if they had been made in this run, but do not count as measurements
+void Tuner::loadKnownMeasurements(ParameterSpace* space)
+{
+    int nKnown = 0;
+
+    for(TuningRecord record : *database->getRecords(kernelInfo.getSourceHash(), deviceKey, settings.tuningWidth, settings.tuningHeight)){
+        vector<int> point;
+        if(!space->findPoint(record.params, point)){
+            continue;
+        }
+        if(!tried.insert(space->getCrossProductIndex(point)).second){
+            continue;
+        }
+        nKnown++;
+
+        if(record.time < 0){
+            continue;
+        }
+
+        measuredPoints.push_back(point);
+        measuredTimes.push_back(record.time);
+
+        if(!foundValid || record.time < bestTime){
+            foundValid = true;
+            bestTime = record.time;
+            bestParams = record.params;
+            bestPoint = point;
+        }
+    }
+
+    if(nKnown > 0){
+        cout << "[Tuner] Using " << nKnown << " measurements from " << settings.tuningDatabase << endl;
+    }
+}
+
+
+// Configurations of other kernels refer to their own loops and arrays. Loops are matched
+// by their position in the source, relative to the number of unrollable loops of each
+// kernel, so that kernels with the same number of loops are matched one to one, and
+// ParameterSpace::getClosestPoint picks the closest unroll factor of this kernel. If the
+// other kernel has no unrollable loops, the loops get the first, smallest, factor of the
+// space. Arrays are matched by name by getClosestPoint, and arrays this kernel does not have
+// are dropped.
+Parameters Tuner::adaptConfiguration(Parameters params)
+{
+    vector<pair<int,int>> otherLoops = *(params.forLoops);
+    vector<pair<int,vector<int>*>> loops = *(kernelInfo.getForLoops());
+    sort(otherLoops.begin(), otherLoops.end());
+    sort(loops.begin(), loops.end());
+
+    params.forLoops = new vector<pair<int,int>>();
+    if(!otherLoops.empty()){
+        for(int i = 0; i < loops.size(); i++){
+            int other = i * otherLoops.size() / loops.size();
+            params.forLoops->push_back(make_pair(loops[i].first, otherLoops[other].second));
+        }
+    }
+
+    return params;
+}
+
+
+// The best configurations of the most similar kernels in the tuning database are measured
+// before the search, since they are likely to be good for this kernel as well
+void Tuner::measureSimilarKernelConfigurations(ParameterSpace* space)
+{
+    if(settings.tuningTransferKernels <= 0){
+        return;
+    }
+
+    vector<TuningRecord>* similar = database->getSimilarKernelRecords(kernelInfo.getSourceHash(), kernelInfo.getSignature(), deviceKey, settings.tuningWidth, settings.tuningHeight, settings.tuningTransferKernels);
+
+    if(similar->empty()){
+        return;
+    }
+
+    cout << "[Tuner] Measuring the best configurations of " << similar->size() << " similar kernels" << endl;
+
+    for(TuningRecord record : *similar){
+        if(shouldStop()){
+            break;
+        }
+        evaluate(space, space->getClosestPoint(adaptConfiguration(record.params)));
+    }
+}
+
+
+bool Tuner::shouldStop()
+{
+    if(settings.tuningTimeBudget > 0){
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - startTime;
+        if(elapsed.count() > settings.tuningTimeBudget){
+            cout << "[Tuner] Time budget used" << endl;
+            return true;
+        }
+    }
+
+    if(settings.tuningStrategy != EXHAUSTIVE && nMeasured >= settings.tuningSamples){
+        return true;
+    }
+
+    if(settings.tuningStrategy == MODEL && foundValid && nMeasured - lastImprovement >= settings.tuningPatience){
+        cout << "[Tuner] No improvement in the last " << settings.tuningPatience << " variants" << endl;
+        return true;
+    }
+
+    return false;
+}
+
+
+void Tuner::searchExhaustive(ParameterSpace* space)
+{
+    cout << "[Tuner] Measuring all " << space->size() << " configurations" << endl;
+
+    for(long long i = 0; i < space->size() && !shouldStop(); i++){
+        evaluate(space, space->getPoint(i));
+    }
+}
+
+
+void Tuner::searchRandom(ParameterSpace* space)
+{
+    cout << "[Tuner] Measuring " << settings.tuningSamples << " of " << space->size() << " configurations" << endl;
+
+    uniform_int_distribution<long long> distribution(0, space->size() - 1);
+
+    long long maxAttempts = 100LL * settings.tuningSamples;
+    for(long long attempt = 0; attempt < maxAttempts && !shouldStop(); attempt++){
+        evaluate(space, space->getPoint(distribution(generator)));
+    }
+}
+
+
+// Among random points and the neighbours of the best point so far, the one with the
+// lowest predicted time is proposed. A few random points are proposed regardless of
+// the model, so that parts of the space the model knows little about are explored.
+vector<int> Tuner::proposePoint(ParameterSpace* space, SurrogateModel& model)
+{
+    int nRandomCandidates = 500;
+    double explorationProbability = 0.1;
+
+    uniform_int_distribution<long long> distribution(0, space->size() - 1);
+    uniform_real_distribution<double> uniform(0, 1);
+
+    vector<vector<int>> candidates;
+    for(int i = 0; i < nRandomCandidates; i++){
+        vector<int> candidate = space->getPoint(distribution(generator));
+        if(tried.count(space->getCrossProductIndex(candidate)) == 0){
+            candidates.push_back(candidate);
+        }
+    }
+
+    if(candidates.empty()){
+        return space->getPoint(distribution(generator));
+    }
+
+    if(uniform(generator) < explorationProbability){
+        return candidates[0];
+    }
+
+    for(vector<int> neighbour : space->getNeighbours(bestPoint)){
+        if(tried.count(space->getCrossProductIndex(neighbour)) == 0){
+            candidates.push_back(neighbour);
+        }
+    }
+
+    vector<int> bestCandidate = candidates[0];
+    double bestPrediction = 0;
+    for(int i = 0; i < candidates.size(); i++){
+        vector<double> features = space->getFeatures(candidates[i]);
+        double prediction = model.predict(features);
+        if(i == 0 || prediction < bestPrediction){
+            bestPrediction = prediction;
+            bestCandidate = candidates[i];
+        }
+    }
+
+    return bestCandidate;
+}
+
+
+// The model is fitted to the logarithm of the measured times, after an initial set of
+// random measurements, and refitted after each new measurement
+void Tuner::searchModel(ParameterSpace* space)
+{
+    cout << "[Tuner] Measuring at most " << settings.tuningSamples << " of " << space->size() << " configurations, guided by a model" << endl;
+
+    int nInitialSamples = min(20, settings.tuningSamples);
+    uniform_int_distribution<long long> distribution(0, space->size() - 1);
+
+    long long maxAttempts = 100LL * settings.tuningSamples;
+    long long attempt = 0;
+
+    for(; attempt < maxAttempts && nMeasured < nInitialSamples && !shouldStop(); attempt++){
+        evaluate(space, space->getPoint(distribution(generator)));
+    }
+
+    SurrogateModel model(100, 3, 0.1);
+    // Attempts that are rejected, or whose variant fails, add no data, so the model is only
+    // refitted after a new successful measurement
+    int nFitted = 0;
+
+    for(; attempt < maxAttempts && !shouldStop(); attempt++){
+        if(!foundValid){
+            evaluate(space, space->getPoint(distribution(generator)));
+            continue;
+        }
+
+        if(measuredPoints.size() != nFitted){
+            vector<vector<double>> features;
+            vector<double> targets;
+            for(int i = 0; i < measuredPoints.size(); i++){
+                features.push_back(space->getFeatures(measuredPoints[i]));
+                targets.push_back(log(measuredTimes[i]));
+            }
+            model.fit(features, targets);
+            nFitted = measuredPoints.size();
+        }
+
+        evaluate(space, proposePoint(space, model));
+    }
+}
+
+
+Parameters Tuner::tune(ParameterSpace* space)
+{
+    startTime = chrono::steady_clock::now();
+
+    pruner->prune(space);
+    space->printSpace();
+
+    if(space->size() == 0){
+        cerr << "ERROR: No valid configurations to tune. Exiting..." << endl;
+        exit(-1);
+    }
+
+    loadKnownMeasurements(space);
+    measureSimilarKernelConfigurations(space);
+
+    if(settings.tuningStrategy == EXHAUSTIVE || settings.tuningSamples >= space->size()){
+        searchExhaustive(space);
+    }
+    else if(settings.tuningStrategy == RANDOM){
+        searchRandom(space);
+    }
+    else{
+        searchModel(space);
+    }
+
+    if(!space->hasValidPoints()){
+        pruner->printStatistics();
+    }
+
+    if(!foundValid){
+        cerr << "ERROR: No valid variant found while tuning. Exiting..." << endl;
+        exit(-1);
+    }
+
+    cout << "[Tuner] Best time: " << bestTime << " ms, after " << nMeasured << " variants" << endl;
+    bestParams.printParameters();
+
+    return bestParams;
+}
+
+
+void Tuner::writeBestConfiguration(string fileName)
+{
+    ofstream file(fileName);
+    bestParams.writeParametersToStream(file);
+    file.close();
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef TUNER_H
+#define TUNER_H
+
+#include "variantgenerator.h"
+#include "parameterspace.h"
+#include "spacepruner.h"
+#include "surrogatemodel.h"
+#include "tuningdatabase.h"
+#include "parameters.h"
+#include "kernelinfo.h"
+#include "settings.h"
+#include "argument.h"
+
+#include <CL/cl.h>
+
+#include <string>
+#include <vector>
+#include <set>
+#include <random>
+#include <chrono>
+
+using namespace std;
+
+// Searches the parameter space by generating each variant, and timing it on the
+// OpenCL device given by PLATFORM_ID and DEVICE_ID, on a synthetic image of
+// TUNING_WIDTH x TUNING_HEIGHT pixels
+class Tuner
+{
+public:
+    Tuner(VariantGenerator* variantGenerator, KernelInfo kernelInfo, Settings settings);
+    ~Tuner();
+
+    Parameters tune(ParameterSpace* space);
+    double measure(Parameters params);
+    void writeBestConfiguration(string fileName);
+
+private:
+    void setUpOpenCL();
+    void loadKnownMeasurements(ParameterSpace* space);
+    void measureSimilarKernelConfigurations(ParameterSpace* space);
+    Parameters adaptConfiguration(Parameters params);
+    bool evaluate(ParameterSpace* space, vector<int> point);
+    bool generateVariant(Parameters params, string baseName, vector<Argument>& arguments);
+    bool shouldStop();
+    void searchExhaustive(ParameterSpace* space);
+    void searchRandom(ParameterSpace* space);
+    void searchModel(ParameterSpace* space);
+    vector<int> proposePoint(ParameterSpace* space, SurrogateModel& model);
+    cl_mem createMemoryObject(Argument arg, cl_int* error);
+    size_t getNumberOfElements(Argument arg);
+    void fillHostData(vector<unsigned char>& data, BaseType baseType, size_t nElements);
+    void recordMeasurement(Parameters params, vector<int> point, double time);
+
+    VariantGenerator* variantGenerator;
+    KernelInfo kernelInfo;
+    Settings settings;
+
+    cl_device_id device;
+    cl_context context;
+    cl_command_queue queue;
+
+    SpacePruner* pruner;
+
+    TuningDatabase* database;
+    string deviceKey;
+
+    int nMeasured;
+    bool foundValid;
+    double bestTime;
+    Parameters bestParams;
+    vector<int> bestPoint;
+
+    // Search history, as cross product indices of all points tried, and the points and
+    // times of the successful measurements
+    set<long long> tried;
+    vector<vector<int>> measuredPoints;
+    vector<double> measuredTimes;
+    int lastImprovement;
+
+    mt19937_64 generator;
+    chrono::steady_clock::time_point startTime;
+};
+
+#endif // TUNER_H
@@ -0,0 +1,233 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "tuningdatabase.h"
+#include "clutil/clutil.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+TuningDatabase::TuningDatabase(string fileName) : fileName(fileName)
+{
+    records = new vector<TuningRecord>();
+}
+
+
+void TuningDatabase::load()
+{
+    records->clear();
+
+    ifstream file;
+    file.open(fileName);
+    if(!file.is_open()){
+        return;
+    }
+
+    ostringstream currentRecord;
+    bool currentRecordEmpty = true;
+    string line;
+    while(true){
+        bool gotLine = (bool)getline(file, line);
+
+        if(!gotLine || line.find_first_not_of(" \t\r") == string::npos){
+            if(!currentRecordEmpty){
+                TuningRecord record;
+                record.gridWidth = 0;
+                record.gridHeight = 0;
+                record.time = -1;
+
+                // The parameters ignore the keys of the record, and the other way around
+                record.params.setDefaultParameters();
+                istringstream paramStream(currentRecord.str());
+                record.params.readParametersFromStream(paramStream);
+
+                istringstream recordStream(currentRecord.str());
+                string recordLine;
+                while(getline(recordStream, recordLine)){
+                    int split = recordLine.find(":");
+                    string property = recordLine.substr(0,split);
+                    string value = recordLine.substr(split+1,recordLine.size());
+
+                    if(property.compare("KERNEL") == 0)
+                        record.kernelHash = value;
+
+                    if(property.compare("DEVICE") == 0)
+                        record.device = value;
+
+                    if(property.compare("GRID") == 0){
+                        int x = value.find("x");
+                        record.gridWidth = stoi(value.substr(0,x));
+                        record.gridHeight = stoi(value.substr(x+1));
+                    }
+
+                    if(property.compare("TIME") == 0)
+                        record.time = stod(value);
+
+                    if(property.compare("SIGNATURE") == 0){
+                        for(string element : StringUtils::tokenize(value, ",")){
+                            record.signature.push_back(stod(element));
+                        }
+                    }
+                }
+
+                records->push_back(record);
+
+                currentRecord.str("");
+                currentRecordEmpty = true;
+            }
+            if(!gotLine){
+                break;
+            }
+            continue;
+        }
+
+        if(line[0] == '#'){
+            continue;
+        }
+
+        currentRecord << line << endl;
+        currentRecordEmpty = false;
+    }
+
+    file.close();
+}
+
+
+void TuningDatabase::addRecord(TuningRecord record)
+{
+    records->push_back(record);
+
+    ofstream file;
+    file.open(fileName, ios::app);
+    if(!file.is_open()){
+        cout << "WARNING: Could not write to tuning database " << fileName << endl;
+        return;
+    }
+
+    file << "KERNEL:" << record.kernelHash << endl;
+    file << "DEVICE:" << record.device << endl;
+    file << "GRID:" << record.gridWidth << "x" << record.gridHeight << endl;
+    file << "TIME:" << record.time << endl;
+    if(!record.signature.empty()){
+        file << "SIGNATURE:";
+        for(int i = 0; i < record.signature.size(); i++){
+            if(i != 0){
+                file << ",";
+            }
+            file << record.signature[i];
+        }
+        file << endl;
+    }
+    record.params.writeParametersToStream(file);
+    file << endl;
+
+    file.close();
+}
+
+
+vector<TuningRecord>* TuningDatabase::getRecords(string kernelHash, string device, int gridWidth, int gridHeight)
+{
+    vector<TuningRecord>* matching = new vector<TuningRecord>();
+
+    for(TuningRecord record : *records){
+        if(record.kernelHash.compare(kernelHash) == 0 && record.device.compare(device) == 0 &&
+           record.gridWidth == gridWidth && record.gridHeight == gridHeight){
+            matching->push_back(record);
+        }
+    }
+
+    return matching;
+}
+
+
+bool TuningDatabase::getBestRecord(string kernelHash, string device, int gridWidth, int gridHeight, TuningRecord& best)
+{
+    bool found = false;
+
+    for(TuningRecord record : *getRecords(kernelHash, device, gridWidth, gridHeight)){
+        if(record.time < 0){
+            continue;
+        }
+        if(!found || record.time < best.time){
+            best = record;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+
+// Distance between kernel signatures. The elements are compared on a logarithmic scale,
+// so that a halo of 1 and 2 differs more than a halo of 10 and 11.
+double TuningDatabase::getSignatureDistance(vector<double> a, vector<double> b)
+{
+    double distance = 0;
+    for(int i = 0; i < a.size(); i++){
+        double d = log1p(a[i]) - log1p(b[i]);
+        distance += d * d;
+    }
+    return sqrt(distance);
+}
+
+
+// The best configuration of each of the nKernels other kernels closest to the given
+// signature, that were tuned on the same device and image size, closest first
+vector<TuningRecord>* TuningDatabase::getSimilarKernelRecords(string kernelHash, vector<double> signature, string device, int gridWidth, int gridHeight, int nKernels)
+{
+    map<string, TuningRecord> bestPerKernel;
+
+    for(TuningRecord record : *records){
+        if(record.kernelHash.compare(kernelHash) == 0 || record.device.compare(device) != 0 ||
+           record.gridWidth != gridWidth || record.gridHeight != gridHeight){
+            continue;
+        }
+        if(record.time < 0 || record.signature.size() != signature.size()){
+            continue;
+        }
+        if(bestPerKernel.count(record.kernelHash) == 0 || record.time < bestPerKernel[record.kernelHash].time){
+            bestPerKernel[record.kernelHash] = record;
+        }
+    }
+
+    vector<pair<double, TuningRecord>> byDistance;
+    for(pair<string, TuningRecord> entry : bestPerKernel){
+        byDistance.push_back(make_pair(getSignatureDistance(signature, entry.second.signature), entry.second));
+    }
+    sort(byDistance.begin(), byDistance.end(), [](const pair<double, TuningRecord>& a, const pair<double, TuningRecord>& b){ return a.first < b.first; });
+
+    vector<TuningRecord>* similar = new vector<TuningRecord>();
+    for(int i = 0; i < byDistance.size() && i < nKernels; i++){
+        similar->push_back(byDistance[i].second);
+    }
+
+    return similar;
+}
+
+
+// The device name and driver version, as also printed by printDeviceInfo
+string TuningDatabase::getDeviceKey(cl_device_id device)
+{
+    char deviceName[256];
+    char driverVersion[256];
+    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(deviceName), deviceName, NULL);
+    clGetDeviceInfo(device, CL_DRIVER_VERSION, sizeof(driverVersion), driverVersion, NULL);
+
+    return string(deviceName) + ";" + string(driverVersion);
+}
+
+
+string TuningDatabase::getDeviceKey(int platformId, int deviceId)
+{
+    return getDeviceKey(get_device_by_id(platformId, deviceId));
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef TUNINGDATABASE_H
+#define TUNINGDATABASE_H
+
+#include "parameters.h"
+
+#include <CL/cl.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// One measurement of one configuration. A negative time means the variant could not be built or run.
+class TuningRecord
+{
+public:
+    string kernelHash;
+    string device;
+    int gridWidth;
+    int gridHeight;
+    double time;
+    Parameters params;
+    vector<double> signature;
+};
+
+// Append-only file of all measurements made by the tuner, in the config.txt format with
+// some additional keys, with records separated by blank lines. Records are appended as
+// they are measured, so nothing is lost if tuning is interrupted.
+class TuningDatabase
+{
+public:
+    TuningDatabase(string fileName);
+
+    void load();
+    void addRecord(TuningRecord record);
+    vector<TuningRecord>* getRecords(string kernelHash, string device, int gridWidth, int gridHeight);
+    bool getBestRecord(string kernelHash, string device, int gridWidth, int gridHeight, TuningRecord& best);
+    vector<TuningRecord>* getSimilarKernelRecords(string kernelHash, vector<double> signature, string device, int gridWidth, int gridHeight, int nKernels);
+
+    static string getDeviceKey(cl_device_id device);
+    static string getDeviceKey(int platformId, int deviceId);
+
+private:
+    static double getSignatureDistance(vector<double> a, vector<double> b);
+
+    string fileName;
+    vector<TuningRecord>* records;
+};
+
+#endif // TUNINGDATABASE_H
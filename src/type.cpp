@@ -96,3 +96,23 @@ string Type::baseTypeToMpiString(BaseType baseType)
         break;
     }
 }
+
+
+int Type::getBaseTypeSize(BaseType baseType)
+{
+    switch(baseType){
+    case FLOAT:
+        return sizeof(float);
+        break;
+    case INT:
+        return sizeof(int);
+        break;
+    case UCHAR:
+    case CHAR:
+        return sizeof(unsigned char);
+        break;
+    default:
+        return 0;
+        break;
+    }
+}
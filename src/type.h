@@ -29,6 +29,7 @@ class Type
         bool isConstantMemCandidate();
         static string baseTypeToString(BaseType baseType);
         static string baseTypeToMpiString(BaseType baseType);
+        static int getBaseTypeSize(BaseType baseType);
 };
 
 #endif // TYPE_H
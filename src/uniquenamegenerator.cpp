@@ -42,3 +42,8 @@ string UniqueNameGenerator::generate(string baseName)
     s << counter;
     return s.str();
 }
+
+void UniqueNameGenerator::reset()
+{
+    counter = -1;
+}
@@ -19,6 +19,7 @@ public:
     static UniqueNameGenerator *getInstance();
     void setUniqueString(string uniqueString);
     string generate(string baseName);
+    void reset();
 
 
 private:
@@ -0,0 +1,540 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "variantgenerator.h"
+
+#include "rose.h"
+
+#include "globalremover.h"
+#include "naivecoarsener.h"
+#include "imagememtransformer.h"
+#include "arrayflattener.h"
+#include "kernelfinder.h"
+#include "wrappergenerator.h"
+#include "argument.h"
+#include "localmemtransformer.h"
+#include "registertiler.h"
+#include "vectorizer.h"
+#include "temporalblocker.h"
+#include "boundryguardinserter.h"
+#include "constantmemtransformer.h"
+#include "loopunroller.h"
+#include "fastwrappergenerator.h"
+#include "filehandler.h"
+#include "indexchanger.h"
+#include "astutil.h"
+#include "astindex.h"
+#include "uniquenamegenerator.h"
+#include "passtimer.h"
+
+#include <fstream>
+#include <cstdio>
+#include <climits>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+VariantGenerator::VariantGenerator(SgProject *project, KernelInfo kernelInfo, Settings settings, Rose_STL_Container<string> fileNames) : project(project), kernelInfo(kernelInfo), settings(settings), fileNames(fileNames)
+{
+    snapshot = NULL;
+}
+
+
+// The transformations modify the AST in place. To generate several variants from one
+// frontend run, we keep deep copies of the analyzed declarations, and swap them back in
+// before each variant is generated.
+void VariantGenerator::takeSnapshot()
+{
+    snapshot = new map<SgGlobal*, vector<SgDeclarationStatement*>*>();
+
+    for(SgFile* file : project->get_fileList()){
+        SgSourceFile* sourceFile = isSgSourceFile(file);
+        if(!sourceFile){
+            continue;
+        }
+
+        SgGlobal* global = sourceFile->get_globalScope();
+        vector<SgDeclarationStatement*>* copies = new vector<SgDeclarationStatement*>();
+
+        for(SgDeclarationStatement* declaration : global->get_declarations()){
+            if(AstUtil::isFromInputFile(declaration, file)){
+                copies->push_back(isSgDeclarationStatement(copyStatement(declaration)));
+            }
+        }
+
+        snapshot->insert(make_pair(global, copies));
+    }
+}
+
+void VariantGenerator::restoreSnapshot()
+{
+    if(snapshot == NULL){
+        cerr << "ERROR: Trying to restore AST without snapshot. Exiting..." << endl;
+        exit(-1);
+    }
+
+    for(pair<SgGlobal*, vector<SgDeclarationStatement*>*> globalEntry : *snapshot){
+        SgGlobal* global = globalEntry.first;
+        SgFile* file = getEnclosingFileNode(global);
+
+        SgDeclarationStatementPtrList declarations = global->get_declarations();
+        for(SgDeclarationStatement* declaration : declarations){
+            if(AstUtil::isFromInputFile(declaration, file)){
+                removeStatement(declaration);
+            }
+        }
+
+        for(SgDeclarationStatement* declaration : *(globalEntry.second)){
+            appendStatement(copyStatement(declaration), global);
+        }
+    }
+    AstIndex::getInstance()->invalidate();
+
+    fixVariableReferences(project);
+    AstUtil::fixUniqueNameAttributes(project);
+}
+
+
+void VariantGenerator::patchAst()
+{
+    Rose_STL_Container<SgNode*> varRefs = AstIndex::getInstance()->query(project, V_SgVarRefExp);
+    //This has to be the ugliest hack ever, somehow needed to fix AST due to template types for image arrays
+    //Should be moved to a separate function or something
+    for(SgNode* node : varRefs){
+        SgVarRefExp* varRef = isSgVarRefExp(node);
+
+        if(varRef->get_symbol()->get_name() == "idx"){
+            //cout << varRef->get_symbol()->get_name() << endl;
+
+            SgScopeStatement* scope = getEnclosingScope(varRef);
+            SgVarRefExp* newVarRef = buildVarRefExp("idx", scope);
+
+            replaceExpression(varRef, newVarRef);
+        }
+        else if(varRef->get_symbol()->get_name() == "idy"){
+            //cout << varRef->get_symbol()->get_name() << endl;
+
+            SgScopeStatement* scope = getEnclosingScope(varRef);
+            SgVarRefExp* newVarRef = buildVarRefExp("idy", scope);
+
+            replaceExpression(varRef, newVarRef);
+        }
+    }
+
+    Rose_STL_Container<SgNode*> tempDecl = AstIndex::getInstance()->query(project, V_SgTemplateTypedefDeclaration);
+
+    for(SgNode* node : tempDecl){
+        SgTemplateTypedefDeclaration* temptypdef = isSgTemplateTypedefDeclaration(node);
+        removeStatement(temptypdef);
+    }
+}
+
+
+vector<Argument>* VariantGenerator::transform(Parameters params, Settings variantSettings)
+{
+    PassTimer* timer = PassTimer::getInstance();
+
+    // Every pass changes the AST, so the index is invalidated after each of them
+    AstIndex* index = AstIndex::getInstance();
+
+    timer->begin("LoopUnroller");
+    LoopUnroller loopUnroller(project, params, kernelInfo);
+    loopUnroller.traverseInputFiles(project, postorder);
+    loopUnroller.unrollLoops();
+    index->invalidate();
+    timer->end();
+
+    timer->begin("GlobalVariableRemover");
+    GlobalVariableRemover globalVarRemover;
+    globalVarRemover.traverseInputFiles(project, preorder);
+    index->invalidate();
+    timer->end();
+
+    timer->begin("NaiveCoarsener");
+    NaiveCoarsener naiveCoarsener(params, kernelInfo, variantSettings);
+    naiveCoarsener.traverseInputFiles(project, preorder);
+    fixVariableReferences(project);
+    index->invalidate();
+    timer->end();
+
+    if(params.registerTiling){
+        timer->begin("RegisterTiler");
+        RegisterTiler registerTiler(project, params, kernelInfo, variantSettings, naiveCoarsener.getOriginalFunctionBody());
+        registerTiler.transform();
+        index->invalidate();
+        timer->end();
+    }
+
+    if(params.vectorize){
+        timer->begin("Vectorizer");
+        Vectorizer vectorizer(project, params, kernelInfo, variantSettings, naiveCoarsener.getOriginalFunctionBody());
+        vectorizer.transform();
+        index->invalidate();
+        timer->end();
+    }
+
+    if(params.temporalSteps > 1){
+        timer->begin("TemporalBlocker");
+        TemporalBlocker temporalBlocker(project, params, kernelInfo, variantSettings, naiveCoarsener.getOriginalFunctionBody());
+        temporalBlocker.transform();
+        index->invalidate();
+        timer->end();
+    }
+
+    if(params.useLocalMem()){
+        timer->begin("LocalMemTransformer");
+        LocalMemTransformer localMemTransformer(project, params, kernelInfo, variantSettings, naiveCoarsener.getOriginalFunctionBody());
+        localMemTransformer.transform();
+        index->invalidate();
+        timer->end();
+    }
+
+    IndexChanger indexChanger(kernelInfo, params, variantSettings);
+    if(variantSettings.generateMPI || variantSettings.generateOMP){
+        timer->begin("IndexChanger");
+        indexChanger.replaceIndices(project);
+        index->invalidate();
+        timer->end();
+    }
+
+    timer->begin("BoundryGuardInserter");
+    BoundryGuardInserter boundryGuardInserter(kernelInfo, params, project, variantSettings, naiveCoarsener.getOriginalFunctionBody());
+    boundryGuardInserter.insertBoundryGuards();
+    index->invalidate();
+    timer->end();
+
+    if(variantSettings.generateMPI || variantSettings.generateOMP){
+        timer->begin("IndexChanger paddings");
+        indexChanger.addPaddings(project);
+        index->invalidate();
+        timer->end();
+    }
+
+    if(params.useImageMem()){
+        timer->begin("ImageMemTransformer");
+        ImageMemTransformer imageMemTransformer(project, params, kernelInfo, variantSettings);
+        imageMemTransformer.transform();
+        index->invalidate();
+        timer->end();
+    }
+
+    timer->begin("ArrayFlattener");
+    ArrayFlattener arrayFlattener(project, params, kernelInfo, variantSettings);
+    arrayFlattener.transform();
+    index->invalidate();
+    timer->end();
+
+
+    if(params.useConstantMem()){
+        timer->begin("ConstantMemTransformer");
+        ConstantMemTransformer constantMemTransformer(project, kernelInfo, params);
+        constantMemTransformer.transform();
+        index->invalidate();
+        timer->end();
+    }
+
+    timer->begin("KernelFinder");
+    KernelFinder kernelFinder(project, params, kernelInfo);
+    kernelFinder.transform();
+    index->invalidate();
+    timer->end();
+
+    timer->begin("ArgumentHandler");
+    ArgumentHandler argumentHandler(project, kernelInfo, params, variantSettings);
+    vector<Argument>* arguments = argumentHandler.addAndGetArguments();
+    index->invalidate();
+    timer->end();
+
+    timer->begin("Patch AST");
+    patchAst();
+    index->invalidate();
+    timer->end();
+
+    if(variantSettings.generateStandalone){
+        timer->begin("WrapperGenerator");
+        WrapperGenerator wrapperGenerator(variantSettings.inputBaseName + "_wrapper.c",arguments,params,kernelInfo, variantSettings);
+        wrapperGenerator.generate();
+        timer->end();
+    }
+    if(variantSettings.generateFAST){
+        timer->begin("FASTWrapperGenerator");
+        FASTWrapperGenerator fastWrapperGenerator("FastWrapper", arguments, params, kernelInfo);
+        fastWrapperGenerator.generate();
+        timer->end();
+    }
+
+    return arguments;
+}
+
+
+vector<Argument>* VariantGenerator::generate(Parameters params, string baseName)
+{
+    Settings variantSettings = settings;
+    variantSettings.inputBaseName = baseName;
+
+    return generate(params, variantSettings);
+}
+
+
+vector<Argument>* VariantGenerator::generate(Parameters params, Settings variantSettings)
+{
+    // Generated names should only depend on the variant, not on what was generated before it
+    UniqueNameGenerator::getInstance()->reset();
+
+    PassTimer* timer = PassTimer::getInstance();
+
+    timer->begin("Transform");
+    vector<Argument>* arguments = transform(params, variantSettings);
+    timer->end();
+
+    timer->begin("Unparse");
+    // The kernel is written directly to its final name, so that variants generated
+    // concurrently do not overwrite each other
+    FileHandler::setOutputFileNames(project, variantSettings.inputBaseName, variantSettings);
+    project->unparse();
+    timer->end();
+
+    if(variantSettings.generateStandalone){
+        timer->begin("Format wrapper");
+        FileHandler::indentWrapper(variantSettings);
+        timer->end();
+    }
+
+    return arguments;
+}
+
+
+string VariantGenerator::getVariantBaseName(int variant)
+{
+    return settings.inputBaseName + "_" + to_string(variant);
+}
+
+
+KernelInfo VariantGenerator::getKernelInfo()
+{
+    return kernelInfo;
+}
+
+
+void VariantGenerator::prepareParameters(Parameters& params)
+{
+    params.setParametersFromPragmas(kernelInfo.getPragmas());
+    params.validateParameters(kernelInfo);
+    params.printParameters();
+}
+
+
+int VariantGenerator::getNumberOfWorkers(int nVariants)
+{
+    int nWorkers = settings.nWorkers;
+    if(nWorkers == 0){
+        nWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if(nWorkers > nVariants){
+        nWorkers = nVariants;
+    }
+    if(nWorkers < 1){
+        nWorkers = 1;
+    }
+    return nWorkers;
+}
+
+
+void VariantGenerator::generateAll(vector<Parameters>* parameterSets)
+{
+    vector<int> status(parameterSets->size(), -1);
+
+    // Pragmas override the configurations. They are applied before the variants are generated,
+    // rather than only in the workers, so that the manifest lists the parameters actually used.
+    for(Parameters& variantParams : *parameterSets){
+        variantParams.setParametersFromPragmas(kernelInfo.getPragmas());
+    }
+
+    if(getNumberOfWorkers(parameterSets->size()) == 1){
+        generateSequential(parameterSets, status);
+    }
+    else{
+        generateParallel(parameterSets, status);
+    }
+
+    writeManifest(parameterSets, status);
+}
+
+
+// Invalid parameter sets are skipped, and marked as failed in the manifest, as a worker
+// exiting on them would be in generateParallel
+void VariantGenerator::generateSequential(vector<Parameters>* parameterSets, vector<int>& status)
+{
+    takeSnapshot();
+
+    for(int i = 0; i < parameterSets->size(); i++){
+        Parameters variantParams = parameterSets->at(i);
+        variantParams.setParametersFromPragmas(kernelInfo.getPragmas());
+
+        string error;
+        if(!variantParams.checkParameters(kernelInfo, error)){
+            cout << "WARNING: Skipping variant " << i << ": " << error << endl;
+            status[i] = -1;
+            continue;
+        }
+        variantParams.printParameters();
+
+        restoreSnapshot();
+        generate(variantParams, getVariantBaseName(i));
+        status[i] = 0;
+    }
+}
+
+
+// Each variant is generated in its own forked process. The children inherit the analyzed
+// AST copy-on-write, so no snapshot is needed, and a variant that crashes the transformations
+// only loses itself. Output of each child is redirected to <base>_<i>.log.
+void VariantGenerator::generateParallel(vector<Parameters>* parameterSets, vector<int>& status)
+{
+    int nWorkers = getNumberOfWorkers(parameterSets->size());
+    cout << "Generating " << parameterSets->size() << " variants using " << nWorkers << " workers" << endl;
+
+    map<pid_t, int> running;
+    int next = 0;
+
+    while(next < parameterSets->size() || !running.empty()){
+        while(next < parameterSets->size() && running.size() < nWorkers){
+            cout.flush();
+            fflush(stdout);
+
+            pid_t pid = fork();
+
+            if(pid == 0){
+                string baseName = getVariantBaseName(next);
+                if(freopen((baseName + ".log").c_str(), "w", stdout) == NULL){
+                    cerr << "WARNING: Could not open log file for variant " << next << endl;
+                }
+
+                Parameters variantParams = parameterSets->at(next);
+                prepareParameters(variantParams);
+                generate(variantParams, baseName);
+
+                cout.flush();
+                fflush(stdout);
+                _exit(0);
+            }
+
+            if(pid < 0){
+                cerr << "WARNING: Could not fork worker for variant " << next << endl;
+            }
+            else{
+                running.insert(make_pair(pid, next));
+            }
+            next++;
+        }
+
+        if(running.empty()){
+            continue;
+        }
+
+        int childStatus;
+        pid_t pid = wait(&childStatus);
+        if(pid < 0){
+            cerr << "ERROR: Lost track of variant workers. Exiting..." << endl;
+            exit(-1);
+        }
+
+        auto child = running.find(pid);
+        if(child == running.end()){
+            continue;
+        }
+
+        int variant = child->second;
+        running.erase(child);
+
+        if(WIFEXITED(childStatus) && WEXITSTATUS(childStatus) == 0){
+            status[variant] = 0;
+        }
+        else{
+            cout << "WARNING: Generation of variant " << variant << " failed, see " << getVariantBaseName(variant) << ".log" << endl;
+        }
+    }
+}
+
+
+// The manifest lists the variants in the order of the parameter sets, independently of the
+// order in which the workers finished, together with the configuration used for each
+void VariantGenerator::writeManifest(vector<Parameters>* parameterSets, vector<int>& status)
+{
+    string extension = settings.generateCl ? ".cl" : ".c";
+
+    ofstream manifest(settings.inputBaseName + "_manifest.txt");
+
+    for(int i = 0; i < parameterSets->size(); i++){
+        string baseName = getVariantBaseName(i);
+
+        manifest << "VARIANT:" << i << endl;
+        manifest << "STATUS:" << (status[i] == 0 ? "OK" : "FAILED") << endl;
+        manifest << "KERNEL:" << baseName << extension << endl;
+        if(settings.generateStandalone){
+            manifest << "WRAPPER:" << baseName << "_wrapper.c" << endl;
+        }
+        parameterSets->at(i).writeParametersToStream(manifest);
+        manifest << endl;
+    }
+
+    manifest.close();
+}
+
+
+// Generates one kernel per size class, <base>_sc<i>.cl, and a single wrapper, where
+// process_sc<i>() runs variant i, and process() selects the variant by the image size.
+// The parameter sets must be sorted by maxPixels, with LLONG_MAX for sets without MAX_PIXELS.
+void VariantGenerator::generateDispatch(vector<Parameters>* parameterSets, vector<long long> maxPixels)
+{
+    if(settings.generateMPI || settings.generateOMP){
+        cerr << "ERROR: Size dispatch is not supported with MPI or OpenMP. Exiting..." << endl;
+        exit(-1);
+    }
+
+    // Only the last of several sets without MAX_PIXELS could ever be selected
+    if(count(maxPixels.begin(), maxPixels.end(), LLONG_MAX) > 1){
+        cerr << "ERROR: More than one parameter set in dispatch_config.txt has no MAX_PIXELS. Exiting..." << endl;
+        exit(-1);
+    }
+
+    takeSnapshot();
+
+    string wrapperFileName = settings.inputBaseName + "_wrapper.c";
+    vector<string> functionNames;
+    vector<Argument>* arguments = NULL;
+
+    for(int i = 0; i < parameterSets->size(); i++){
+        Parameters variantParams = parameterSets->at(i);
+        prepareParameters(variantParams);
+
+        Settings variantSettings = settings;
+        variantSettings.inputBaseName = settings.inputBaseName + "_sc" + to_string(i);
+        variantSettings.generateStandalone = false;
+
+        restoreSnapshot();
+        arguments = generate(variantParams, variantSettings);
+
+        WrapperGenerator wrapperGenerator(wrapperFileName, arguments, variantParams, kernelInfo, variantSettings);
+        if(i == 0){
+            wrapperGenerator.generateHeader();
+        }
+        functionNames.push_back("process_sc" + to_string(i));
+        wrapperGenerator.generateFunction(functionNames.back());
+    }
+
+    // The arguments of process() are the same for all the variants
+    WrapperGenerator dispatcher(wrapperFileName, arguments, parameterSets->back(), kernelInfo, settings);
+    dispatcher.generateDispatcher(functionNames, maxPixels);
+
+    FileHandler::indentWrapper(settings);
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef VARIANTGENERATOR_H
+#define VARIANTGENERATOR_H
+
+#include "rose.h"
+
+#include "kernelinfo.h"
+#include "parameters.h"
+#include "settings.h"
+#include "argument.h"
+
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+class VariantGenerator
+{
+public:
+    VariantGenerator(SgProject* project, KernelInfo kernelInfo, Settings settings, Rose_STL_Container<string> fileNames);
+
+    void takeSnapshot();
+    void restoreSnapshot();
+
+    vector<Argument>* transform(Parameters params, Settings variantSettings);
+    vector<Argument>* generate(Parameters params, string baseName);
+    vector<Argument>* generate(Parameters params, Settings variantSettings);
+    void generateAll(vector<Parameters>* parameterSets);
+    void generateDispatch(vector<Parameters>* parameterSets, vector<long long> maxPixels);
+
+    string getVariantBaseName(int variant);
+    KernelInfo getKernelInfo();
+
+private:
+    void patchAst();
+    void prepareParameters(Parameters& params);
+    int getNumberOfWorkers(int nVariants);
+    void generateSequential(vector<Parameters>* parameterSets, vector<int>& status);
+    void generateParallel(vector<Parameters>* parameterSets, vector<int>& status);
+    void writeManifest(vector<Parameters>* parameterSets, vector<int>& status);
+
+    SgProject* project;
+    KernelInfo kernelInfo;
+    Settings settings;
+    Rose_STL_Container<string> fileNames;
+
+    // Pristine copies of the declarations of each input file, taken after analysis
+    map<SgGlobal*, vector<SgDeclarationStatement*>*>* snapshot;
+};
+
+#endif // VARIANTGENERATOR_H
@@ -0,0 +1,396 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#include "vectorizer.h"
+
+#include "astutil.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace SageBuilder;
+using namespace SageInterface;
+
+// Built-in functions that are defined element-wise for floatN
+const set<string> vectorFunctions = {"sqrt", "rsqrt", "fabs", "exp", "log", "sin", "cos", "tan", "floor", "ceil", "fmin", "fmax",
+                                     "native_sqrt", "native_rsqrt", "native_exp", "native_log", "native_sin", "native_cos"};
+
+// Element type names of OpenCL vector types
+string vectorElementName(BaseType baseType)
+{
+    switch(baseType){
+    case FLOAT:
+        return "float";
+    case INT:
+        return "int";
+    case UCHAR:
+        return "uchar";
+    case CHAR:
+        return "char";
+    default:
+        return "";
+    }
+}
+
+
+Vectorizer::Vectorizer(SgProject *project, Parameters params, KernelInfo kernelInfo, Settings settings, SgBasicBlock *loopBody) : project(project), params(params), kernelInfo(kernelInfo), settings(settings), loopBody(loopBody)
+{
+    width = params.elementsPerThreadX;
+}
+
+
+void Vectorizer::transform()
+{
+    bool validWidth = width == 2 || width == 4 || width == 8 || width == 16;
+    if(!validWidth || params.interleaved || params.useLocalMem() || params.useImageMem() || params.registerTiling || settings.generateMPI || settings.generateOMP){
+        cout << "WARNING: VECTORIZE needs INTERLEAVED:0 and ELEMENTS_PER_THREAD_X of 2, 4, 8 or 16, and can not be used with local memory, image memory, register tiling, MPI or OpenMP. It is ignored" << endl;
+        return;
+    }
+
+    // The body of the kernel starts after the GS_X/GS_Y test of the NaiveCoarsener
+    SgStatementPtrList statements = loopBody->get_statements();
+    int first = 0;
+    while(first < statements.size()){
+        SgIfStmt* ifStmt = isSgIfStmt(statements[first++]);
+        if(ifStmt && isSgContinueStmt(ifStmt->get_true_body())){
+            break;
+        }
+    }
+
+    bool vectorizable = first < statements.size();
+    for(int i = first; i < statements.size() && vectorizable; i++){
+        vectorizable = isVectorizable(statements[i]);
+    }
+    for(string image : writtenImages){
+        if(readOffsetsX.count(image) == 1){
+            reason = image + " is both read and written";
+            vectorizable = false;
+        }
+    }
+    if(vectorizable && writtenImages.empty()){
+        reason = "no image is written";
+        vectorizable = false;
+    }
+    if(!vectorizable){
+        cout << "[Vectorizer] not vectorizing: " << reason << endl;
+        return;
+    }
+
+    SgForStatement* innerLoop = isSgForStatement(loopBody->get_parent());
+    SgScopeStatement* rowScope = getEnclosingScope(innerLoop);
+
+    SgFunctionCallExp* getGlobalIdx = buildFunctionCallExp("get_global_id", buildIntType(), buildExprListExp(buildIntVal(0)), rowScope);
+    SgAssignInitializer* rowX = buildAssignInitializer(buildMultiplyOp(getGlobalIdx, buildIntVal(width)));
+    insertStatementBefore(innerLoop, buildVariableDeclaration("vec_idx", buildIntType(), rowX, rowScope));
+
+    SgFunctionCallExp* getGlobalIdy = buildFunctionCallExp("get_global_id", buildIntType(), buildExprListExp(buildIntVal(1)), rowScope);
+    SgExpression* rowYExpression = buildAddOp(buildMultiplyOp(getGlobalIdy, buildIntVal(params.elementsPerThreadY)), buildVarRefExp("coars_y", rowScope));
+    insertStatementBefore(innerLoop, buildVariableDeclaration("vec_idy", buildIntType(), buildAssignInitializer(rowYExpression), rowScope));
+
+    SgBasicBlock* vectorBody = isSgBasicBlock(copyStatement(loopBody));
+    SgBasicBlock* scalarBody = buildBasicBlock();
+    SgIfStmt* split = buildIfStmt(buildVectorTest(rowScope), vectorBody, scalarBody);
+    insertStatementBefore(innerLoop, split);
+    removeStatement(innerLoop);
+    appendStatement(innerLoop, scalarBody);
+
+    SgStatementPtrList copiedStatements = vectorBody->get_statements();
+    for(int i = 0; i < first; i++){
+        removeStatement(copiedStatements[i]);
+    }
+    vectorBody->prepend_statement(buildVariableDeclaration("idy", buildIntType(), buildAssignInitializer(buildVarRefExp("vec_idy", rowScope)), vectorBody));
+    vectorBody->prepend_statement(buildVariableDeclaration("idx", buildIntType(), buildAssignInitializer(buildVarRefExp("vec_idx", rowScope)), vectorBody));
+
+    // Local variables in the copy are looked up again, to refer to the copied declarations
+    Rose_STL_Container<SgNode*> varRefNodes = NodeQuery::querySubTree(vectorBody, V_SgVarRefExp);
+    for(SgNode* n : varRefNodes){
+        SgVarRefExp* varRef = isSgVarRefExp(n);
+        if(isAncestor(loopBody, varRef->get_symbol()->get_declaration())){
+            replaceExpression(varRef, buildVarRefExp(varRef->get_symbol()->get_name(), getScope(varRef)));
+        }
+    }
+
+    vectorize(vectorBody);
+
+    cout << "[Vectorizer] vectorized x with width " << width << endl;
+}
+
+
+bool Vectorizer::isVectorizable(SgStatement *statement)
+{
+    if(isSgNullStatement(statement)){
+        return true;
+    }
+
+    SgVariableDeclaration* declaration = isSgVariableDeclaration(statement);
+    if(declaration){
+        if(declaration->get_variables().size() != 1){
+            reason = "declaration of several variables";
+            return false;
+        }
+
+        SgInitializedName* variable = declaration->get_variables()[0];
+        if(!isSgTypeFloat(variable->get_type())){
+            reason = variable->get_name().getString() + " is not a float";
+            return false;
+        }
+        vectorVariables.insert(variable->get_name().getString());
+
+        if(variable->get_initializer() == NULL){
+            return true;
+        }
+        SgAssignInitializer* initializer = isSgAssignInitializer(variable->get_initializer());
+        if(!initializer){
+            reason = "unsupported initializer of " + variable->get_name().getString();
+            return false;
+        }
+        return isVectorizable(initializer->get_operand());
+    }
+
+    SgExprStatement* exprStatement = isSgExprStatement(statement);
+    if(exprStatement){
+        SgExpression* expression = exprStatement->get_expression();
+        bool isAssignment = isSgAssignOp(expression) || isSgPlusAssignOp(expression) || isSgMinusAssignOp(expression) ||
+                            isSgMultAssignOp(expression) || isSgDivAssignOp(expression);
+        if(!isAssignment){
+            reason = "statement other than an assignment";
+            return false;
+        }
+
+        SgBinaryOp* assignment = isSgBinaryOp(expression);
+        SgVarRefExp* variable = isSgVarRefExp(assignment->get_lhs_operand());
+        if(variable && vectorVariables.count(variable->get_symbol()->get_name().getString()) == 1){
+            return isVectorizable(assignment->get_rhs_operand());
+        }
+
+        SgPntrArrRefExp* arrRef = isSgPntrArrRefExp(assignment->get_lhs_operand());
+        if(arrRef && isSgAssignOp(expression) && isSgPntrArrRefExp(arrRef->get_lhs_operand())){
+            string image = AstUtil::getArrayName(arrRef);
+            int offsetX, offsetY;
+            bool atThread = isIndexWithOffset(isSgPntrArrRefExp(arrRef->get_lhs_operand())->get_rhs_operand(), "idx", &offsetX) &&
+                            isIndexWithOffset(arrRef->get_rhs_operand(), "idy", &offsetY) && offsetX == 0 && offsetY == 0;
+            if(!kernelInfo.isImageArray(image) || !atThread){
+                reason = "write other than image[idx][idy]";
+                return false;
+            }
+            if(vectorElementName(kernelInfo.getPixelType(image)).empty()){
+                reason = "unsupported pixel type of " + image;
+                return false;
+            }
+            writtenImages.insert(image);
+            return isVectorizable(assignment->get_rhs_operand());
+        }
+
+        reason = "unsupported assignment";
+        return false;
+    }
+
+    reason = "unsupported statement " + statement->class_name();
+    return false;
+}
+
+
+bool Vectorizer::isVectorizable(SgExpression *expression)
+{
+    if(isSgFloatVal(expression) || isSgIntVal(expression)){
+        return true;
+    }
+
+    // Mixing double with floatN needs cl_khr_fp64, and would not be computed in float
+    if(isSgDoubleVal(expression)){
+        reason = "double constant, write it as a float constant";
+        return false;
+    }
+
+    if(isSgAddOp(expression) || isSgSubtractOp(expression) || isSgMultiplyOp(expression) || isSgDivideOp(expression)){
+        SgBinaryOp* binaryOp = isSgBinaryOp(expression);
+        return isVectorizable(binaryOp->get_lhs_operand()) && isVectorizable(binaryOp->get_rhs_operand());
+    }
+
+    if(isSgMinusOp(expression) || isSgUnaryAddOp(expression)){
+        return isVectorizable(isSgUnaryOp(expression)->get_operand());
+    }
+
+    SgVarRefExp* varRef = isSgVarRefExp(expression);
+    if(varRef){
+        string name = varRef->get_symbol()->get_name().getString();
+        if(name == "idx"){
+            reason = "idx is used other than in an image index";
+            return false;
+        }
+        if(kernelInfo.isImageArray(name)){
+            reason = "image " + name + " is used other than by indexing";
+            return false;
+        }
+
+        // Only values which are the same for all the elements of the row can be used as
+        // scalars. Other variables, such as coars_x, differ between the lanes.
+        bool isArgument = isSgFunctionParameterList(varRef->get_symbol()->get_declaration()->get_parent());
+        if(name != "idy" && vectorVariables.count(name) == 0 && !isArgument){
+            reason = name + " may differ between the elements of the row";
+            return false;
+        }
+        return true;
+    }
+
+    SgPntrArrRefExp* arrRef = isSgPntrArrRefExp(expression);
+    if(arrRef){
+        string image = AstUtil::getArrayName(arrRef);
+        SgPntrArrRefExp* middle = isSgPntrArrRefExp(arrRef->get_lhs_operand());
+        int offsetX, offsetY;
+        if(!kernelInfo.isImageArray(image) || !middle || !isIndexWithOffset(middle->get_rhs_operand(), "idx", &offsetX) ||
+           !isIndexWithOffset(arrRef->get_rhs_operand(), "idy", &offsetY)){
+            reason = "read other than image[idx + c][idy + c]";
+            return false;
+        }
+
+        if(vectorElementName(kernelInfo.getPixelType(image)).empty()){
+            reason = "unsupported pixel type of " + image;
+            return false;
+        }
+
+        if(readOffsetsX.count(image) == 0){
+            readOffsetsX[image] = make_pair(offsetX, offsetX);
+            readOffsetsY[image] = make_pair(offsetY, offsetY);
+        }
+        readOffsetsX[image] = make_pair(min(readOffsetsX[image].first, offsetX), max(readOffsetsX[image].second, offsetX));
+        readOffsetsY[image] = make_pair(min(readOffsetsY[image].first, offsetY), max(readOffsetsY[image].second, offsetY));
+        return true;
+    }
+
+    SgFunctionCallExp* call = isSgFunctionCallExp(expression);
+    if(call && isSgFunctionRefExp(call->get_function())){
+        string name = isSgFunctionRefExp(call->get_function())->get_symbol()->get_name().getString();
+        if(vectorFunctions.count(name) == 0){
+            reason = "call to " + name;
+            return false;
+        }
+        for(SgExpression* argument : call->get_args()->get_expressions()){
+            if(!isVectorizable(argument)){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    reason = "unsupported expression " + expression->class_name();
+    return false;
+}
+
+
+// index, index + c or index - c, for an integer constant c
+bool Vectorizer::isIndexWithOffset(SgExpression *expression, string index, int *offset)
+{
+    SgVarRefExp* varRef = isSgVarRefExp(expression);
+    if(varRef){
+        *offset = 0;
+        return varRef->get_symbol()->get_name().getString() == index;
+    }
+
+    SgBinaryOp* binaryOp = isSgBinaryOp(expression);
+    if(!(isSgAddOp(expression) || isSgSubtractOp(expression))){
+        return false;
+    }
+
+    SgVarRefExp* lhs = isSgVarRefExp(binaryOp->get_lhs_operand());
+    SgIntVal* rhs = isSgIntVal(binaryOp->get_rhs_operand());
+    if(!lhs || !rhs || lhs->get_symbol()->get_name().getString() != index){
+        return false;
+    }
+
+    *offset = isSgAddOp(expression) ? rhs->get_value() : -rhs->get_value();
+    return true;
+}
+
+
+// The row is vectorized if all its elements are inside the grid, and all reads are inside the images
+SgExpression* Vectorizer::buildVectorTest(SgScopeStatement *scope)
+{
+    SgExpression* rowEnd = buildAddOp(buildVarRefExp("vec_idx", scope), buildIntVal(width - 1));
+    SgExpression* test = buildAndOp(buildLessThanOp(rowEnd, buildOpaqueVarRefExp("GS_X", scope)), buildLessThanOp(buildVarRefExp("vec_idy", scope), buildOpaqueVarRefExp("GS_Y", scope)));
+
+    for(pair<string, pair<int,int>> read : readOffsetsX){
+        string image = read.first;
+        pair<int,int> offsetsY = readOffsetsY[image];
+
+        SgExpression* minX = buildAddOp(buildVarRefExp("vec_idx", scope), buildIntVal(read.second.first));
+        SgExpression* maxX = buildAddOp(buildVarRefExp("vec_idx", scope), buildIntVal(width - 1 + read.second.second));
+        SgExpression* minY = buildAddOp(buildVarRefExp("vec_idy", scope), buildIntVal(offsetsY.first));
+        SgExpression* maxY = buildAddOp(buildVarRefExp("vec_idy", scope), buildIntVal(offsetsY.second));
+
+        SgExpression* inX = buildAndOp(buildGreaterOrEqualOp(minX, buildIntVal(0)), buildLessThanOp(maxX, buildOpaqueVarRefExp(image + "_width", scope)));
+        SgExpression* inY = buildAndOp(buildGreaterOrEqualOp(minY, buildIntVal(0)), buildLessThanOp(maxY, buildOpaqueVarRefExp(image + "_height", scope)));
+        test = buildAndOp(test, buildAndOp(inX, inY));
+    }
+
+    return test;
+}
+
+
+// Locals become floatN, reads become vloadN and writes vstoreN, converting other pixel types
+// to and from float
+void Vectorizer::vectorize(SgBasicBlock *body)
+{
+    string n = to_string(width);
+
+    Rose_STL_Container<SgNode*> declarationNodes = NodeQuery::querySubTree(body, V_SgVariableDeclaration);
+    for(SgNode* node : declarationNodes){
+        SgInitializedName* variable = isSgVariableDeclaration(node)->get_variables()[0];
+        if(vectorVariables.count(variable->get_name().getString()) == 1){
+            variable->set_type(buildVectorType("float", body));
+        }
+    }
+
+    Rose_STL_Container<SgNode*> arrRefNodes = NodeQuery::querySubTree(body, V_SgPntrArrRefExp);
+    for(SgNode* node : arrRefNodes){
+        SgPntrArrRefExp* arrRef = isSgPntrArrRefExp(node);
+        if(isSgPntrArrRefExp(arrRef->get_parent())){
+            continue;
+        }
+
+        string image = AstUtil::getArrayName(arrRef);
+        if(readOffsetsX.count(image) == 0){
+            continue;
+        }
+
+        SgScopeStatement* scope = getScope(arrRef);
+        SgExpression* temp = buildIntVal(0);
+        replaceExpression(arrRef, temp, true);
+
+        SgExpression* load = buildFunctionCallExp("vload" + n, buildVectorType(vectorElementName(kernelInfo.getPixelType(image)), scope),
+                                                  buildExprListExp(buildIntVal(0), buildAddressOfOp(arrRef)), scope);
+        if(kernelInfo.getPixelType(image) != FLOAT){
+            load = buildFunctionCallExp("convert_float" + n, buildVectorType("float", scope), buildExprListExp(load), scope);
+        }
+        replaceExpression(temp, load);
+    }
+
+    for(SgStatement* statement : body->get_statements()){
+        SgExprStatement* exprStatement = isSgExprStatement(statement);
+        SgAssignOp* assignOp = exprStatement ? isSgAssignOp(exprStatement->get_expression()) : NULL;
+        if(!assignOp || !isSgPntrArrRefExp(assignOp->get_lhs_operand())){
+            continue;
+        }
+
+        string image = AstUtil::getArrayName(isSgPntrArrRefExp(assignOp->get_lhs_operand()));
+        SgExpression* value = buildCastExp(copyExpression(assignOp->get_rhs_operand()), buildVectorType("float", body));
+        if(kernelInfo.getPixelType(image) != FLOAT){
+            string type = vectorElementName(kernelInfo.getPixelType(image));
+            value = buildFunctionCallExp("convert_" + type + n, buildVectorType(type, body), buildExprListExp(value), body);
+        }
+
+        SgExpression* address = buildAddressOfOp(copyExpression(assignOp->get_lhs_operand()));
+        SgFunctionCallExp* store = buildFunctionCallExp("vstore" + n, buildVoidType(), buildExprListExp(value, buildIntVal(0), address), body);
+        replaceStatement(statement, buildExprStatement(store));
+    }
+}
+
+
+SgType* Vectorizer::buildVectorType(string baseType, SgScopeStatement *scope)
+{
+    return buildOpaqueType(baseType + to_string(width), scope);
+}
@@ -0,0 +1,56 @@
+// Copyright (c) 2016, Thomas L. Falch
+// For conditions of distribution and use, see the accompanying LICENSE and README files
+
+// This file is part of the ImageCL source-to-source compiler
+// developed at the Norwegian University of Science and technology
+
+
+#ifndef VECTORIZER_H
+#define VECTORIZER_H
+
+#include "rose.h"
+#include "parameters.h"
+#include "kernelinfo.h"
+#include "settings.h"
+
+#include <string>
+#include <set>
+#include <map>
+
+using namespace std;
+
+// With non-interleaved coarsening of 2, 4, 8 or 16 elements in x, computes all the elements
+// of a row of a thread at once, with floatN arithmetic and vloadN/vstoreN, if the whole row
+// and its footprint is inside the images. Other rows use the scalar coarsening loop.
+// Only straight-line float code, reading images at constant offsets from the thread and
+// writing them at the thread position, is vectorized.
+class Vectorizer
+{
+public:
+    Vectorizer(SgProject* project, Parameters params, KernelInfo kernelInfo, Settings settings, SgBasicBlock* loopBody);
+    void transform();
+
+private:
+    bool isVectorizable(SgStatement* statement);
+    bool isVectorizable(SgExpression* expression);
+    bool isIndexWithOffset(SgExpression* expression, string index, int* offset);
+    void vectorize(SgBasicBlock* body);
+    SgExpression* buildVectorTest(SgScopeStatement* scope);
+    SgType* buildVectorType(string baseType, SgScopeStatement* scope);
+
+    SgProject* project;
+    Parameters params;
+    KernelInfo kernelInfo;
+    Settings settings;
+    SgBasicBlock* loopBody;
+
+    int width;
+    // Locals of the body, which become vectors, and the images read and written
+    set<string> vectorVariables;
+    map<string, pair<int,int>> readOffsetsX;
+    map<string, pair<int,int>> readOffsetsY;
+    set<string> writtenImages;
+    string reason;
+};
+
+#endif // VECTORIZER_H
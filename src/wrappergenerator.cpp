@@ -16,11 +16,13 @@
 #include "kernelinfo.h"
 #include "settings.h"
 #include "boundryguardinserter.h"
+#include "temporalblocker.h"
 
 using namespace std;
 
 const string WrapperGenerator::includeText = 
 "#include <stdio.h> \n"
+"#include <stdlib.h> \n"
 "#include <CL/cl.h> \n"
 "#include \"clutil.h\" \n\n";
 
@@ -55,6 +57,9 @@ WrapperGenerator::WrapperGenerator(string filename, vector<Argument>* arguments,
 }
 
 
+// Without OpenMP, the device, context and command queue are created by the first call,
+// and the kernel is built once for each grid size, see writePersistentState. With OpenMP,
+// each thread sets up its own device.
 void WrapperGenerator::writeOpenCLSetup()
 {
     file << "cl_int error;\n";
@@ -67,7 +72,10 @@ void WrapperGenerator::writeOpenCLSetup()
         file << "device = get_device_n(omp_get_thread_num());\n";
     }
     else{
-        file << "device = get_device_by_id(" << this->platformId << "," << this->deviceId << ");\n";
+        file << "process_init();\n";
+        file << "device = persistent_device;\n";
+        file << "context = persistent_context;\n";
+        file << "queue = persistent_queue;\n";
     }
     //file << "printDeviceInfo(device);\n";
 
@@ -85,18 +93,57 @@ void WrapperGenerator::writeOpenCLSetup()
     file << "char options[100];" << endl;
     file << "sprintf(options, \"-DGS_X=%d -DGS_Y=%d\", gridSize_x, gridSize_y);" << endl;
 
-    file << "context = clCreateContext(NULL, 1, &device, NULL, NULL, &error);\n";
-    file << "clError(\"Couldn't get context\", error);\n";
-    file << "queue = clCreateCommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE, &error);\n";
-    file << "clError(\"Couldn't create command queue\", error);\n";
     file << "char* kernelName = \"" << settings.inputBaseName << ".cl\";\n";
-    file << "kernel = buildKernel(kernelName, \"" << kernelInfo.getKernelName() << "\", options, context, device, &error);\n";
-    file << "clError(\"Couldn't compile\", error);\n";
-    file << "if(error != CL_SUCCESS){ clReleaseCommandQueue(queue); clReleaseContext(context); exit(-1);}";
+    if(settings.generateOMP){
+        file << "context = clCreateContext(NULL, 1, &device, NULL, NULL, &error);\n";
+        file << "clError(\"Couldn't get context\", error);\n";
+        file << "queue = clCreateCommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE, &error);\n";
+        file << "clError(\"Couldn't create command queue\", error);\n";
+        file << "kernel = buildKernel(kernelName, \"" << kernelInfo.getKernelName() << "\", options, context, device, &error);\n";
+        file << "clError(\"Couldn't compile\", error);\n";
+        file << "if(error != CL_SUCCESS){ clReleaseCommandQueue(queue); clReleaseContext(context); exit(-1);}";
+    }
+    else{
+        file << "kernel = getCachedKernel(kernelName, \"" << kernelInfo.getKernelName() << "\", options, context, device, &error);\n";
+        file << "clError(\"Couldn't compile\", error);\n";
+        file << "if(error != CL_SUCCESS){ process_release(); exit(-1);}";
+    }
     file << endl;
 }
 
 
+// The OpenCL state kept between calls, process_init(), which sets it up unless it already
+// is, and process_release(), which releases it. The next call after process_release() sets
+// it up again.
+void WrapperGenerator::writePersistentState()
+{
+    file << "static cl_device_id persistent_device;" << endl;
+    file << "static cl_context persistent_context = NULL;" << endl;
+    file << "static cl_command_queue persistent_queue;" << endl;
+    file << endl;
+    file << "static void process_init()\n{\n";
+    file << "if(persistent_context != NULL){" << endl;
+    file << "return;" << endl;
+    file << "}" << endl;
+    file << "cl_int error;" << endl;
+    file << "persistent_device = get_device_by_id(" << this->platformId << "," << this->deviceId << ");\n";
+    file << "persistent_context = clCreateContext(NULL, 1, &persistent_device, NULL, NULL, &error);\n";
+    file << "clError(\"Couldn't get context\", error);\n";
+    file << "persistent_queue = clCreateCommandQueue(persistent_context, persistent_device, CL_QUEUE_PROFILING_ENABLE, &error);\n";
+    file << "clError(\"Couldn't create command queue\", error);\n";
+    file << "}\n\n";
+    file << "void process_release()\n{\n";
+    file << "if(persistent_context == NULL){" << endl;
+    file << "return;" << endl;
+    file << "}" << endl;
+    file << "releaseCachedKernels(persistent_context);" << endl;
+    file << "clReleaseCommandQueue(persistent_queue);" << endl;
+    file << "clReleaseContext(persistent_context);" << endl;
+    file << "persistent_context = NULL;" << endl;
+    file << "}\n\n";
+}
+
+
 void WrapperGenerator::writeFunctionDeclarationArguments(bool ignoreOmpMpiArgs)
 {
 
@@ -108,7 +155,12 @@ void WrapperGenerator::writeFunctionDeclarationArguments(bool ignoreOmpMpiArgs)
             if(firstArgWritten)
                 file << ", ";
 
-            file << arg.unparse(kernelInfo.getPixelType(arg.name));
+            if(arg.name == residentImage){
+                file << "cl_mem " << arg.name << "_device";
+            }
+            else{
+                file << arg.unparse(kernelInfo.getPixelType(arg.name));
+            }
 
             file << ", int " << arg.name + "_width";
             file << ", int " << arg.name + "_height";
@@ -153,7 +205,7 @@ void WrapperGenerator::writeFunctionDeclarationArguments(bool ignoreOmpMpiArgs)
 
 void WrapperGenerator::writeFunctionDeclaration()
 {
-    file << "void process(";
+    file << "void " << functionName << "(";
 
     writeFunctionDeclarationArguments(true);
 
@@ -164,7 +216,7 @@ void WrapperGenerator::writeFunctionDeclaration()
 void WrapperGenerator::writeMpiBorderExchange(string argName)
 {
     //Send to north, receive from south
-    HaloSize hs = kernelInfo.getFootprintTable().at(argName).computeHaloSize();
+    HaloSize hs = kernelInfo.getHaloSize(argName);
     file << "MPI_Sendrecv(";
     file << "&" << argName << "_local[" << hs.left << " + local_" << argName << "_width_padded * " << hs.up << "],";
     file << "1," << argName << "_border_row_down,";
@@ -275,7 +327,7 @@ void WrapperGenerator::writeMpiLocalAllocation()
             file << "int local_" << arg.name << "_width = " << arg.name << "_width / dims_x;" << endl;
             file << "int local_" << arg.name << "_height = " << arg.name << "_height / dims_y;" << endl;
 
-            HaloSize hs = kernelInfo.getFootprintTable().at(arg.name).computeHaloSize();
+            HaloSize hs = kernelInfo.getHaloSize(arg.name);
             if(hs.getMax() > 0){
                 file << "int local_" << arg.name << "_width_padded = local_" << arg.name << "_width + " << hs.left + hs.right << ";" << endl;
                 file << "int local_" << arg.name << "_height_padded = local_" << arg.name << "_height + " << hs.up + hs.down << ";" << endl;
@@ -326,7 +378,7 @@ void WrapperGenerator::writeMpiTypeDeclaration(string argName)
                                   argName + "_width",
                                   Type::baseTypeToMpiString(kernelInfo.getPixelType(argName)));
 
-    HaloSize hs = kernelInfo.getFootprintTable().at(argName).computeHaloSize();
+    HaloSize hs = kernelInfo.getHaloSize(argName);
     if(hs.getMax() > 0){
 
         string typeName = Type::baseTypeToMpiString(kernelInfo.getPixelType(argName));
@@ -407,7 +459,7 @@ void WrapperGenerator::writeMpiDistribution()
 
         if(kernelInfo.needsMpiScatter(arg.name)){
 
-            HaloSize hs = kernelInfo.getFootprintTable().at(arg.name).computeHaloSize();
+            HaloSize hs = kernelInfo.getHaloSize(arg.name);
             writeMpiTypeDeclaration(arg.name);
 
             file << "MPI_Scatterv(";
@@ -446,6 +498,9 @@ void WrapperGenerator::writeProcessCall(string processName = "process")
                 file << ", ";
 
             file << arg.name;
+            if(arg.name == residentImage){
+                file << "_device";
+            }
 
             if(kernelInfo.needsMpiScatter(arg.name)){
                 file << "_local";
@@ -626,6 +681,10 @@ void WrapperGenerator::writeMemoryAllocations()
             }
         }
 
+        if(arg.name == residentImage){
+            continue;
+        }
+
         if(arg.type.pointerLevel > 0 && arg.type.baseType != IMAGE2D_T){
             file << "cl_mem " << arg.name << "_device = clCreateBuffer(context,";
             if(params.constantMemArrays->count(arg.name) == 1){
@@ -660,7 +719,7 @@ void WrapperGenerator::writeMemoryAllocations()
             file << "cl_image_desc image_desc_"<<arg.name<<";" << endl;
             file << "image_desc_"<<arg.name<<".image_type = CL_MEM_OBJECT_IMAGE2D;" << endl;
             if(settings.generateMPI && kernelInfo.needsMpiScatter(arg.name)){
-                HaloSize hs = kernelInfo.getFootprintTable().at(arg.name).computeHaloSize();
+                HaloSize hs = kernelInfo.getHaloSize(arg.name);
                 file << "image_desc_"<<arg.name<<".image_width = " << arg.name << "_width + " << hs.left + hs.right << ";" << endl;
                 file << "image_desc_"<<arg.name<<".image_height = " << arg.name << "_height + " << hs.up + hs.down << ";" << endl;
             }
@@ -692,7 +751,7 @@ void WrapperGenerator::writeMemoryAllocations()
 void WrapperGenerator::writeMemoryTransferToDevice()
 {
     for(Argument arg: *arguments){
-        if(kernelInfo.isWriteOnlyArray(arg.name)){
+        if(kernelInfo.isWriteOnlyArray(arg.name) || arg.name == residentImage){
             continue;
         }
 
@@ -789,6 +848,12 @@ void WrapperGenerator::writeWorkGroupSetUp()
 
 void WrapperGenerator::writeKernelLaunch()
 {
+    if(kernelInfo.getIterations() > 1){
+        file << "int iteration_launches = " << getIteratedLaunches() << ";" << endl;
+        writeIteratedKernelLaunch(false);
+        return;
+    }
+
     if(this->generateTimingCode){
         for(int i = 0; i < nLaunches; i++){
             file << "cl_event timing_event" << i << ";" << endl;
@@ -831,15 +896,154 @@ void WrapperGenerator::writeKernelLaunch()
     file << endl;
 }
 
+int WrapperGenerator::getIteratedLaunches()
+{
+    return kernelInfo.getIterations() / TemporalBlocker::getStepsPerLaunch(kernelInfo, params, settings);
+}
+
+
+// An iterated kernel is launched iteration_launches times, with T iterations per launch, see
+// TemporalBlocker. Each launch reads the buffer written by the previous one, so the source
+// and target buffers are swapped between the launches, and the images stay on the device.
+// iteration_result is the buffer written last, which is read back into the target image.
+// In process_iterate(), the target is also read back every readback_interval iterations,
+// and readback() is called. The time printed is for all the launches.
+void WrapperGenerator::writeIteratedKernelLaunch(bool withReadback)
+{
+    int sourceIndex = 0;
+    int targetIndex = 0;
+    for(int i = 0; i < arguments->size(); i++){
+        if(arguments->at(i).name == kernelInfo.getIterationSource()){
+            sourceIndex = i;
+        }
+        if(arguments->at(i).name == kernelInfo.getIterationTarget()){
+            targetIndex = i;
+        }
+    }
+
+    int steps = TemporalBlocker::getStepsPerLaunch(kernelInfo, params, settings);
+    string source = kernelInfo.getIterationSource();
+    string target = kernelInfo.getIterationTarget();
+
+    if(this->generateTimingCode){
+        file << "cl_event first_event, last_event;" << endl;
+    }
+
+    file << "cl_mem iteration_buffers[2] = {" << source << "_device, " << target << "_device};" << endl;
+    file << "for(int iteration = 0; iteration < iteration_launches; iteration++){" << endl;
+    file << "error = clSetKernelArg(kernel, " << sourceIndex << ", sizeof(cl_mem), &iteration_buffers[iteration % 2]);" << endl;
+    file << "error |= clSetKernelArg(kernel, " << targetIndex << ", sizeof(cl_mem), &iteration_buffers[(iteration + 1) % 2]);" << endl;
+    file << "clError(\"Error with iteration arguments\", error);" << endl;
+
+    file << "error = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, global_work_size, local_work_size, 0, NULL,";
+    if(this->generateTimingCode){
+        file << "iteration == iteration_launches - 1 ? &last_event : (iteration == 0 ? &first_event : NULL));" << endl;
+    }
+    else{
+        file << "NULL);" << endl;
+    }
+    file << "clError(\"Error launching kernel: \", error);" << endl;
+
+    if(withReadback){
+        file << "int iterations_done = (iteration + 1) * " << steps << ";" << endl;
+        file << "if(readback_interval > 0 && iterations_done % readback_interval == 0 && iteration < iteration_launches - 1){" << endl;
+        file << "error = clEnqueueReadBuffer(queue, iteration_buffers[(iteration + 1) % 2], CL_TRUE, 0, ";
+        file << target << "_size*sizeof(" << Type::baseTypeToString(kernelInfo.getPixelType(target)) << "), " << target << ", 0, NULL, NULL);" << endl;
+        file << "clError(\"Error transfering back to host for:" << target << " \", error);" << endl;
+        file << "if(readback != NULL){" << endl;
+        file << "readback(iterations_done);" << endl;
+        file << "}" << endl;
+        file << "}" << endl;
+    }
+    file << "}" << endl;
+    file << "cl_mem iteration_result = iteration_buffers[iteration_launches % 2];" << endl;
+
+    if(this->generateTimingCode){
+        file << "if(iteration_launches > 0){" << endl;
+        file << "error = clFinish(queue);" << endl;
+        file << "cl_ulong start_time = 0, end_time = 0;" << endl;
+        file << "error = clGetEventProfilingInfo(iteration_launches > 1 ? first_event : last_event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start_time, NULL);" << endl;
+        file << "error = clGetEventProfilingInfo(last_event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end_time, NULL);" << endl;
+        file << "clError(\"Error timing \", error);" << endl;
+        file << "cl_ulong elapsed_time = end_time - start_time;" << endl;
+        file << "double elapsed_time_ms = (double)(elapsed_time)/1000000.0;" << endl;
+        file << "printf(\"Execution time: %f ms (%lu ns)\\n\",elapsed_time_ms, elapsed_time);" << endl;
+        file << "if(iteration_launches > 1){" << endl;
+        file << "clReleaseEvent(first_event);" << endl;
+        file << "}" << endl;
+        file << "clReleaseEvent(last_event);" << endl;
+        file << "}" << endl;
+    }
+
+    file << endl;
+}
+
+
+// The source and target buffers are swapped between the iterations, and the target may be
+// read back from the source buffer, so the images must have the same size
+void WrapperGenerator::writeIterationSizeCheck()
+{
+    string source = kernelInfo.getIterationSource();
+    string target = kernelInfo.getIterationTarget();
+
+    file << "if(" << width(source) << " != " << width(target) << " || " << height(source) << " != " << height(target) << "){" << endl;
+    file << "printf(\"ERROR: " << source << " and " << target << " must have the same size to be iterated\\n\");" << endl;
+    file << "return;" << endl;
+    file << "}" << endl;
+}
+
+
+// process_iterate() has the arguments of process(), followed by the number of iterations,
+// the interval in iterations between read backs of the target image, 0 for only at the end,
+// and a function called after each intermediate read back, which can be NULL. With
+// TEMPORAL_STEPS, both counts must be multiples of it.
+void WrapperGenerator::writeIterateFunction()
+{
+    iterated = true;
+    int steps = TemporalBlocker::getStepsPerLaunch(kernelInfo, params, settings);
+
+    file << "void " << functionName << "_iterate(";
+    writeFunctionDeclarationArguments(true);
+    file << ", int iterations, int readback_interval, void (*readback)(int iteration))\n{\n";
+
+    writeIterationSizeCheck();
+    if(steps > 1){
+        file << "if(iterations % " << steps << " != 0 || readback_interval % " << steps << " != 0){" << endl;
+        file << "printf(\"ERROR: iterations and readback_interval must be multiples of " << steps << "\\n\");" << endl;
+        file << "return;" << endl;
+        file << "}" << endl;
+    }
+
+    writeOpenCLSetup();
+    writeMemoryAllocations();
+    writeMemoryTransferToDevice();
+    writeArguments();
+    writeWorkGroupSetUp();
+    file << "int iteration_launches = iterations / " << steps << ";" << endl;
+    writeIteratedKernelLaunch(true);
+    writeMemoryTransferFromDevice();
+    writeCleanUp();
+
+    file << "}\n\n";
+    iterated = false;
+}
+
+
 void WrapperGenerator::writeMemoryTransferFromDevice()
 {
     for(Argument arg: *arguments){
-        if(kernelInfo.isReadOnlyArray(arg.name)){
+        if(kernelInfo.isReadOnlyArray(arg.name) || arg.name == residentImage){
             continue;
         }
         if(arg.type.pointerLevel > 0){
+            // Iterated kernels swap the buffers, the last launch wrote iteration_result
+            string device = arg.name + "_device";
+            if(iterated && arg.name == kernelInfo.getIterationTarget()){
+                device = "iteration_result";
+            }
+
             file << "error = clEnqueueReadBuffer(queue, ";
-            file << arg.name << "_device, CL_TRUE, 0, ";
+            file << device << ", CL_TRUE, 0, ";
             file << arg.name << "_size*";
             if(arg.type.baseType == FLOAT)
                 file << "sizeof(float), ";
@@ -861,24 +1065,25 @@ void WrapperGenerator::writeMemoryTransferFromDevice()
 void WrapperGenerator::writeCleanUp()
 {
     for(Argument arg : *arguments){
-        if(arg.type.pointerLevel > 0){
+        if(arg.type.pointerLevel > 0 && arg.name != residentImage){
             file << "clReleaseMemObject(";
             file << arg.name << "_device);" << endl;
         }
     }
 
-    file << "clReleaseKernel(kernel);" << endl;
-    file << "clReleaseCommandQueue(queue);" << endl;
-    file << "clReleaseContext(context);" << endl;
-    file << "clReleaseDevice(device);" << endl;
+    // Without OpenMP, the kernel, queue and context are kept for the next call
+    if(settings.generateOMP){
+        file << "clReleaseKernel(kernel);" << endl;
+        file << "clReleaseCommandQueue(queue);" << endl;
+        file << "clReleaseContext(context);" << endl;
+        file << "clReleaseDevice(device);" << endl;
+    }
 }
 
 
 
-void WrapperGenerator::generate()
+void WrapperGenerator::writeHeader()
 {
-    file.open(filename);
-
     file << "// Generated by chilic/clite ";
     chrono::system_clock::time_point now = chrono::system_clock::now();
     time_t now_t = chrono::system_clock::to_time_t(now);
@@ -894,7 +1099,20 @@ void WrapperGenerator::generate()
     }
     file << endl;
 
+    if(!settings.generateOMP){
+        writePersistentState();
+    }
+}
+
+
+void WrapperGenerator::writeFunction()
+{
+    iterated = kernelInfo.getIterations() > 1;
+
     writeFunctionDeclaration();
+    if(iterated){
+        writeIterationSizeCheck();
+    }
     writeOpenCLSetup();
 
     writeMemoryAllocations();
@@ -906,6 +1124,22 @@ void WrapperGenerator::generate()
     writeCleanUp();
 
     file << "}\n\n";
+    iterated = false;
+}
+
+
+void WrapperGenerator::generate()
+{
+    file.open(filename);
+
+    writeHeader();
+    writeFunction();
+
+    // The source and target buffers are swapped, which images in image memory can not be
+    bool imageMemSource = params.imageMemArrays->count(kernelInfo.getIterationSource()) == 1;
+    if(kernelInfo.canIterate() && !imageMemSource){
+        writeIterateFunction();
+    }
 
     if(settings.generateOMP){
         writeOmpFunctionDeclaration();
@@ -934,3 +1168,134 @@ void WrapperGenerator::generate()
 }
 
 
+void WrapperGenerator::generateHeader()
+{
+    file.open(filename);
+    writeHeader();
+    file.close();
+}
+
+
+// The resident image, if any, is given as a buffer already on the device, <image>_device,
+// instead of as a host array, and is neither transferred nor released
+void WrapperGenerator::generateFunction(string functionName, string residentImage)
+{
+    this->functionName = functionName;
+    this->residentImage = residentImage;
+
+    file.open(filename, ios::app);
+    writeFunction();
+    file.close();
+}
+
+
+// process() selects the variant by the number of pixels in the grid. Variant i handles
+// grids of up to maxPixels[i] pixels, and the last variant handles all larger grids.
+void WrapperGenerator::generateDispatcher(vector<string> functionNames, vector<long long> maxPixels)
+{
+    this->functionName = "process";
+
+    file.open(filename, ios::app);
+
+    writeFunctionDeclaration();
+
+    string aGridArray = kernelInfo.getAGridArray();
+    file << "long n_pixels = (long)" << width(aGridArray) << " * " << height(aGridArray) << ";" << endl;
+
+    for(int i = 0; i < functionNames.size(); i++){
+        if(i < functionNames.size() - 1){
+            file << "if(n_pixels <= " << maxPixels[i] << "L){" << endl;
+            writeProcessCall(functionNames[i]);
+            file << "return;" << endl;
+            file << "}" << endl;
+        }
+        else{
+            writeProcessCall(functionNames[i]);
+        }
+    }
+
+    file << "}\n\n";
+
+    file.close();
+}
+
+
+// process_<kernel>() for a kernel split by SeparableSplitter. It has the arguments of the
+// kernel before it was split, and runs the row pass and the column pass, with the
+// intermediate image, which has the size of the source image, kept in a buffer on the device.
+// Both passes run on the shared command queue, so the column pass starts after the row pass,
+// and only the output is read back. This generator is for the column pass.
+void WrapperGenerator::generateSeparableFunction(string functionName, SeparableFilter filter, Argument source, BaseType sourcePixelType)
+{
+    this->functionName = functionName;
+
+    file.open(filename, ios::app);
+
+    file << "void " << functionName << "(";
+
+    bool firstArgWritten = false;
+    for(string image : filter.imageArguments){
+        if(firstArgWritten)
+            file << ", ";
+
+        if(image == filter.source){
+            file << source.unparse(sourcePixelType);
+        }
+        else{
+            for(Argument arg : *arguments){
+                if(arg.name == image){
+                    file << arg.unparse(kernelInfo.getPixelType(image));
+                }
+            }
+        }
+
+        file << ", int " << width(image);
+        file << ", int " << height(image);
+
+        firstArgWritten = true;
+    }
+
+    for(Argument arg : *arguments){
+        bool isImage = kernelInfo.getImageArrays()->count(arg.name) == 1;
+        bool isImageWidthOrHeight = arg.isImageHeight || arg.isImageWidth;
+
+        if(!isImage && !isImageWidthOrHeight){
+
+            if(firstArgWritten)
+                file << ", ";
+
+            file << arg.unparse(NOTYPE);
+
+            if(arg.type.pointerLevel > 0){
+                file << ", int " << arg.name << "_size";
+            }
+
+            firstArgWritten = true;
+        }
+    }
+
+    file << ")\n{\n";
+
+    string intermediate = filter.intermediate;
+    this->residentImage = intermediate;
+
+    file << "int " << width(intermediate) << " = " << width(filter.source) << ";" << endl;
+    file << "int " << height(intermediate) << " = " << height(filter.source) << ";" << endl;
+    file << "cl_int error;" << endl;
+    file << "process_init();" << endl;
+    file << "cl_mem " << intermediate << "_device = clCreateBuffer(persistent_context, CL_MEM_READ_WRITE, sizeof(float) * ";
+    file << width(intermediate) << " * " << height(intermediate) << ", NULL, &error);" << endl;
+    file << "clError(\"Error with memory allocation for " << intermediate << ": \", error);" << endl;
+    file << "if(error != CL_SUCCESS){ process_release(); exit(-1);}" << endl;
+
+    file << "process_" << filter.rowsKernel << "(";
+    file << filter.source << ", " << width(filter.source) << ", " << height(filter.source) << ", ";
+    file << intermediate << "_device, " << width(intermediate) << ", " << height(intermediate) << ");" << endl;
+
+    writeProcessCall(functionName + "_cols");
+
+    file << "clReleaseMemObject(" << intermediate << "_device);" << endl;
+    file << "}\n\n";
+
+    file.close();
+}
@@ -16,6 +16,7 @@
 #include "parameters.h"
 #include "kernelinfo.h"
 #include "settings.h"
+#include "separablesplitter.h"
 
 using namespace std;
 
@@ -26,6 +27,12 @@ class WrapperGenerator
         WrapperGenerator(string filename, vector<Argument>* arguments, Parameters params, KernelInfo kernelInfo, Settings settings);
         void generate();
 
+        // For wrappers with several variants of the kernel, see VariantGenerator::generateDispatch
+        void generateHeader();
+        void generateFunction(string functionName, string residentImage = "");
+        void generateDispatcher(vector<string> functionNames, vector<long long> maxPixels);
+        void generateSeparableFunction(string functionName, SeparableFilter filter, Argument source, BaseType sourcePixelType);
+
     private:
         KernelInfo kernelInfo;
         string filename;
@@ -39,8 +46,19 @@ class WrapperGenerator
         int nLaunches = 3;
         int platformId = 0;
         int deviceId = 0;
+        string functionName = "process";
+
+        // True while writing a function which iterates the kernel, whose result is read back
+        // from iteration_result
+        bool iterated = false;
+
+        // Image given to the function as a buffer already on the device, see generateFunction
+        string residentImage;
 
+        void writeHeader();
+        void writeFunction();
         void writeOpenCLSetup();
+        void writePersistentState();
         void writeFunctionDeclaration();
         void writeFunctionDeclarationArguments(bool ignoreOmpMpiArgs);
         void writeMemoryAllocations();
@@ -48,6 +66,10 @@ class WrapperGenerator
         void writeArguments();
         void writeWorkGroupSetUp();
         void writeKernelLaunch();
+        void writeIteratedKernelLaunch(bool withReadback);
+        void writeIterateFunction();
+        void writeIterationSizeCheck();
+        int getIteratedLaunches();
         void writeMemoryTransferFromDevice();
         void writeCleanUp();
 